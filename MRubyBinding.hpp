@@ -0,0 +1,319 @@
+/*
+Created by Szymon Bagiński
+baginski.szymon@gmail.com
+Wrocław University of Technology
+Dec 2017
+*/
+
+#ifndef MRUBY_BINDING_HPP
+#define MRUBY_BINDING_HPP
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <mruby.h>
+#include <mruby/array.h>
+#include <mruby/string.h>
+
+#include "MRubyInterpreter.hpp"
+
+/*
+    Generates mrb_func_t for a plain C++ function:
+
+        mrb_define_method (state, state->kernel_module, "setNodeRhoPhysical",
+                           MRUBY_BIND (setNodeRhoPhysical), MRB_ARGS_REQ (4)) ;
+
+    Number and types of Ruby arguments are taken from the function signature at
+    compile time, no format string is parsed. If the first parameter is
+    mrb_state * it gets the calling interpreter. Returned value is converted
+    with toMRubyValue (), void functions return nil.
+
+    C++ exceptions thrown by the function or during argument conversion do not
+    cross the mruby VM - they are raised as Ruby ArgumentError, RangeError, 
+    TypeError or RuntimeError, so scripts may rescue them. mrb_raise does longjmp, thus it is
+    called only after all C++ objects of the call are destroyed. For the same
+    reason bound functions must not call raising mruby API while they hold
+    objects with destructors.
+*/
+#define MRUBY_BIND(function) \
+    (&::microflow::MRubyBinding<decltype (&function), &function>::call)
+
+namespace microflow
+{
+    class MRubyArgumentError : public std::runtime_error
+    {
+        public:
+            using std::runtime_error::runtime_error ;
+    } ;
+
+    // Value out of range of C++ type, raised as RangeError like in mrb_get_args.
+    class MRubyRangeError : public MRubyArgumentError
+    {
+        public:
+            using MRubyArgumentError::MRubyArgumentError ;
+    } ;
+
+    class MRubyTypeError : public std::runtime_error
+    {
+        public:
+            using std::runtime_error::runtime_error ;
+    } ;
+
+
+
+    // Conversions of single argument, like mrb_get_args() integers accept
+    // floats and floats accept integers.
+    template <class T>
+    struct MRubyArgument ;
+
+    template <>
+    struct MRubyArgument<mrb_value>
+    {
+        static mrb_value get (mrb_state *, mrb_value value) { return value ; }
+    } ;
+
+    template <>
+    struct MRubyArgument<mrb_int>
+    {
+        static mrb_int get (mrb_state *, mrb_value value)
+        {
+            if (mrb_fixnum_p (value)) return mrb_fixnum (value) ;
+            if (mrb_float_p (value))
+            {
+                const mrb_float f = mrb_float (value) ;
+                // Conversion of NaN, Inf or out of range value is undefined.
+                if (!std::isfinite (f) || 
+                    f <  static_cast<mrb_float> (MRB_INT_MIN) ||
+                    f >= static_cast<mrb_float> (MRB_INT_MAX) + 1)
+                {
+                    throw MRubyRangeError ("float too big for int") ;
+                }
+                return static_cast<mrb_int> (f) ;
+            }
+            throw MRubyTypeError ("expected Integer") ;
+        }
+    } ;
+
+    template <>
+    struct MRubyArgument<unsigned>
+    {
+        static unsigned get (mrb_state * state, mrb_value value)
+        {
+            mrb_int result = MRubyArgument<mrb_int>::get (state, value) ;
+            if (result < 0)
+            {
+                throw MRubyArgumentError ("expected non negative Integer") ;
+            }
+            if (static_cast<typename std::make_unsigned<mrb_int>::type> (result) >
+                std::numeric_limits<unsigned>::max ())
+            {
+                throw MRubyRangeError ("integer too big for unsigned") ;
+            }
+            return static_cast<unsigned> (result) ;
+        }
+    } ;
+
+    template <>
+    struct MRubyArgument<double>
+    {
+        static double get (mrb_state *, mrb_value value)
+        {
+            if (mrb_float_p (value)) return mrb_float (value) ;
+            if (mrb_fixnum_p (value)) return mrb_fixnum (value) ;
+            throw MRubyTypeError ("expected Float") ;
+        }
+    } ;
+
+    template <>
+    struct MRubyArgument<bool>
+    {
+        static bool get (mrb_state *, mrb_value value) { return mrb_test (value) ; }
+    } ;
+
+    template <>
+    struct MRubyArgument<std::string>
+    {
+        static std::string get (mrb_state *, mrb_value value)
+        {
+            if (!mrb_string_p (value))
+            {
+                throw MRubyTypeError ("expected String") ;
+            }
+            return std::string (RSTRING_PTR (value), RSTRING_LEN (value)) ;
+        }
+    } ;
+
+    template <class T, size_t N>
+    struct MRubyArgument<std::array<T,N>>
+    {
+        static std::array<T,N> get (mrb_state * state, mrb_value value)
+        {
+            if (!mrb_array_p (value))
+            {
+                throw MRubyTypeError ("expected Array") ;
+            }
+            if (N != static_cast<size_t> (RARRAY_LEN (value)))
+            {
+                throw MRubyArgumentError ("expected Array of " + std::to_string (N) +
+                                          " elements") ;
+            }
+            std::array<T,N> result ;
+            for (size_t i = 0 ; i < N ; i++)
+            {
+                result [i] = MRubyArgument<T>::get (state, RARRAY_PTR (value) [i]) ;
+            }
+            return result ;
+        }
+    } ;
+
+
+
+    template <size_t ... Indices>
+    struct MRubyIndices {} ;
+
+    template <size_t N, size_t ... Indices>
+    struct MRubyMakeIndices : MRubyMakeIndices<N - 1, N - 1, Indices ...> {} ;
+
+    template <size_t ... Indices>
+    struct MRubyMakeIndices<0, Indices ...>
+    {
+        typedef MRubyIndices<Indices ...> type ;
+    } ;
+
+
+
+    template <class Result>
+    struct MRubyResult
+    {
+        template <class Call>
+        static mrb_value get (mrb_state * state, Call call)
+        {
+            return toMRubyValue (state, call ()) ;
+        }
+    } ;
+
+    template <>
+    struct MRubyResult<void>
+    {
+        template <class Call>
+        static mrb_value get (mrb_state *, Call call)
+        {
+            call () ;
+            return mrb_nil_value () ;
+        }
+    } ;
+
+    // Number of Ruby arguments of bound function.
+    template <class Function>
+    struct MRubyArity ;
+
+    template <class Result, class ... Parameters>
+    struct MRubyArity<Result (*) (Parameters ...)>
+    {
+        static const size_t value = sizeof... (Parameters) ;
+    } ;
+
+    template <class Result, class ... Parameters>
+    struct MRubyArity<Result (*) (mrb_state *, Parameters ...)>
+    {
+        static const size_t value = sizeof... (Parameters) ;
+    } ;
+
+    // Calls function with converted arguments and converts returned value.
+    template <class Result, class ... Parameters, size_t ... Indices>
+    mrb_value invokeMRubyFunction (mrb_state * state, Result (*function) (Parameters ...),
+                                   const mrb_value * argv, MRubyIndices<Indices ...>)
+    {
+        return MRubyResult<Result>::get (state, [&] ()
+        {
+            return function (MRubyArgument<
+                typename std::decay<Parameters>::type>::get (state, argv [Indices]) ...) ;
+        }) ;
+    }
+
+    template <class Result, class ... Parameters, size_t ... Indices>
+    mrb_value invokeMRubyFunction (mrb_state * state, 
+                                   Result (*function) (mrb_state *, Parameters ...),
+                                   const mrb_value * argv, MRubyIndices<Indices ...>)
+    {
+        return MRubyResult<Result>::get (state, [&] ()
+        {
+            return function (state, MRubyArgument<
+                typename std::decay<Parameters>::type>::get (state, argv [Indices]) ...) ;
+        }) ;
+    }
+
+    // Arguments of the current call, without copying (like mrb_get_args).
+    inline const mrb_value * getMRubyArguments (mrb_state * state, mrb_int & argc)
+    {
+        const mrb_value * argv = state->c->stack + 1 ;
+        argc = state->c->ci->argc ;
+        if (argc < 0)  // arguments packed in array, f(*a)
+        {
+            argc = RARRAY_LEN (argv [0]) ;
+            argv = RARRAY_PTR (argv [0]) ;
+        }
+        return argv ;
+    }
+
+    template <class Function, Function function>
+    struct MRubyBinding
+    {
+        static const size_t arity = MRubyArity<Function>::value ;
+
+        static mrb_value call (mrb_state * state, mrb_value)
+        {
+            // Filled in catch blocks, raised after leaving them.
+            char message [256] = "" ;
+            const char * errorClass = nullptr ;
+
+            try
+            {
+                mrb_int argc ;
+                const mrb_value * argv = getMRubyArguments (state, argc) ;
+                if (static_cast<size_t> (argc) != arity)
+                {
+                    throw MRubyArgumentError ("wrong number of arguments (" +
+                        std::to_string (argc) + " for " + std::to_string (arity) + ")") ;
+                }
+
+                return invokeMRubyFunction (state, function, argv, 
+                                            typename MRubyMakeIndices<arity>::type ()) ;
+            }
+            catch (const MRubyRangeError & e)
+            {
+                errorClass = "RangeError" ;
+                std::strncpy (message, e.what (), sizeof (message) - 1) ;
+            }
+            catch (const MRubyArgumentError & e)
+            {
+                errorClass = "ArgumentError" ;
+                std::strncpy (message, e.what (), sizeof (message) - 1) ;
+            }
+            catch (const MRubyTypeError & e)
+            {
+                errorClass = "TypeError" ;
+                std::strncpy (message, e.what (), sizeof (message) - 1) ;
+            }
+            catch (const std::exception & e)
+            {
+                errorClass = "RuntimeError" ;
+                std::strncpy (message, e.what (), sizeof (message) - 1) ;
+            }
+            catch (...)
+            {
+                errorClass = "RuntimeError" ;
+                std::strncpy (message, "unknown C++ exception", sizeof (message) - 1) ;
+            }
+
+            mrb_raise (state, mrb_class_get (state, errorClass), message) ;
+            return mrb_nil_value () ;
+        }
+    } ;
+}
+
+#endif
@@ -7,24 +7,36 @@ Dec 2017
 
 #include "RubyInterpreter.hpp"
 #include "Exceptions.hpp"
+#include "MRubyBinding.hpp"
 
 #include <mruby/string.h>
 #include <mruby/numeric.h>
 #include <mruby/array.h>
+#include <mruby/class.h>
+#include <mruby/throw.h>
+#include <mruby/dump.h>
+#include <mruby/typed_buffer.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <list>
+#include <sstream>
+#include <vector>
 
 using namespace std ;
 
 namespace microflow
 {
-    template<typename Type>
-    Type convertTo (mrb_value rubyVariable) ;
-
     template<>      // converts only floats and integers
     double convertTo<double> (mrb_value rubyVariable)
     {
-        if (mrb_float_p (rubyVariable) || mrb_fixnum_p (rubyVariable)) {
+        if (mrb_float_p (rubyVariable)) {
             return mrb_float (rubyVariable) ;
         }
+        else if (mrb_fixnum_p (rubyVariable)) {
+            return mrb_fixnum (rubyVariable) ;
+        }
         else 
         {
             THROW ("Ruby exception: ruby variable is not a float or integer type") ;
@@ -75,6 +87,31 @@ namespace microflow
         return mrb_bool (rubyVariable) ;
     }
 
+    template<>  // accepts FloatBuffer (copied at once) and Array of numbers
+    std::vector<double> convertTo<std::vector<double>> (mrb_value rubyVariable)
+    {
+        if (mrb_float_buffer_p (rubyVariable))
+        {
+            mrb_int length ;
+            const double * data = mrb_float_buffer_ptr (nullptr, rubyVariable, &length) ;
+            return std::vector<double> (data, data + length) ;
+        }
+        else if (mrb_array_p (rubyVariable))
+        {
+            std::vector<double> result ;
+            result.reserve (RARRAY_LEN (rubyVariable)) ;
+            for (mrb_int i = 0 ; i < RARRAY_LEN (rubyVariable) ; i++)
+            {
+                result.push_back (convertTo<double> (RARRAY_PTR (rubyVariable)[i])) ;
+            }
+            return result ;
+        }
+        else
+        {
+            THROW ("Ruby exception: ruby variable is not a FloatBuffer or array") ;
+        }
+    }
+
     std::unique_ptr<MRubyInterpreter> MRubyInterpreter::
     getMRubyInterpreter ()
     {
@@ -104,298 +141,514 @@ namespace microflow
     mrb_value MRubyInterpreter::
     runScript (const string& code)
     {
-        struct mrb_parser_state * parser_ ;
-        struct RProc * proc_ ;
-        
-        parser_ = mrb_parse_string (state_, code.c_str(), context_) ;
-        proc_ = mrb_generate_code (state_, parser_) ;
-        mrb_pool_close (parser_->pool) ;
-        value_ = mrb_run (state_, proc_, mrb_top_self(state_)) ;
-
-        if (state_->exc) {
-            logger << "ERROR in Ruby\n" ;
-            mrb_value lasterr = mrb_obj_value (state_->exc) ;
+        // Without restoring the arena every object created by the script 
+        // (and the compiled script itself) would be never freed.
+        int arenaIndex = mrb_gc_arena_save (state_) ;
 
-            //class
-            mrb_value klass = mrb_class_path (state_, mrb_obj_class(state_, lasterr)) ;
-            logger << "class = " << convertTo<string> (klass) << endl ;
+        struct RProc * proc = nullptr ;
+        try
+        {
+            proc = getCompiledScript (code) ;
+        }
+        catch (...)
+        {
+            mrb_gc_arena_restore (state_, arenaIndex) ;
+            throw ;
+        }
+        mrb_value result = mrb_run (state_, proc, mrb_top_self(state_)) ;
+        keepResult (result) ;
 
-            //message
-            mrb_value message = mrb_obj_as_string (state_, lasterr) ;
-            logger << "message = " << convertTo<string> (message) << endl ;
+        mrb_gc_arena_restore (state_, arenaIndex) ;
 
-            THROW ("Ruby exception") ;
+        if (state_->exc) {
+            throwRubyException (state_) ;
         }
+
+        return value_ ;
     }
 
-    template<typename VariableType >
-    VariableType MRubyInterpreter::
-    getMRubyVariable( const std::string & variableName)
+    struct RProc * MRubyInterpreter::
+    getCompiledScript (const string & code)
     {
-        mrb_value mrb_string = mrb_str_new_cstr (state_, variableName.c_str()) ;
-        mrb_sym symbol = mrb_intern_str (state_, mrb_string) ;
-        mrb_value rubyVariable = mrb_gv_get (state_, symbol) ;
-        VariableType variable = convertTo<VariableType>( rubyVariable ) ;
-
-        //checking whether the variable exists
-        if (mrb_equal (state_, rubyVariable, mrb_nil_value ()))    
+        auto found = compiledScriptsIndex_.find (code) ;
+        if (compiledScriptsIndex_.end () != found)
         {
-            THROW ("Ruby exception: ruby variable does not exist") ;
+            compiledScripts_.splice (compiledScripts_.begin (), compiledScripts_, found->second) ;
+            return found->second->second ;
         }
-        return variable ;
-    }
-    
-    template double MRubyInterpreter::
-    getMRubyVariable<double> (const std::string & variableName) ;
-
-    template bool MRubyInterpreter::
-    getMRubyVariable<bool> (const std::string & variableName) ;
 
-    template std::string MRubyInterpreter::
-    getMRubyVariable<std::string> (const std::string & variableName) ;
+        struct RProc * proc = generateCode (code) ;
 
-    template unsigned MRubyInterpreter::
-    getMRubyVariable<unsigned> (const std::string & variableName) ;
+        if (maxNumberOfCompiledScripts <= compiledScripts_.size ())
+        {
+            mrb_gc_unregister (state_, mrb_obj_value (compiledScripts_.back ().second)) ;
+            compiledScriptsIndex_.erase (compiledScripts_.back ().first) ;
+            compiledScripts_.pop_back () ;
+        }
+        mrb_gc_register (state_, mrb_obj_value (proc)) ;
+        compiledScripts_.emplace_front (code, proc) ;
+        compiledScriptsIndex_ [code] = compiledScripts_.begin () ;
 
-    template int MRubyInterpreter::
-    getMRubyVariable<int> (const std::string & variableName) ;
+        return proc ;
+    }
 
-    // Used in methods called by Ruby interpreter - these methods must be static.
-    static NodeLayout * nodeLayoutPtr = nullptr ;
-    static ModificationRhoU * modificationsRhoUPtr = nullptr ;
+    void MRubyInterpreter::
+    keepResult (mrb_value result)
+    {
+        mrb_gc_unregister (state_, value_) ;
+        value_ = result ;
+        mrb_gc_register (state_, value_) ;
+    }
 
-    static mrb_value setNodeBaseType (mrb_state * state, mrb_value self) 
+    struct RProc * MRubyInterpreter::
+    generateCode (const string & code)
     {
-        if ((mrb_get_argc (state)) != 4) 
+        struct mrb_parser_state * parser = mrb_parse_string (state_, code.c_str(), context_) ;
+        if (nullptr == parser)
+        {
+            THROW ("Ruby exception: could not create parser") ;
+        }
+        if (0 < parser->nerr)
         {
-            std::string comunicate {"Wrong number of arguments in :"} ; 
-            comunicate.append (__func__) ;
-            THROW (comunicate) ;
+            std::stringstream ss ;
+            ss << "Ruby exception: syntax error at line " << parser->error_buffer[0].lineno 
+               << ": " << parser->error_buffer[0].message ;
+            mrb_parser_free (parser) ;
+            THROW (ss.str ()) ;
         }
 
-        mrb_int mrb_nodeZ ;     
-        mrb_int mrb_nodeX ;
-        mrb_int mrb_nodeY ;
-        mrb_value mrb_nodeBaseTypeName ;
+        struct RProc * proc = mrb_generate_code (state_, parser) ;
+        mrb_parser_free (parser) ;
+        if (nullptr == proc)
+        {
+            THROW ("Ruby exception: code generation failed") ;
+        }
 
-        mrb_get_args (state, "iiiS", &mrb_nodeX, &mrb_nodeY, &mrb_nodeZ, &mrb_nodeBaseTypeName) ;
+        return proc ;
+    }
 
-        unsigned nodeX = convertTo<unsigned> (mrb_fixnum_value (mrb_nodeX)) ;
-        unsigned nodeY = convertTo<unsigned> (mrb_fixnum_value (mrb_nodeY)) ;
-        unsigned nodeZ = convertTo<unsigned> (mrb_fixnum_value (mrb_nodeZ)) ;
-        string nodeBaseTypeName = convertTo<string> (mrb_nodeBaseTypeName) ;
+    MRubyInterpreter::Bytecode MRubyInterpreter::
+    compile (const string & code)
+    {
+        MRubyArenaGuard arenaGuard (state_) ;
+        struct RProc * proc = generateCode (code) ;
 
-        auto node = nodeLayoutPtr->getNodeType (nodeX,nodeY,nodeZ) ;
-	    node.setBaseType (fromString<NodeBaseType> (nodeBaseTypeName)) ;
-	    nodeLayoutPtr->setNodeType (nodeX, nodeY, nodeZ, node) ;
-        return mrb_nil_value () ;
+        uint8_t * binary = nullptr ;
+        size_t binarySize = 0 ;
+        if (MRB_DUMP_OK != mrb_dump_irep (state_, proc->body.irep, DUMP_ENDIAN_NAT, 
+                                          &binary, &binarySize))
+        {
+            THROW ("Ruby exception: can not dump compiled code") ;
+        }
+        auto bytecode = std::make_shared<std::vector<uint8_t>> (binary, binary + binarySize) ;
+        mrb_free (state_, binary) ;
+
+        return bytecode ;
     }
 
-    static mrb_value setNodePlacementModifier (mrb_state * state, mrb_value self)
+    mrb_value MRubyInterpreter::
+    runBytecode (const Bytecode & bytecode)
     {
-        if ((mrb_get_argc (state)) != 4) 
+        // Loaded without copying - symbols and instructions point into bytecode.
+        mrb_irep * irep = mrb_read_irep (state_, bytecode->data ()) ;
+        if (nullptr == irep)
+        {
+            THROW ("Ruby exception: can not load compiled code") ;
+        }
+        if (loadedBytecode_.end () == 
+            std::find (loadedBytecode_.begin (), loadedBytecode_.end (), bytecode))
         {
-            std::string comunicate {"Wrong number of arguments in :"} ; 
-            comunicate.append (__func__) ;
-            THROW (comunicate) ;
+            loadedBytecode_.push_back (bytecode) ;
         }
 
-        mrb_int mrb_nodeX ;         
-        mrb_int mrb_nodeY ;
-        mrb_int mrb_nodeZ ;
-        mrb_value mrb_placementModifierName ;
+        int arenaIndex = mrb_gc_arena_save (state_) ;
 
-        mrb_get_args (state, "iiiS", &mrb_nodeX, &mrb_nodeY, &mrb_nodeZ, &mrb_placementModifierName) ;
+        struct RProc * proc = mrb_proc_new (state_, irep) ;
+        mrb_irep_decref (state_, irep) ;
+        keepResult (mrb_run (state_, proc, mrb_top_self (state_))) ;
 
-        unsigned nodeX = convertTo<unsigned> (mrb_fixnum_value (mrb_nodeX)) ;
-        unsigned nodeY = convertTo<unsigned> (mrb_fixnum_value (mrb_nodeY)) ;
-        unsigned nodeZ = convertTo<unsigned> (mrb_fixnum_value (mrb_nodeZ)) ;
-        string placementModifierName = convertTo<string> (mrb_placementModifierName) ;
+        mrb_gc_arena_restore (state_, arenaIndex) ;
 
-        auto node = nodeLayoutPtr->getNodeType (nodeX,nodeY,nodeZ) ;
-	    node.setPlacementModifier (fromString<PlacementModifier> (placementModifierName)) ;
-	    nodeLayoutPtr->setNodeType (nodeX,nodeY,nodeZ, node) ;
+        if (state_->exc) {
+            throwRubyException (state_) ;
+        }
 
-	    return mrb_nil_value () ;
+        return value_ ;
     }
 
-    static mrb_value setNodeRhoPhysical (mrb_state * state, mrb_value self) 
+    void MRubyInterpreter::
+    throwRubyException (mrb_state * state)
     {
-        if ((mrb_get_argc (state)) != 4) 
+        logger << "ERROR in Ruby\n" ;
+        int arenaIndex = mrb_gc_arena_save (state) ;
+        mrb_value lasterr = mrb_obj_value (state->exc) ;
+        // Without this all later scripts would fail.
+        state->exc = nullptr ;
+
+        //class
+        mrb_value klass = mrb_class_path (state, mrb_obj_class(state, lasterr)) ;
+        logger << "class = " << convertTo<string> (klass) << endl ;
+
+        //message
+        mrb_value message = mrb_obj_as_string (state, lasterr) ;
+        logger << "message = " << convertTo<string> (message) << endl ;
+
+        mrb_gc_arena_restore (state, arenaIndex) ;
+        THROW ("Ruby exception") ;
+    }
+
+    std::unique_ptr<MRubyCallable> MRubyInterpreter::
+    prepareCallable (const std::string & name)
+    {
+        mrb_value self = mrb_top_self (state_) ;
+
+        if (!name.empty () && '$' == name[0])
         {
-            std::string comunicate {"Wrong number of arguments in :"} ; 
-            comunicate.append (__func__) ;
-            THROW (comunicate) ;
+            mrb_value procedure = 
+                mrb_gv_get (state_, mrb_intern (state_, name.c_str (), name.size ())) ;
+
+            if (mrb_type (procedure) != MRB_TT_PROC)
+            {
+                THROW ("Ruby exception: " + name + " is not a proc") ;
+            }
+            struct RProc * proc = mrb_proc_ptr (procedure) ;
+            if (!MRB_PROC_CFUNC_P (proc) && proc->env)
+            {
+                self = proc->env->stack[0] ;
+            }
+            return std::unique_ptr<MRubyCallable> 
+                (new MRubyCallable (state_, procedure, self, proc->target_class)) ;
         }
 
-        mrb_int mrb_nodeX ;           
-        mrb_int mrb_nodeY ;
-        mrb_int mrb_nodeZ ;
-        mrb_float mrb_rhoPhysical;
+        struct RClass * targetClass = mrb_class (state_, self) ;
+        struct RProc * method = mrb_method_search_vm 
+            (state_, &targetClass, mrb_intern (state_, name.c_str (), name.size ())) ;
+
+        if (nullptr == method)
+        {
+            THROW ("Ruby exception: undefined method " + name) ;
+        }
 
-        mrb_get_args (state, "iiif", &mrb_nodeX, &mrb_nodeY, &mrb_nodeZ, &mrb_rhoPhysical) ;
+        return std::unique_ptr<MRubyCallable> 
+            (new MRubyCallable (state_, mrb_obj_value (method), self, targetClass)) ;
+    }
 
-        unsigned nodeX = convertTo<unsigned> (mrb_fixnum_value (mrb_nodeX)) ;
-        unsigned nodeY = convertTo<unsigned> (mrb_fixnum_value (mrb_nodeY)) ;
-        unsigned nodeZ = convertTo<unsigned> (mrb_fixnum_value (mrb_nodeZ)) ;
-        double rhoPhysical = convertTo<double> (mrb_float_value (state, mrb_rhoPhysical)) ;
-        
-        modificationsRhoUPtr->addRhoPhysical (Coordinates (nodeX, nodeY, nodeZ), rhoPhysical) ;
+    MRubyCallable::
+    MRubyCallable (mrb_state * state, mrb_value procedure, mrb_value self, 
+                   struct RClass * targetClass) :
+    state_ (state), procedure_ (procedure), self_ (self), targetClass_ (targetClass)
+    {
+        mrb_gc_register (state_, procedure_) ;
+        mrb_gc_register (state_, self_) ;
+    }
 
-        return mrb_nil_value () ;
+    MRubyCallable::
+    ~MRubyCallable ()
+    {
+        mrb_gc_unregister (state_, procedure_) ;
+        mrb_gc_unregister (state_, self_) ;
     }
 
-    static mrb_value setNodeRhoBoundaryPhysical (mrb_state * state, mrb_value self) 
+    // Proc is run directly, without method lookup and without argument
+    // marshalling of mrb_funcall. Ruby exceptions are caught here (instead of 
+    // unwinding C++ frames) and rethrown as C++ exceptions.
+    mrb_value MRubyCallable::
+    invoke (mrb_int argc, const mrb_value * argv)
     {
-        if ((mrb_get_argc (state)) != 4) 
+        struct mrb_jmpbuf * previousJmp = state_->jmp ;
+        struct mrb_jmpbuf jmp ;
+        // Exception may be raised in another context (Fiber resumed by the 
+        // proc), so the caller's context is restored explicitly.
+        struct mrb_context * const context = state_->c ;
+        const ptrdiff_t ciOffset = context->ci - context->cibase ;
+        mrb_value * const stack = context->stack ;
+        mrb_value result = mrb_nil_value () ;
+
+        MRB_TRY (&jmp)
         {
-            std::string comunicate {"Wrong number of arguments in :"} ; 
-            comunicate.append (__func__) ;
-            THROW (comunicate) ;
+            state_->jmp = &jmp ;
+            result = mrb_yield_with_class (state_, procedure_, argc, argv, self_, targetClass_) ;
+            state_->jmp = previousJmp ;
         }
+        MRB_CATCH (&jmp)
+        {
+            state_->jmp = previousJmp ;
+            state_->c = context ;
+            context->ci = context->cibase + ciOffset ;
+            context->stack = stack ;
+        }
+        MRB_END_EXC (&jmp) ;
 
-        mrb_int mrb_nodeX ;       
-        mrb_int mrb_nodeY ;
-        mrb_int mrb_nodeZ ;
-        mrb_float mrb_rhoPhysical;
-
-        mrb_get_args (state, "iiif", &mrb_nodeX, &mrb_nodeY, &mrb_nodeZ, &mrb_rhoPhysical) ;
-
-
-        unsigned nodeX = convertTo<unsigned> (mrb_fixnum_value (mrb_nodeX)) ;
-        unsigned nodeY = convertTo<unsigned> (mrb_fixnum_value (mrb_nodeY)) ;
-        unsigned nodeZ = convertTo<unsigned> (mrb_fixnum_value (mrb_nodeZ)) ;
-        double rhoPhysical = convertTo<double> (mrb_float_value (state, mrb_rhoPhysical)) ;
+        if (state_->exc)
+        {
+            MRubyInterpreter::throwRubyException (state_) ;
+        }
+        return result ;
+    }
 
-        modificationsRhoUPtr->addRhoBoundaryPhysical (Coordinates (nodeX, nodeY, nodeZ), rhoPhysical) ;
+    RegionModificationRhoU & RegionModificationRhoU::
+    operator+= (const RegionModificationRhoU & other)
+    {
+        rhoPhysical.append (other.rhoPhysical) ;
+        rhoBoundaryPhysical.append (other.rhoBoundaryPhysical) ;
+        uPhysical.append (other.uPhysical) ;
+        uBoundaryPhysical.append (other.uBoundaryPhysical) ;
+        return *this ;
+    }
 
-        return mrb_nil_value () ;
+    void RegionModificationRhoU::
+    applyTo (ModificationRhoU & modifications) const
+    {
+        rhoPhysical.forEachNode ([&] (const Coordinates & c, double rho) 
+            { modifications.addRhoPhysical (c, rho) ; }) ;
+        rhoBoundaryPhysical.forEachNode ([&] (const Coordinates & c, double rho) 
+            { modifications.addRhoBoundaryPhysical (c, rho) ; }) ;
+        uPhysical.forEachNode ([&] (const Coordinates & c, const VelocityPhysical & u) 
+            { modifications.addUPhysical (c, u[0], u[1], u[2]) ; }) ;
+        uBoundaryPhysical.forEachNode ([&] (const Coordinates & c, const VelocityPhysical & u) 
+            { modifications.addUBoundaryPhysical (c, u[0], u[1], u[2]) ; }) ;
     }
 
-    static mrb_value setNodeUPhysical (mrb_state * state, mrb_value self) 
+    // Used in methods called by Ruby interpreter - these methods must be static.
+    // Thread local, because modificators may run concurrently in separate 
+    // interpreters (see modifyNodeLayoutAsync).
+    static thread_local NodeLayout * nodeLayoutPtr = nullptr ;
+    static thread_local RegionModificationRhoU * pendingModificationsPtr = nullptr ;
+
+    /*
+        Functions called from modificators. Bound with MRUBY_BIND, which checks 
+        number of arguments, converts them and turns C++ exceptions into Ruby 
+        exceptions.
+    */
+    static void setNodeBaseType (unsigned nodeX, unsigned nodeY, unsigned nodeZ,
+                                 const string & nodeBaseTypeName)
     {
-        if ((mrb_get_argc (state)) != 4) 
-        {
-            std::string comunicate {"Wrong number of arguments in :"} ; 
-            comunicate.append (__func__) ;
-            THROW (comunicate) ;
-        }
+        auto node = nodeLayoutPtr->getNodeType (nodeX,nodeY,nodeZ) ;
+	    node.setBaseType (fromString<NodeBaseType> (nodeBaseTypeName)) ;
+	    nodeLayoutPtr->setNodeType (nodeX, nodeY, nodeZ, node) ;
+    }
 
-        mrb_int mrb_nodeX ;          
-        mrb_int mrb_nodeY ;
-        mrb_int mrb_nodeZ ;
-        mrb_value mrb_uPhysical;
+    static void setNodePlacementModifier (unsigned nodeX, unsigned nodeY, unsigned nodeZ,
+                                          const string & placementModifierName)
+    {
+        auto node = nodeLayoutPtr->getNodeType (nodeX,nodeY,nodeZ) ;
+	    node.setPlacementModifier (fromString<PlacementModifier> (placementModifierName)) ;
+	    nodeLayoutPtr->setNodeType (nodeX,nodeY,nodeZ, node) ;
+    }
 
-        mrb_get_args (state, "iiiA", &mrb_nodeX, &mrb_nodeY, &mrb_nodeZ, &mrb_uPhysical) ;
+    static void setNodeRhoPhysical (unsigned nodeX, unsigned nodeY, unsigned nodeZ,
+                                    double rhoPhysical) 
+    {
+        pendingModificationsPtr->rhoPhysical.add (Coordinates (nodeX, nodeY, nodeZ), rhoPhysical) ;
+    }
 
-        unsigned nodeX = convertTo<unsigned> (mrb_fixnum_value (mrb_nodeX)) ;
-        unsigned nodeY = convertTo<unsigned> (mrb_fixnum_value (mrb_nodeY)) ;
-        unsigned nodeZ = convertTo<unsigned> (mrb_fixnum_value (mrb_nodeZ)) ;
-        double ux = convertTo<double> (mrb_ary_entry (mrb_uPhysical, 0)) ;
-	    double uy = convertTo<double> (mrb_ary_entry (mrb_uPhysical, 1)) ;
-	    double uz = convertTo<double> (mrb_ary_entry (mrb_uPhysical, 2)) ;
+    static void setNodeRhoBoundaryPhysical (unsigned nodeX, unsigned nodeY, unsigned nodeZ,
+                                            double rhoPhysical) 
+    {
+        pendingModificationsPtr->rhoBoundaryPhysical.add (Coordinates (nodeX, nodeY, nodeZ), rhoPhysical) ;
+    }
 
-        modificationsRhoUPtr->addUPhysical (Coordinates (nodeX, nodeY, nodeZ), ux,uy,uz) ;
+    static void setNodeUPhysical (unsigned nodeX, unsigned nodeY, unsigned nodeZ,
+                                  const VelocityPhysical & uPhysical) 
+    {
+        pendingModificationsPtr->uPhysical.add (Coordinates (nodeX, nodeY, nodeZ), uPhysical) ;
+    }
 
-        return mrb_nil_value () ;
+    static void setNodeUBoundaryPhysical (unsigned nodeX, unsigned nodeY, unsigned nodeZ,
+                                          const VelocityPhysical & uPhysical) 
+    {
+        pendingModificationsPtr->uBoundaryPhysical.add (Coordinates (nodeX, nodeY, nodeZ), uPhysical) ;
     }
 
-    static mrb_value setNodeUBoundaryPhysical (mrb_state * state, mrb_value self) 
+    // Bulk variants - the whole box [begin, end] (inclusive) gets the same value.
+    static void checkRegion (const Coordinates & begin, const Coordinates & end)
     {
-        if ((mrb_get_argc (state)) != 4) 
+        if (begin.getX () > end.getX () || begin.getY () > end.getY () || 
+            begin.getZ () > end.getZ ())
         {
-            std::string comunicate {"Wrong number of arguments in :"} ; 
-            comunicate.append (__func__) ;
-            THROW (comunicate) ;
+            THROW ("Empty region") ;
         }
+    }
 
-        mrb_int mrb_nodeX ;          
-        mrb_int mrb_nodeY ;
-        mrb_int mrb_nodeZ ;
-        mrb_value mrb_uPhysical;
+    static void setRegionRhoPhysical (unsigned beginX, unsigned beginY, unsigned beginZ,
+                                      unsigned endX, unsigned endY, unsigned endZ,
+                                      double rhoPhysical) 
+    {
+        Coordinates begin (beginX, beginY, beginZ), end (endX, endY, endZ) ;
+        checkRegion (begin, end) ;
 
-        mrb_get_args (state, "iiiA", &mrb_nodeX, &mrb_nodeY, &mrb_nodeZ, &mrb_uPhysical) ;
+        pendingModificationsPtr->rhoPhysical.add (begin, end, rhoPhysical) ;
+    }
 
-        unsigned nodeX = convertTo<unsigned> (mrb_fixnum_value (mrb_nodeX)) ;
-        unsigned nodeY = convertTo<unsigned> (mrb_fixnum_value (mrb_nodeY)) ;
-        unsigned nodeZ = convertTo<unsigned> (mrb_fixnum_value (mrb_nodeZ)) ;
-        double ux = convertTo<double> (mrb_ary_entry (mrb_uPhysical, 0)) ;
-	    double uy = convertTo<double> (mrb_ary_entry (mrb_uPhysical, 1)) ;
-	    double uz = convertTo<double> (mrb_ary_entry (mrb_uPhysical, 2)) ;
+    static void setRegionRhoBoundaryPhysical (unsigned beginX, unsigned beginY, unsigned beginZ,
+                                              unsigned endX, unsigned endY, unsigned endZ,
+                                              double rhoPhysical) 
+    {
+        Coordinates begin (beginX, beginY, beginZ), end (endX, endY, endZ) ;
+        checkRegion (begin, end) ;
 
-        modificationsRhoUPtr->addUBoundaryPhysical (Coordinates (nodeX, nodeY, nodeZ), ux,uy,uz) ;
+        pendingModificationsPtr->rhoBoundaryPhysical.add (begin, end, rhoPhysical) ;
+    }
+
+    static void setRegionUPhysical (unsigned beginX, unsigned beginY, unsigned beginZ,
+                                    unsigned endX, unsigned endY, unsigned endZ,
+                                    const VelocityPhysical & uPhysical) 
+    {
+        Coordinates begin (beginX, beginY, beginZ), end (endX, endY, endZ) ;
+        checkRegion (begin, end) ;
 
-        return mrb_nil_value () ;
+        pendingModificationsPtr->uPhysical.add (begin, end, uPhysical) ;
     }
 
-    mrb_value createMRubyObject (mrb_state* mrb, const std::string& className)
+    static void setRegionUBoundaryPhysical (unsigned beginX, unsigned beginY, unsigned beginZ,
+                                            unsigned endX, unsigned endY, unsigned endZ,
+                                            const VelocityPhysical & uPhysical) 
     {
-        struct RClass *mrb_class ;
-        mrb_value mrb_object ;
-        mrb_class = mrb_define_class(mrb, className.c_str (), mrb->object_class) ;
-        mrb_object = mrb_obj_new (mrb, mrb_class, 0, NULL) ;
+        Coordinates begin (beginX, beginY, beginZ), end (endX, endY, endZ) ;
+        checkRegion (begin, end) ;
 
-        return mrb_object ;
+        pendingModificationsPtr->uBoundaryPhysical.add (begin, end, uPhysical) ;
     }
 
-    static mrb_value getNode (mrb_state * state, mrb_value self) 
+    /*
+        Bulk variants taking whole lists of nodes at once: coordinates as 
+        IntBuffers and values as FloatBuffers, all of the same size.
+    */
+    static const mrb_int * getNodesCoordinates (mrb_state * state,
+                                                mrb_value mrb_nodesX, mrb_value mrb_nodesY,
+                                                mrb_value mrb_nodesZ, mrb_int & numberOfNodes,
+                                                const mrb_int * & nodesY, const mrb_int * & nodesZ)
     {
-        if ((mrb_get_argc (state)) != 3) 
+        if (!mrb_int_buffer_p (mrb_nodesX) || !mrb_int_buffer_p (mrb_nodesY) || 
+            !mrb_int_buffer_p (mrb_nodesZ))
         {
-            std::string comunicate {"Wrong number of arguments in :"} ; 
-            comunicate.append (__func__) ;
-            THROW (comunicate) ;
+            throw MRubyTypeError ("Coordinates must be IntBuffers") ;
         }
 
-        mrb_int mrb_X ;          
-        mrb_int mrb_Y ;
-        mrb_int mrb_Z ;
+        mrb_int lengthY, lengthZ ;
+        const mrb_int * nodesX = mrb_int_buffer_ptr (state, mrb_nodesX, &numberOfNodes) ;
+        nodesY = mrb_int_buffer_ptr (state, mrb_nodesY, &lengthY) ;
+        nodesZ = mrb_int_buffer_ptr (state, mrb_nodesZ, &lengthZ) ;
 
-        mrb_get_args (state, "iii", &mrb_X, &mrb_Y, &mrb_Z) ;
+        if (lengthY != numberOfNodes || lengthZ != numberOfNodes)
+        {
+            throw MRubyArgumentError ("Buffers of different sizes") ;
+        }
+        for (mrb_int i = 0 ; i < numberOfNodes ; i++)
+        {
+            if (nodesX[i] < 0 || nodesY[i] < 0 || nodesZ[i] < 0)
+            {
+                throw MRubyArgumentError ("Negative coordinates") ;
+            }
+        }
 
-        unsigned x = convertTo<unsigned> (mrb_fixnum_value (mrb_X)) ;
-        unsigned y = convertTo<unsigned> (mrb_fixnum_value (mrb_Y)) ;
-        unsigned z = convertTo<unsigned> (mrb_fixnum_value (mrb_Z)) ;
+        return nodesX ;
+    }
 
-        mrb_value node = createMRubyObject (state, "Node") ;
+    static const double * getNodesValues (mrb_state * state, mrb_value mrb_values, 
+                                          mrb_int numberOfNodes)
+    {
+        if (!mrb_float_buffer_p (mrb_values))
+        {
+            throw MRubyTypeError ("Values must be FloatBuffers") ;
+        }
 
-        NodeType nodeType ;
-        Coordinates coordinates (x, y, z) ;
+        mrb_int length ;
+        const double * values = mrb_float_buffer_ptr (state, mrb_values, &length) ;
 
-        Size size = nodeLayoutPtr->getSize () ;
-        if (size.areCoordinatesInLimits (coordinates))
+        if (length != numberOfNodes)
         {
-            nodeType = nodeLayoutPtr->getNodeType (coordinates) ;
+            throw MRubyArgumentError ("Buffers of different sizes") ;
         }
-        else
+
+        return values ;
+    }
+
+    static void setNodesRhoPhysical (mrb_state * state, 
+                                     mrb_value mrb_nodesX, mrb_value mrb_nodesY, 
+                                     mrb_value mrb_nodesZ, mrb_value mrb_rhoPhysical) 
+    {
+        mrb_int numberOfNodes ;
+        const mrb_int * nodesY, * nodesZ ;
+        const mrb_int * nodesX = getNodesCoordinates (state, mrb_nodesX, mrb_nodesY, mrb_nodesZ,
+                                                      numberOfNodes, nodesY, nodesZ) ;
+        const double * rhoPhysical = getNodesValues (state, mrb_rhoPhysical, numberOfNodes) ;
+
+        for (mrb_int i = 0 ; i < numberOfNodes ; i++)
         {
-            logger << "WARNING: Can not get node type at " << coordinates 
-					 << ", coordinates outside of " << size << "\n" ;
-		    return mrb_nil_value () ;
+            pendingModificationsPtr->rhoPhysical.add 
+                (Coordinates (nodesX[i], nodesY[i], nodesZ[i]), rhoPhysical[i]) ;
         }
+    }
 
-        std::string baseTypeName = toString (nodeType.getBaseType()) ;
-        std::string placementModifierName = toString (nodeType.getPlacementModifier()) ;
+    static void setNodesUPhysical (mrb_state * state, 
+                                   mrb_value mrb_nodesX, mrb_value mrb_nodesY, 
+                                   mrb_value mrb_nodesZ, mrb_value mrb_uxPhysical, 
+                                   mrb_value mrb_uyPhysical, mrb_value mrb_uzPhysical) 
+    {
+        mrb_int numberOfNodes ;
+        const mrb_int * nodesY, * nodesZ ;
+        const mrb_int * nodesX = getNodesCoordinates (state, mrb_nodesX, mrb_nodesY, mrb_nodesZ,
+                                                      numberOfNodes, nodesY, nodesZ) ;
+        const double * ux = getNodesValues (state, mrb_uxPhysical, numberOfNodes) ;
+        const double * uy = getNodesValues (state, mrb_uyPhysical, numberOfNodes) ;
+        const double * uz = getNodesValues (state, mrb_uzPhysical, numberOfNodes) ;
+
+        for (mrb_int i = 0 ; i < numberOfNodes ; i++)
+        {
+            pendingModificationsPtr->uPhysical.add 
+                (Coordinates (nodesX[i], nodesY[i], nodesZ[i]), {{ux[i], uy[i], uz[i]}}) ;
+        }
+    }
 
-        mrb_iv_set(state, node, 
-                    mrb_intern_str (state, mrb_str_new_cstr (state, "@baseType")),
-                    mrb_str_new_cstr (state, baseTypeName.c_str())) ;
-        mrb_iv_set(state, node, 
-                    mrb_intern_str (state, mrb_str_new_cstr (state, "@placementModifier")),
-                    mrb_str_new_cstr (state, placementModifierName.c_str())) ;
+    // C string only - mrb_define_class may raise (longjmp) and would skip the
+    // destructor of a std::string temporary.
+    mrb_value createMRubyObject (mrb_state* mrb, const char * className)
+    {
+        struct RClass *mrb_class ;
+        mrb_value mrb_object ;
+        mrb_class = mrb_define_class(mrb, className, mrb->object_class) ;
+        mrb_object = mrb_obj_new (mrb, mrb_class, 0, NULL) ;
 
-        return node ;
+        return mrb_object ;
     }
 
-    static mrb_value getSize (mrb_state * state, mrb_value self) 
+    static mrb_value getNode (mrb_state * state, unsigned x, unsigned y, unsigned z) 
     {
-        if ((mrb_get_argc (state)) != 0) 
+        // Names are copied out of std::strings, which are destroyed at the end 
+        // of the block - before the first mruby call, that may raise.
+        char baseTypeName [64] = "" ;
+        char placementModifierName [64] = "" ;
         {
-            std::string comunicate {"Wrong number of arguments in :"} ; 
-            comunicate.append (__func__) ;
-            THROW (comunicate) ;
+            Coordinates coordinates (x, y, z) ;
+
+            Size size = nodeLayoutPtr->getSize () ;
+            if (!size.areCoordinatesInLimits (coordinates))
+            {
+                logger << "WARNING: Can not get node type at " << coordinates 
+                       << ", coordinates outside of " << size << "\n" ;
+                return mrb_nil_value () ;
+            }
+            NodeType nodeType = nodeLayoutPtr->getNodeType (coordinates) ;
+
+            std::strncpy (baseTypeName, toString (nodeType.getBaseType()).c_str (),
+                          sizeof (baseTypeName) - 1) ;
+            std::strncpy (placementModifierName, 
+                          toString (nodeType.getPlacementModifier()).c_str (),
+                          sizeof (placementModifierName) - 1) ;
         }
 
+        mrb_value node = createMRubyObject (state, "Node") ;
+        mrb_iv_set (state, node, mrb_intern_lit (state, "@baseType"),
+                    mrb_str_new_cstr (state, baseTypeName)) ;
+        mrb_iv_set (state, node, mrb_intern_lit (state, "@placementModifier"),
+                    mrb_str_new_cstr (state, placementModifierName)) ;
+
+        return node ;
+    }
+
+    static mrb_value getSize (mrb_state * state) 
+    {
         mrb_value size = createMRubyObject (state, "Size") ;
 
         Size nodeLayoutSize = nodeLayoutPtr->getSize () ;
@@ -413,35 +666,64 @@ namespace microflow
         return size ;
     }
 
+    // Set only while modifyNodeLayoutBySlices runs the modificator inside a Fiber.
+    static thread_local bool slicePipelineActive = false ;
+
+    static mrb_value sliceDone (mrb_state * state, unsigned z) 
+    {
+        // Plain modifyNodeLayout - scripts written for slices work unchanged.
+        if (!slicePipelineActive)
+        {
+            return mrb_nil_value () ;
+        }
+
+        mrb_value mrb_z = mrb_fixnum_value (z) ;
+        return mrb_fiber_yield (state, 1, &mrb_z) ;
+    }
+
     static void
     initializeRubyModifyLayout(mrb_state * state)
     {
         mrb_define_method (state, state->kernel_module, 
-                    "setNodeBaseType", setNodeBaseType, MRB_ARGS_REQ (4)) ;
+                    "setNodeBaseType", MRUBY_BIND (setNodeBaseType), MRB_ARGS_REQ (4)) ;
+        mrb_define_method (state, state->kernel_module, 
+                    "setNodePlacementModifier", MRUBY_BIND (setNodePlacementModifier), MRB_ARGS_REQ (4)) ;
+        mrb_define_method (state, state->kernel_module, 
+                    "setNodeRhoPhysical", MRUBY_BIND (setNodeRhoPhysical), MRB_ARGS_REQ (4)) ;
+        mrb_define_method (state, state->kernel_module, 
+                    "setNodeRhoBoundaryPhysical", MRUBY_BIND (setNodeRhoBoundaryPhysical), MRB_ARGS_REQ (4)) ;
+        mrb_define_method (state, state->kernel_module, 
+                    "setNodeUPhysical", MRUBY_BIND (setNodeUPhysical), MRB_ARGS_REQ (4)) ;
         mrb_define_method (state, state->kernel_module, 
-                    "setNodePlacementModifier", setNodePlacementModifier, MRB_ARGS_REQ (4)) ;
+                    "setNodeUBoundaryPhysical", MRUBY_BIND (setNodeUBoundaryPhysical), MRB_ARGS_REQ (4)) ;
         mrb_define_method (state, state->kernel_module, 
-                    "setNodeRhoPhysical", setNodeRhoPhysical, MRB_ARGS_REQ (4)) ;
+                    "setRegionRhoPhysical", MRUBY_BIND (setRegionRhoPhysical), MRB_ARGS_REQ (7)) ;
         mrb_define_method (state, state->kernel_module, 
-                    "setNodeRhoBoundaryPhysical", setNodeRhoBoundaryPhysical, MRB_ARGS_REQ (4)) ;
+                    "setRegionRhoBoundaryPhysical", MRUBY_BIND (setRegionRhoBoundaryPhysical), MRB_ARGS_REQ (7)) ;
         mrb_define_method (state, state->kernel_module, 
-                    "setNodeUPhysical", setNodeUPhysical, MRB_ARGS_REQ (4)) ;
+                    "setRegionUPhysical", MRUBY_BIND (setRegionUPhysical), MRB_ARGS_REQ (7)) ;
         mrb_define_method (state, state->kernel_module, 
-                    "setNodeUBoundaryPhysical", setNodeUBoundaryPhysical, MRB_ARGS_REQ (4)) ;
+                    "setRegionUBoundaryPhysical", MRUBY_BIND (setRegionUBoundaryPhysical), MRB_ARGS_REQ (7)) ;
         mrb_define_method (state, state->kernel_module, 
-                    "getNode", getNode, MRB_ARGS_REQ (3)) ;
+                    "setNodesRhoPhysical", MRUBY_BIND (setNodesRhoPhysical), MRB_ARGS_REQ (4)) ;
         mrb_define_method (state, state->kernel_module, 
-                    "getSize", getSize, MRB_ARGS_NONE ()) ;
+                    "setNodesUPhysical", MRUBY_BIND (setNodesUPhysical), MRB_ARGS_REQ (6)) ;
+        mrb_define_method (state, state->kernel_module, 
+                    "getNode", MRUBY_BIND (getNode), MRB_ARGS_REQ (3)) ;
+        mrb_define_method (state, state->kernel_module, 
+                    "getSize", MRUBY_BIND (getSize), MRB_ARGS_NONE ()) ;
+        mrb_define_method (state, state->kernel_module, 
+                    "sliceDone", MRUBY_BIND (sliceDone), MRB_ARGS_REQ (1)) ;
     }
 
-    ModificationRhoU MRubyInterpreter::
+    RegionModificationRhoU MRubyInterpreter::
     modifyNodeLayout (NodeLayout & nodeLayout, const std::string & rubyCode)
     {
         initializeRubyModifyLayout (state_) ;
 
         	nodeLayoutPtr = &nodeLayout ;
-	        ModificationRhoU modifications ;
-	        modificationsRhoUPtr = &modifications ;
+	        RegionModificationRhoU pendingModifications ;
+	        pendingModificationsPtr = &pendingModifications ;
 
             //TODO: Use xxd.
             #define STRINGIFY(x) #x
@@ -455,9 +737,85 @@ namespace microflow
             runScript (code.c_str ()) ;
 
             nodeLayoutPtr = nullptr ;
-            modificationsRhoUPtr = nullptr ;
+            pendingModificationsPtr = nullptr ;
+
+            return pendingModifications ;
+    }
+
+    RegionModificationRhoU MRubyInterpreter::
+    modifyNodeLayoutBySlices (NodeLayout & nodeLayout, const std::string & rubyCode,
+                              const SliceDoneCallback & onSliceDone)
+    {
+        initializeRubyModifyLayout (state_) ;
+
+        nodeLayoutPtr = &nodeLayout ;
+        RegionModificationRhoU pendingModifications ;
+        pendingModificationsPtr = &pendingModifications ;
+
+        #define STRINGIFY(x) #x
+        const char * script = 
+                #include "modifyNodeLayout.rb"
+                ;
+        #undef STRINGIFY
+
+        // Modificator runs as a Fiber body, sliceDone(z) yields z to the loop
+        // below. Resumed through a prepared lambda, so a Ruby exception in the
+        // modificator is rethrown here as a C++ exception.
+        std::string code = std::string (script) + 
+            "\n$microflowSliceFiber = Fiber.new do\n" + rubyCode + "\nnil\nend\n"
+            "$microflowSliceResume = lambda do\n"
+            "  z = $microflowSliceFiber.resume\n"
+            "  $microflowSliceFiber.alive? ? z : -1\n"
+            "end\n" ;
+
+        try
+        {
+            runScript (code) ;
+            std::unique_ptr<MRubyCallable> resume = prepareCallable ("$microflowSliceResume") ;
+
+            slicePipelineActive = true ;
+            for (int z = resume->call<int> () ; z >= 0 ; z = resume->call<int> ())
+            {
+                RegionModificationRhoU sliceModifications ;
+                std::swap (sliceModifications, pendingModifications) ;
+
+                onSliceDone (static_cast<unsigned> (z), std::move (sliceModifications)) ;
+            }
+        }
+        catch (...)
+        {
+            slicePipelineActive = false ;
+            nodeLayoutPtr = nullptr ;
+            pendingModificationsPtr = nullptr ;
+            runScript ("$microflowSliceFiber = nil ; $microflowSliceResume = nil") ;
+            throw ;
+        }
+
+        slicePipelineActive = false ;
+        nodeLayoutPtr = nullptr ;
+        pendingModificationsPtr = nullptr ;
+        runScript ("$microflowSliceFiber = nil ; $microflowSliceResume = nil") ;
 
-            return modifications ;
+        return pendingModifications ;
+    }
+
+    std::future<RegionModificationRhoU> MRubyInterpreter::
+    modifyNodeLayoutAsync (NodeLayout & nodeLayout, const std::string & rubyCode,
+                           const std::string & setupCode)
+    {
+        NodeLayout * nodeLayoutToModify = &nodeLayout ;
+
+        return std::async (std::launch::async, 
+            [nodeLayoutToModify, rubyCode, setupCode] () 
+            {
+                std::unique_ptr<MRubyInterpreter> interpreter = getMRubyInterpreter () ;
+
+                if (!setupCode.empty ())
+                {
+                    interpreter->runScript (setupCode) ;
+                }
+                return interpreter->modifyNodeLayout (*nodeLayoutToModify, rubyCode) ;
+            }) ;
     }
 
     void MRubyInterpreter::
@@ -469,6 +827,7 @@ namespace microflow
         {
             THROW ("Ruby exception: could not open ruby interpreter") ;
         }
+        value_ = mrb_nil_value () ;
     }
 }
 
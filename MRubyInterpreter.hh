@@ -0,0 +1,220 @@
+/*
+Created by Szymon Bagiński
+baginski.szymon@gmail.com
+Wrocław University of Technology
+Dec 2017
+*/
+
+#ifndef MRUBY_INTERPRETER_HH
+#define MRUBY_INTERPRETER_HH
+
+#include <array>
+#include <map>
+#include <type_traits>
+#include <vector>
+#include <mruby/array.h>
+#include <mruby/hash.h>
+#include <mruby/string.h>
+
+#include "Exceptions.hpp"
+
+namespace microflow
+{
+    template<typename Type>
+    Type convertTo (mrb_value rubyVariable) ;
+
+    template<> double convertTo<double> (mrb_value rubyVariable) ;
+    template<> std::string convertTo<std::string> (mrb_value rubyVariable) ;
+    template<> unsigned convertTo<unsigned> (mrb_value rubyVariable) ;
+    template<> int convertTo<int> (mrb_value rubyVariable) ;
+    template<> bool convertTo<bool> (mrb_value rubyVariable) ;
+    template<> std::vector<double> convertTo<std::vector<double>> (mrb_value rubyVariable) ;
+
+    /*
+        Conversion of Ruby values into C++ types, including containers and their
+        nested combinations. Arrays are converted in one pass directly over
+        RARRAY_PTR, hashes directly over their hash table - no temporary Ruby 
+        objects are created.
+    */
+    template<typename Type>
+    struct MRubyConverter
+    {
+        static Type convert (mrb_state *, mrb_value rubyVariable)
+        {
+            return convertTo<Type> (rubyVariable) ;
+        }
+    } ;
+
+    template<typename Type>
+    struct MRubyConverter<std::vector<Type>>
+    {
+        static std::vector<Type> convert (mrb_state * state, mrb_value rubyVariable)
+        {
+            if (!mrb_array_p (rubyVariable))
+            {
+                THROW ("Ruby exception: ruby variable is not an array") ;
+            }
+
+            const mrb_int length = RARRAY_LEN (rubyVariable) ;
+            const mrb_value * elements = RARRAY_PTR (rubyVariable) ;
+
+            std::vector<Type> result ;
+            result.reserve (length) ;
+            for (mrb_int i = 0 ; i < length ; i++)
+            {
+                result.push_back (MRubyConverter<Type>::convert (state, elements[i])) ;
+            }
+            return result ;
+        }
+    } ;
+
+    template<>  // FloatBuffer is accepted too
+    struct MRubyConverter<std::vector<double>>
+    {
+        static std::vector<double> convert (mrb_state *, mrb_value rubyVariable)
+        {
+            return convertTo<std::vector<double>> (rubyVariable) ;
+        }
+    } ;
+
+    template<typename Type, size_t Size>
+    struct MRubyConverter<std::array<Type, Size>>
+    {
+        static std::array<Type, Size> convert (mrb_state * state, mrb_value rubyVariable)
+        {
+            if (!mrb_array_p (rubyVariable) || RARRAY_LEN (rubyVariable) != (mrb_int) Size)
+            {
+                THROW ("Ruby exception: ruby variable is not an array of required size") ;
+            }
+
+            const mrb_value * elements = RARRAY_PTR (rubyVariable) ;
+
+            std::array<Type, Size> result ;
+            for (size_t i = 0 ; i < Size ; i++)
+            {
+                result[i] = MRubyConverter<Type>::convert (state, elements[i]) ;
+            }
+            return result ;
+        }
+    } ;
+
+    template<typename Type>  // keys must be strings or symbols
+    struct MRubyConverter<std::map<std::string, Type>>
+    {
+        static std::map<std::string, Type> convert (mrb_state * state, mrb_value rubyVariable)
+        {
+            if (!mrb_hash_p (rubyVariable))
+            {
+                THROW ("Ruby exception: ruby variable is not a hash") ;
+            }
+
+            std::map<std::string, Type> result ;
+
+            struct kh_ht * table = RHASH_TBL (rubyVariable) ;
+            if (nullptr == table) return result ;
+
+            for (khiter_t k = kh_begin (table) ; k != kh_end (table) ; k++)
+            {
+                if (!kh_exist (table, k)) continue ;
+
+                mrb_value key = kh_key (table, k) ;
+                std::string keyName ;
+
+                if (mrb_string_p (key))
+                {
+                    keyName.assign (RSTRING_PTR (key), RSTRING_LEN (key)) ;
+                }
+                else if (mrb_symbol_p (key))
+                {
+                    mrb_int length ;
+                    const char * name = mrb_sym2name_len (state, mrb_symbol (key), &length) ;
+                    keyName.assign (name, length) ;
+                }
+                else
+                {
+                    THROW ("Ruby exception: hash key is not a string or symbol") ;
+                }
+
+                result.emplace (std::move (keyName), 
+                                MRubyConverter<Type>::convert (state, kh_value (table, k).v)) ;
+            }
+            return result ;
+        }
+    } ;
+
+    template<>
+    struct MRubyConverter<mrb_value>
+    {
+        static mrb_value convert (mrb_state *, mrb_value rubyVariable)
+        {
+            return rubyVariable ;
+        }
+    } ;
+
+    template<>
+    struct MRubyConverter<void>
+    {
+        static void convert (mrb_state *, mrb_value)
+        {
+        }
+    } ;
+
+    inline mrb_value toMRubyValue (mrb_state * state, double value)
+    {
+        return mrb_float_value (state, value) ;
+    }
+
+    inline mrb_value toMRubyValue (mrb_state *, int value)
+    {
+        return mrb_fixnum_value (value) ;
+    }
+
+    inline mrb_value toMRubyValue (mrb_state *, unsigned value)
+    {
+        return mrb_fixnum_value (value) ;
+    }
+
+    inline mrb_value toMRubyValue (mrb_state *, bool value)
+    {
+        return mrb_bool_value (value) ;
+    }
+
+    inline mrb_value toMRubyValue (mrb_state *, mrb_value value)
+    {
+        return value ;
+    }
+
+    template<class ResultType, class ... ArgumentTypes>
+    ResultType MRubyCallable::
+    call (ArgumentTypes ... arguments)
+    {
+        // Arguments are passed from the C++ stack, nothing is allocated per call.
+        const mrb_value argv [sizeof... (ArgumentTypes) + 1] = 
+            { toMRubyValue (state_, arguments) ... } ;
+
+        MRubyArenaGuard arenaGuard (state_) ;
+        mrb_value result = invoke (sizeof... (ArgumentTypes), argv) ;
+        if (std::is_same<ResultType, mrb_value>::value)
+        {
+            arenaGuard.keep (result) ;
+        }
+        return MRubyConverter<ResultType>::convert (state_, result) ;
+    }
+
+    template<class VariableType >
+    VariableType MRubyInterpreter::
+    getMRubyVariable (const std::string & variableName)
+    {
+        mrb_sym symbol = mrb_intern (state_, variableName.c_str(), variableName.size()) ;
+        mrb_value rubyVariable = mrb_gv_get (state_, symbol) ;
+
+        //checking whether the variable exists
+        if (mrb_nil_p (rubyVariable))    
+        {
+            THROW ("Ruby exception: ruby variable does not exist") ;
+        }
+        return MRubyConverter<VariableType>::convert (state_, rubyVariable) ;
+    }
+}
+
+#endif
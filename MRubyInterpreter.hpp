@@ -8,8 +8,15 @@ Dec 2017
 #ifndef MRUBY_INTERPRETER_HPP
 #define MRUBY_INTERPRETER_HPP
 
+#include <array>
+#include <functional>
+#include <future>
+#include <list>
+#include <unordered_map>
 #include <memory>
 #include <string>
+#include <vector>
+#include <cstdint>
 #include <mruby.h>
 #include <mruby/compile.h>
 #include <mruby/proc.h>
@@ -21,28 +28,300 @@ Dec 2017
 
 namespace microflow
 {
+    /*
+        Uniform rho/u modifications kept as (box, value) entries. Single node
+        writes are coalesced with the previous entry, when they extend it along
+        one axis, so rows, planes and boxes filled in loops collapse into one
+        entry. Entries are expanded to single nodes only when the modifications
+        are applied (forEachNode).
+    */
+    template<class ValueType>
+    class RegionModifications
+    {
+    public:
+        // Inclusive box.
+        struct Region
+        {
+            unsigned begin [3] ;
+            unsigned end   [3] ;
+            ValueType value ;
+
+            size_t getNumberOfNodes () const
+            {
+                return size_t (end[0] - begin[0] + 1) *
+                       size_t (end[1] - begin[1] + 1) *
+                       size_t (end[2] - begin[2] + 1) ;
+            }
+        } ;
+
+        void add (const Coordinates & begin, const Coordinates & end,
+                  const ValueType & value)
+        {
+            add (Region {{begin.getX(), begin.getY(), begin.getZ()},
+                         {end.getX(), end.getY(), end.getZ()}, value}) ;
+        }
+
+        void add (const Coordinates & node, const ValueType & value)
+        {
+            add (node, node, value) ;
+        }
+
+        // Later entries override earlier ones, as for consecutive writes.
+        void append (const RegionModifications & other)
+        {
+            for (const Region & region : other.regions_)
+            {
+                add (region) ;
+            }
+        }
+
+        template<class Function>
+        void forEachNode (Function function) const
+        {
+            for (const Region & region : regions_)
+            {
+                for (unsigned z = region.begin[2] ; z <= region.end[2] ; z++)
+                    for (unsigned y = region.begin[1] ; y <= region.end[1] ; y++)
+                        for (unsigned x = region.begin[0] ; x <= region.end[0] ; x++)
+                        {
+                            function (Coordinates (x, y, z), region.value) ;
+                        }
+            }
+        }
+
+        const std::vector<Region> & getRegions () const
+        {
+            return regions_ ;
+        }
+
+        size_t getNumberOfRegions () const
+        {
+            return regions_.size () ;
+        }
+
+        size_t getNumberOfNodes () const
+        {
+            size_t numberOfNodes = 0 ;
+            for (const Region & region : regions_)
+            {
+                numberOfNodes += region.getNumberOfNodes () ;
+            }
+            return numberOfNodes ;
+        }
+
+    private:
+        void add (const Region & region)
+        {
+            if (regions_.empty () || !merge (regions_.back (), region))
+            {
+                regions_.push_back (region) ;
+            }
+            // Completed row may close a plane, completed plane may close a box.
+            while (regions_.size () > 1 &&
+                   merge (regions_[regions_.size () - 2], regions_.back ()))
+            {
+                regions_.pop_back () ;
+            }
+        }
+
+        // Merges "next" into "previous" when the result is still a box with
+        // the same value. Order of entries is preserved, because only
+        // neighbouring entries are merged.
+        static bool merge (Region & previous, const Region & next)
+        {
+            if (!(previous.value == next.value)) return false ;
+
+            unsigned equalAxes = 0 ;
+            int differentAxis = -1 ;
+            for (int axis = 0 ; axis < 3 ; axis++)
+            {
+                if (previous.begin[axis] == next.begin[axis] && 
+                    previous.end  [axis] == next.end  [axis])
+                {
+                    equalAxes ++ ;
+                }
+                else
+                {
+                    differentAxis = axis ;
+                }
+            }
+
+            if (3 == equalAxes) return true ;
+            if (2 != equalAxes) return false ;
+
+            if (previous.end[differentAxis] + 1 == next.begin[differentAxis])
+            {
+                previous.end[differentAxis] = next.end[differentAxis] ;
+                return true ;
+            }
+            if (next.end[differentAxis] + 1 == previous.begin[differentAxis])
+            {
+                previous.begin[differentAxis] = next.begin[differentAxis] ;
+                return true ;
+            }
+            return false ;
+        }
+
+        std::vector<Region> regions_ ;
+    } ;
+
+    typedef std::array<double,3> VelocityPhysical ;
+
+    /*
+        Result of a geometry modificator. Much smaller than ModificationRhoU for
+        modificators setting large boxes (inlets, initial rho), applyTo expands
+        it into ModificationRhoU - do it only where the nodes are consumed.
+    */
+    struct RegionModificationRhoU
+    {
+        RegionModifications<double> rhoPhysical ;
+        RegionModifications<double> rhoBoundaryPhysical ;
+        RegionModifications<VelocityPhysical> uPhysical ;
+        RegionModifications<VelocityPhysical> uBoundaryPhysical ;
+
+        RegionModificationRhoU & operator+= (const RegionModificationRhoU & other) ;
+        void applyTo (ModificationRhoU & modifications) const ;
+    } ;
+
+    /*
+        Restores the GC arena on scope exit, also when a C++ exception leaves
+        the scope - otherwise every throw would leak the arena slots of objects
+        created so far. keep() protects a value which must outlive the scope.
+    */
+    class MRubyArenaGuard
+    {
+    public:
+        explicit MRubyArenaGuard (mrb_state * state) :
+        state_ (state), arenaIndex_ (mrb_gc_arena_save (state)), 
+        kept_ (mrb_nil_value ())
+        {
+        }
+
+        ~MRubyArenaGuard ()
+        {
+            mrb_gc_arena_restore (state_, arenaIndex_) ;
+            mrb_gc_protect (state_, kept_) ;
+        }
+
+        void keep (mrb_value value)
+        {
+            kept_ = value ;
+        }
+
+    private:
+        MRubyArenaGuard (const MRubyArenaGuard &) = delete ;
+        MRubyArenaGuard & operator= (const MRubyArenaGuard &) = delete ;
+
+        mrb_state * state_ ;
+        int arenaIndex_ ;
+        mrb_value kept_ ;
+    } ;
+
+    /*
+        Ruby method or proc resolved once, cheap to call many times - e.g. time 
+        dependent boundary conditions evaluated every LBM step. Method is looked 
+        up at preparation time, later redefinitions are not seen by the handle.
+    */
+    class MRubyCallable
+    {
+    public:
+        ~MRubyCallable () ;
+
+        // ResultType may be also void (result ignored) or mrb_value (returned
+        // as is, protected in the GC arena of the caller).
+        template<class ResultType, class ... ArgumentTypes>
+        ResultType call (ArgumentTypes ... arguments) ;
+
+    private:
+        friend class MRubyInterpreter ;
+
+        MRubyCallable (mrb_state * state, mrb_value procedure, mrb_value self, 
+                       struct RClass * targetClass) ;
+        MRubyCallable (const MRubyCallable &) = delete ;
+        MRubyCallable & operator= (const MRubyCallable &) = delete ;
+
+        mrb_value invoke (mrb_int argc, const mrb_value * argv) ;
+
+        mrb_state * state_ ;
+        mrb_value procedure_ ;
+        mrb_value self_ ;
+        struct RClass * targetClass_ ;
+    } ;
+
     class MRubyInterpreter
     {       
     public:
 
         static std::unique_ptr<MRubyInterpreter> getMRubyInterpreter () ;
         ~MRubyInterpreter () ;
+        // Scripts are compiled once and kept in a small cache (most recently 
+        // used), returned value is valid until the next run.
         mrb_value runScript (const std::string&) ;
 
+        // Compiled script (mruby bytecode), may be run in many interpreters, 
+        // also concurrently. Interpreter keeps a reference to each bytecode it 
+        // has run, because loaded code points into the buffer.
+        typedef std::shared_ptr<const std::vector<uint8_t>> Bytecode ;
+        Bytecode compile (const std::string & code) ;
+        mrb_value runBytecode (const Bytecode & bytecode) ;
+
         template<class VariableType >
         VariableType getMRubyVariable (const std::string & variableName) ;
         
-        ModificationRhoU modifyNodeLayout (NodeLayout & nodeLayout, const std::string & rubyCode) ;
+        RegionModificationRhoU modifyNodeLayout (NodeLayout & nodeLayout, const std::string & rubyCode) ;
+
+        // Called after the modificator finishes slice z: node types of slices
+        // 0..z are final and sliceModifications holds the rho/u modifications 
+        // made since the previous call. Runs on the interpreter thread - hand 
+        // heavy work (lattice initialization) over to other threads.
+        typedef std::function<void (unsigned z, RegionModificationRhoU && sliceModifications)> 
+            SliceDoneCallback ;
+
+        // Runs modificator inside a Ruby Fiber. Each sliceDone(z) in the script
+        // suspends it and calls onSliceDone. Modifications made after the last
+        // sliceDone are returned. In modifyNodeLayout sliceDone does nothing.
+        RegionModificationRhoU modifyNodeLayoutBySlices (NodeLayout & nodeLayout, 
+                                                         const std::string & rubyCode,
+                                                         const SliceDoneCallback & onSliceDone) ;
+
+        // Name of top level method (e.g. "inletVelocity") or of global variable 
+        // holding a proc (e.g. "$inletVelocity").
+        std::unique_ptr<MRubyCallable> prepareCallable (const std::string & name) ;
+
+        // Runs modificator on a worker thread with its own interpreter. setupCode
+        // is run in the new interpreter before the modificator (for example the
+        // configuration script defining constants used by the modificator).
+        // nodeLayout must not be touched until the returned future is ready.
+        static std::future<RegionModificationRhoU> 
+        modifyNodeLayoutAsync (NodeLayout & nodeLayout, const std::string & rubyCode,
+                               const std::string & setupCode = "") ;
 
     private:
         MRubyInterpreter () ; 
         void initializeMRubyInterpreter () ;
         void closeMRubyInterpreter ();
 
+        struct RProc * generateCode (const std::string & code) ;
+        struct RProc * getCompiledScript (const std::string & code) ;
+        // Protects result of the last script from GC.
+        void keepResult (mrb_value result) ;
+
+        friend class MRubyCallable ;
+        // Logs pending Ruby exception, clears it and throws.
+        static void throwRubyException (mrb_state * state) ;
+
         mrb_state* state_ = nullptr ;
         mrbc_context * context_ ;
         mrb_value value_ ;        
+        std::vector<Bytecode> loadedBytecode_ ;
+
+        typedef std::list<std::pair<std::string, struct RProc *>> CompiledScripts ;
+        static const size_t maxNumberOfCompiledScripts = 64 ;
+        CompiledScripts compiledScripts_ ;
+        std::unordered_map<std::string, CompiledScripts::iterator> compiledScriptsIndex_ ;
     } ;
 }
 
+#include "MRubyInterpreter.hh"
+
 #endif
\ No newline at end of file
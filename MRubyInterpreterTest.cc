@@ -11,6 +11,13 @@ Dec 2017
 
 using namespace microflow ;
 
+static ModificationRhoU expand (const RegionModificationRhoU & regionModifications)
+{
+	ModificationRhoU modifications ;
+	regionModifications.applyTo (modifications) ;
+	return modifications ;
+}
+
 TEST (MRubyInterpreter, constructor_destructor)
 {
 	EXPECT_NO_THROW( MRubyInterpreter::getMRubyInterpreter() ; ) ;
@@ -141,8 +148,8 @@ TEST (MRubyInterpreter, modifyNodeLayout_setNode_variants)
 	EXPECT_EQ (nodeLayout.getNodeType(1,1,1).getBaseType(), NodeBaseType::VELOCITY) ;
 	EXPECT_EQ (nodeLayout.getNodeType(1,1,1).getPlacementModifier(), PlacementModifier::BOTTOM) ;
 
-	auto modificationsRhoU = ri->modifyNodeLayout (nodeLayout, 
-		"setNodes( coordinates( 1,1,1 ), :rhoPhysical => 0.5) ; ") ;
+	auto modificationsRhoU = expand (ri->modifyNodeLayout (nodeLayout, 
+		"setNodes( coordinates( 1,1,1 ), :rhoPhysical => 0.5) ; ")) ;
 
 	EXPECT_EQ (nodeLayout.getNodeType(1,1,1).getBaseType(), NodeBaseType::VELOCITY) ;
 	EXPECT_EQ (nodeLayout.getNodeType(1,1,1).getPlacementModifier(), PlacementModifier::BOTTOM) ;
@@ -153,8 +160,8 @@ TEST (MRubyInterpreter, modifyNodeLayout_setNode_variants)
 	EXPECT_EQ (modificationsRhoU.rhoPhysical[0].coordinates, Coordinates(1,1,1) ) ;
 	EXPECT_EQ (modificationsRhoU.rhoPhysical[0].value, 0.5 ) ;
 
-	modificationsRhoU = ri->modifyNodeLayout (nodeLayout, 
-		"setNodes( coordinates( 2,2,2 ), :rhoBoundaryPhysical => 0.25) ; ") ;
+	modificationsRhoU = expand (ri->modifyNodeLayout (nodeLayout, 
+		"setNodes( coordinates( 2,2,2 ), :rhoBoundaryPhysical => 0.25) ; ")) ;
 
 	EXPECT_EQ (nodeLayout.getNodeType(1,1,1).getBaseType(), NodeBaseType::VELOCITY) ;
 	EXPECT_EQ (nodeLayout.getNodeType(1,1,1).getPlacementModifier(), PlacementModifier::BOTTOM) ;
@@ -165,8 +172,8 @@ TEST (MRubyInterpreter, modifyNodeLayout_setNode_variants)
 	EXPECT_EQ (modificationsRhoU.rhoBoundaryPhysical[0].coordinates, Coordinates(2,2,2) ) ;
 	EXPECT_EQ (modificationsRhoU.rhoBoundaryPhysical[0].value, 0.25 ) ;
 
-	modificationsRhoU = ri->modifyNodeLayout (nodeLayout, 
-		"setNodes( coordinates( 2,2,2 ), :uPhysical => [1.5, 2.5, 3.5] ) ; ") ;
+	modificationsRhoU = expand (ri->modifyNodeLayout (nodeLayout, 
+		"setNodes( coordinates( 2,2,2 ), :uPhysical => [1.5, 2.5, 3.5] ) ; ")) ;
 
 	EXPECT_EQ (nodeLayout.getNodeType(1,1,1).getBaseType(), NodeBaseType::VELOCITY) ;
 	EXPECT_EQ (nodeLayout.getNodeType(1,1,1).getPlacementModifier(), PlacementModifier::BOTTOM) ;
@@ -179,8 +186,8 @@ TEST (MRubyInterpreter, modifyNodeLayout_setNode_variants)
 	EXPECT_EQ (modificationsRhoU.uPhysical[0].value[1], 2.5 ) ;
 	EXPECT_EQ (modificationsRhoU.uPhysical[0].value[2], 3.5 ) ;
 
-	modificationsRhoU = ri->modifyNodeLayout (nodeLayout, 
-		"setNodes( coordinates( 1,2,3 ), :uBoundaryPhysical => [10.0, 11.0, 12.0] ) ; ") ;
+	modificationsRhoU = expand (ri->modifyNodeLayout (nodeLayout, 
+		"setNodes( coordinates( 1,2,3 ), :uBoundaryPhysical => [10.0, 11.0, 12.0] ) ; ")) ;
 
 	EXPECT_EQ (nodeLayout.getNodeType(1,1,1).getBaseType(), NodeBaseType::VELOCITY) ;
 	EXPECT_EQ (nodeLayout.getNodeType(1,1,1).getPlacementModifier(), PlacementModifier::BOTTOM) ;
@@ -192,4 +199,406 @@ TEST (MRubyInterpreter, modifyNodeLayout_setNode_variants)
 	EXPECT_EQ (modificationsRhoU.uBoundaryPhysical[0].value[0], 10 ) ;
 	EXPECT_EQ (modificationsRhoU.uBoundaryPhysical[0].value[1], 11 ) ;
 	EXPECT_EQ (modificationsRhoU.uBoundaryPhysical[0].value[2], 12 ) ;
-}
\ No newline at end of file
+}
+TEST (MRubyInterpreter, modifyNodeLayout_setRegion_variants)
+{
+	std::unique_ptr<MRubyInterpreter> ri = nullptr ;
+
+	EXPECT_NO_THROW( ri = MRubyInterpreter::getMRubyInterpreter() ; ) ;
+
+	NodeLayout nodeLayout = createSolidNodeLayout (4,4,4) ;
+
+	auto regionModificationsRhoU = ri->modifyNodeLayout (nodeLayout, 
+		"setRegionRhoPhysical(0,0,0, 1,1,0, 0.5) ; "
+		"setRegionUBoundaryPhysical(1,2,3, 1,2,3, [10.0, 11.0, 12.0]) ; ") ;
+
+	EXPECT_EQ (regionModificationsRhoU.rhoPhysical.getNumberOfRegions(), 1u) ;
+	EXPECT_EQ (regionModificationsRhoU.rhoPhysical.getNumberOfNodes(), 4u) ;
+	EXPECT_EQ (regionModificationsRhoU.uBoundaryPhysical.getNumberOfRegions(), 1u) ;
+
+	auto modificationsRhoU = expand (regionModificationsRhoU) ;
+
+	ASSERT_EQ (modificationsRhoU.rhoPhysical.size(), 4u) ;
+	EXPECT_EQ (modificationsRhoU.uPhysical.size(), 0u) ;
+	EXPECT_EQ (modificationsRhoU.rhoBoundaryPhysical.size(), 0u) ;
+	ASSERT_EQ (modificationsRhoU.uBoundaryPhysical.size(), 1u) ;
+	EXPECT_EQ (modificationsRhoU.rhoPhysical[0].coordinates, Coordinates(0,0,0) ) ;
+	EXPECT_EQ (modificationsRhoU.rhoPhysical[3].coordinates, Coordinates(1,1,0) ) ;
+	EXPECT_EQ (modificationsRhoU.rhoPhysical[3].value, 0.5 ) ;
+	EXPECT_EQ (modificationsRhoU.uBoundaryPhysical[0].coordinates, Coordinates(1,2,3) ) ;
+	EXPECT_EQ (modificationsRhoU.uBoundaryPhysical[0].value[2], 12 ) ;
+
+	EXPECT_ANY_THROW (ri->modifyNodeLayout (nodeLayout, 
+		"setRegionRhoPhysical(1,0,0, 0,1,1, 0.5) ; ")) ;
+}
+
+TEST (MRubyInterpreter, modifyNodeLayout_consecutive_writes_coalesced)
+{
+	std::unique_ptr<MRubyInterpreter> ri = nullptr ;
+
+	EXPECT_NO_THROW( ri = MRubyInterpreter::getMRubyInterpreter() ; ) ;
+
+	NodeLayout nodeLayout = createSolidNodeLayout (4,4,4) ;
+
+	auto regionModificationsRhoU = ri->modifyNodeLayout (nodeLayout, 
+		"for z in 0..3 ; for y in 0..3 ; for x in 0..3 ; "
+		"  setNodeRhoPhysical(x,y,z, 2.0) ; "
+		"end ; end ; end ; "
+		"setNodeRhoPhysical(3,3,3, 1.0) ; ") ;
+
+	// Whole box and the overriding node.
+	ASSERT_EQ (regionModificationsRhoU.rhoPhysical.getNumberOfRegions(), 2u) ;
+	EXPECT_EQ (regionModificationsRhoU.rhoPhysical.getRegions()[0].getNumberOfNodes(), 64u) ;
+
+	auto modificationsRhoU = expand (regionModificationsRhoU) ;
+
+	ASSERT_EQ (modificationsRhoU.rhoPhysical.size(), 65u) ;
+	EXPECT_EQ (modificationsRhoU.rhoPhysical[0].coordinates, Coordinates(0,0,0) ) ;
+	EXPECT_EQ (modificationsRhoU.rhoPhysical[63].coordinates, Coordinates(3,3,3) ) ;
+	EXPECT_EQ (modificationsRhoU.rhoPhysical[63].value, 2.0 ) ;
+	EXPECT_EQ (modificationsRhoU.rhoPhysical[64].coordinates, Coordinates(3,3,3) ) ;
+	EXPECT_EQ (modificationsRhoU.rhoPhysical[64].value, 1.0 ) ;
+}
+
+TEST (MRubyInterpreter, regionModifications_append)
+{
+	RegionModificationRhoU modificationsRhoU ;
+	RegionModificationRhoU finalModificationsRhoU ;
+
+	modificationsRhoU.rhoPhysical.add (Coordinates(0,0,0), Coordinates(3,3,1), 1.0) ;
+	finalModificationsRhoU.rhoPhysical.add (Coordinates(0,0,2), Coordinates(3,3,3), 1.0) ;
+	finalModificationsRhoU.rhoPhysical.add (Coordinates(1,1,1), 2.0) ;
+
+	modificationsRhoU += finalModificationsRhoU ;
+
+	EXPECT_EQ (modificationsRhoU.rhoPhysical.getNumberOfRegions(), 2u) ;
+	EXPECT_EQ (modificationsRhoU.rhoPhysical.getNumberOfNodes(), 65u) ;
+
+	ModificationRhoU expanded = expand (modificationsRhoU) ;
+	ASSERT_EQ (expanded.rhoPhysical.size(), 65u) ;
+	EXPECT_EQ (expanded.rhoPhysical[64].coordinates, Coordinates(1,1,1) ) ;
+	EXPECT_EQ (expanded.rhoPhysical[64].value, 2.0 ) ;
+}
+
+TEST (MRubyInterpreter, modifyNodeLayoutAsync)
+{
+	NodeLayout nodeLayout = createSolidNodeLayout (4,4,4) ;
+
+	std::future<RegionModificationRhoU> pendingModification = 
+		MRubyInterpreter::modifyNodeLayoutAsync (nodeLayout, 
+			"setNodes( coordinates(1,1,1), :baseType => fluid) ; "
+			"setNodeRhoPhysical(2,2,2, Rho) ; ",
+			"Rho = 0.75") ;
+
+	ModificationRhoU modificationsRhoU ;
+	EXPECT_NO_THROW (modificationsRhoU = expand (pendingModification.get ())) ;
+
+	EXPECT_EQ (nodeLayout.getNodeType(1,1,1), NodeBaseType::FLUID) ;
+	ASSERT_EQ (modificationsRhoU.rhoPhysical.size(), 1u) ;
+	EXPECT_EQ (modificationsRhoU.rhoPhysical[0].coordinates, Coordinates(2,2,2) ) ;
+	EXPECT_EQ (modificationsRhoU.rhoPhysical[0].value, 0.75 ) ;
+}
+
+TEST (MRubyInterpreter, modifyNodeLayoutAsync_error_in_script)
+{
+	NodeLayout nodeLayout = createSolidNodeLayout (4,4,4) ;
+
+	std::future<RegionModificationRhoU> pendingModification = 
+		MRubyInterpreter::modifyNodeLayoutAsync (nodeLayout, "undefinedMethod()") ;
+
+	EXPECT_ANY_THROW (pendingModification.get ()) ;
+}
+
+TEST (MRubyInterpreter, getMRubyVariable_vector_double)
+{
+	std::unique_ptr<MRubyInterpreter> ri = nullptr ;
+
+	EXPECT_NO_THROW( ri = MRubyInterpreter::getMRubyInterpreter() ; ) ;
+	EXPECT_NO_THROW( ri->runScript("$a = FloatBuffer.from_a([1.0, 2.5, 3.0])[1,2]") ; ) ;
+	EXPECT_NO_THROW( ri->runScript("$b = [4, 5.5]") ; ) ;
+
+	std::vector<double> a = ri->getMRubyVariable<std::vector<double>>("$a") ;
+	ASSERT_EQ (a.size(), 2u) ;
+	EXPECT_EQ (a[0], 2.5) ;
+	EXPECT_EQ (a[1], 3.0) ;
+
+	std::vector<double> b = ri->getMRubyVariable<std::vector<double>>("$b") ;
+	ASSERT_EQ (b.size(), 2u) ;
+	EXPECT_EQ (b[0], 4.0) ;
+	EXPECT_EQ (b[1], 5.5) ;
+}
+
+TEST (MRubyInterpreter, modifyNodeLayout_setNodes_buffers)
+{
+	std::unique_ptr<MRubyInterpreter> ri = nullptr ;
+
+	EXPECT_NO_THROW( ri = MRubyInterpreter::getMRubyInterpreter() ; ) ;
+
+	NodeLayout nodeLayout = createSolidNodeLayout (4,4,4) ;
+
+	auto modificationsRhoU = expand (ri->modifyNodeLayout (nodeLayout, 
+		"xs = IntBuffer.from_a([0, 1, 3]) ; ys = IntBuffer.new(3, 2) ; zs = IntBuffer.new(3) ; "
+		"ux = FloatBuffer.from_a([0.1, 0.2, 0.3]) ; "
+		"setNodesUPhysical(xs, ys, zs, ux, ux * 2, FloatBuffer.new(3)) ; ")) ;
+
+	ASSERT_EQ (modificationsRhoU.uPhysical.size(), 3u) ;
+	EXPECT_EQ (modificationsRhoU.uPhysical[2].coordinates, Coordinates(3,2,0) ) ;
+	EXPECT_EQ (modificationsRhoU.uPhysical[2].value[0], 0.3 ) ;
+	EXPECT_EQ (modificationsRhoU.uPhysical[2].value[1], 0.6 ) ;
+	EXPECT_EQ (modificationsRhoU.uPhysical[2].value[2], 0.0 ) ;
+
+	EXPECT_ANY_THROW (ri->modifyNodeLayout (nodeLayout, 
+		"setNodesRhoPhysical(IntBuffer.new(2), IntBuffer.new(2), IntBuffer.new(2), "
+		"FloatBuffer.new(3)) ; ")) ;
+}
+
+TEST (MRubyInterpreter, getMRubyVariable_containers)
+{
+	std::unique_ptr<MRubyInterpreter> ri = nullptr ;
+
+	EXPECT_NO_THROW( ri = MRubyInterpreter::getMRubyInterpreter() ; ) ;
+	EXPECT_NO_THROW( ri->runScript(
+		"$v = [1, 2, 3] ; "
+		"$table = [[0.0, 1.5], [1.0, 2]] ; "
+		"$h = { :inlet => 0.5, \"outlet\" => 1 } ; "
+		"$profiles = { \"u\" => [[1, 2, 3], [4, 5, 6]] } ") ; ) ;
+
+	std::vector<int> v = ri->getMRubyVariable<std::vector<int>>("$v") ;
+	ASSERT_EQ (v.size(), 3u) ;
+	EXPECT_EQ (v[2], 3) ;
+
+	std::array<unsigned,3> a = ri->getMRubyVariable<std::array<unsigned,3>>("$v") ;
+	EXPECT_EQ (a[0], 1u) ;
+	EXPECT_ANY_THROW ((ri->getMRubyVariable<std::array<unsigned,2>> ("$v"))) ;
+
+	auto table = ri->getMRubyVariable<std::vector<std::vector<double>>>("$table") ;
+	ASSERT_EQ (table.size(), 2u) ;
+	EXPECT_EQ (table[0][1], 1.5) ;
+	EXPECT_EQ (table[1][1], 2.0) ;
+
+	auto h = ri->getMRubyVariable<std::map<std::string,double>>("$h") ;
+	ASSERT_EQ (h.size(), 2u) ;
+	EXPECT_EQ (h["inlet"], 0.5) ;
+	EXPECT_EQ (h["outlet"], 1.0) ;
+
+	auto profiles = 
+		ri->getMRubyVariable<std::map<std::string, std::vector<std::array<double,3>>>>("$profiles") ;
+	ASSERT_EQ (profiles["u"].size(), 2u) ;
+	EXPECT_EQ (profiles["u"][1][2], 6.0) ;
+
+	EXPECT_ANY_THROW (ri->getMRubyVariable<std::vector<int>>("$h")) ;
+	EXPECT_ANY_THROW (ri->getMRubyVariable<std::vector<int>>("$undefined")) ;
+}
+
+TEST (MRubyInterpreter, prepareCallable)
+{
+	std::unique_ptr<MRubyInterpreter> ri = nullptr ;
+
+	EXPECT_NO_THROW( ri = MRubyInterpreter::getMRubyInterpreter() ; ) ;
+	EXPECT_NO_THROW( ri->runScript(
+		"U = 0.5 ; "
+		"def inletVelocity(t, y) U * t * y end ; "
+		"def failing(t) raise 'failed' end ; "
+		"$scale = lambda { |x| 2 * x } ") ; ) ;
+
+	std::unique_ptr<MRubyCallable> inletVelocity ;
+	EXPECT_NO_THROW (inletVelocity = ri->prepareCallable ("inletVelocity")) ;
+	EXPECT_EQ (inletVelocity->call<double> (2.0, 3), 3.0) ;
+	EXPECT_EQ (inletVelocity->call<double> (4.0, 1), 2.0) ;
+
+	std::unique_ptr<MRubyCallable> scale ;
+	EXPECT_NO_THROW (scale = ri->prepareCallable ("$scale")) ;
+	EXPECT_EQ (scale->call<int> (21), 42) ;
+
+	std::unique_ptr<MRubyCallable> failing = ri->prepareCallable ("failing") ;
+	EXPECT_ANY_THROW (failing->call<double> (1.0)) ;
+	// interpreter is still usable after exception
+	EXPECT_EQ (inletVelocity->call<double> (2.0, 3), 3.0) ;
+	EXPECT_NO_THROW( ri->runScript("$a = 1") ; ) ;
+
+	EXPECT_ANY_THROW (ri->prepareCallable ("undefinedMethod")) ;
+	EXPECT_ANY_THROW (ri->prepareCallable ("$undefinedProc")) ;
+}
+
+TEST (MRubyInterpreter, prepareCallable_result_types)
+{
+	std::unique_ptr<MRubyInterpreter> ri = MRubyInterpreter::getMRubyInterpreter() ;
+	EXPECT_NO_THROW( ri->runScript(
+		"$calls = 0 ; "
+		"def count() $calls += 1 ; 'counted' end ; "
+		"def failingInFiber() Fiber.new { raise 'failed' }.resume end ") ; ) ;
+
+	std::unique_ptr<MRubyCallable> count = ri->prepareCallable ("count") ;
+	EXPECT_NO_THROW (count->call<void> ()) ;
+	EXPECT_EQ (ri->getMRubyVariable<int> ("$calls"), 1) ;
+
+	mrb_value result = count->call<mrb_value> () ;
+	ASSERT_TRUE (mrb_string_p (result)) ;
+	EXPECT_EQ (convertTo<std::string> (result), "counted") ;
+
+	std::unique_ptr<MRubyCallable> failingInFiber = ri->prepareCallable ("failingInFiber") ;
+	for (int i = 0 ; i < 3 ; i++)
+	{
+		EXPECT_ANY_THROW (failingInFiber->call<void> ()) ;
+		EXPECT_NO_THROW (count->call<void> ()) ;
+	}
+	EXPECT_EQ (ri->getMRubyVariable<int> ("$calls"), 5) ;
+}
+
+TEST (MRubyInterpreter, modifyNodeLayoutBySlices)
+{
+	std::unique_ptr<MRubyInterpreter> ri = nullptr ;
+
+	EXPECT_NO_THROW( ri = MRubyInterpreter::getMRubyInterpreter() ; ) ;
+
+	NodeLayout nodeLayout = createSolidNodeLayout (4,4,4) ;
+
+	std::vector<unsigned> finishedSlices ;
+	std::vector<ModificationRhoU> sliceModifications ;
+
+	auto modificationsRhoU = expand (ri->modifyNodeLayoutBySlices (nodeLayout, 
+		"for z in 0..3 ; "
+		"  setNodeRhoPhysical(1,1,z, 2.0) ; "
+		"  setNodeRhoPhysical(2,2,z, 2.0) ; "
+		"  sliceDone(z) ; "
+		"end ; "
+		"setNodeRhoPhysical(3,3,3, 1.0) ; ",
+		[&] (unsigned z, RegionModificationRhoU && modifications)
+		{
+			finishedSlices.push_back (z) ;
+			sliceModifications.push_back (expand (modifications)) ;
+		})) ;
+
+	ASSERT_EQ (finishedSlices, std::vector<unsigned> ({0, 1, 2, 3})) ;
+	for (unsigned z = 0 ; z < 4 ; z++)
+	{
+		ASSERT_EQ (sliceModifications[z].rhoPhysical.size(), 2u) ;
+		EXPECT_EQ (sliceModifications[z].rhoPhysical[0].coordinates, Coordinates(1,1,z) ) ;
+		EXPECT_EQ (sliceModifications[z].rhoPhysical[1].coordinates, Coordinates(2,2,z) ) ;
+	}
+	ASSERT_EQ (modificationsRhoU.rhoPhysical.size(), 1u) ;
+	EXPECT_EQ (modificationsRhoU.rhoPhysical[0].coordinates, Coordinates(3,3,3) ) ;
+
+	// Without slice pipeline sliceDone does nothing.
+	modificationsRhoU = expand (ri->modifyNodeLayout (nodeLayout, 
+		"setNodeRhoPhysical(1,1,1, 2.0) ; sliceDone(1) ; setNodeRhoPhysical(2,2,2, 2.0) ; ")) ;
+	EXPECT_EQ (modificationsRhoU.rhoPhysical.size(), 2u) ;
+
+	EXPECT_ANY_THROW (ri->modifyNodeLayoutBySlices (nodeLayout, 
+		"sliceDone(0) ; raise 'error in modificator' ; ",
+		[] (unsigned, RegionModificationRhoU &&) {})) ;
+	EXPECT_NO_THROW( ri->runScript("$a = 1") ; ) ;
+}
+
+TEST (MRubyInterpreter, compile_runBytecode)
+{
+	std::unique_ptr<MRubyInterpreter> compiler = MRubyInterpreter::getMRubyInterpreter() ;
+	MRubyInterpreter::Bytecode bytecode ;
+
+	EXPECT_NO_THROW (bytecode = compiler->compile ("$a = 2 * A ; def twice(x) 2 * x end")) ;
+	EXPECT_ANY_THROW (compiler->compile ("def (")) ;
+
+	for (int i = 1 ; i <= 3 ; i++)
+	{
+		std::unique_ptr<MRubyInterpreter> ri = MRubyInterpreter::getMRubyInterpreter() ;
+		ri->runScript ("A = " + std::to_string (i)) ;
+		EXPECT_NO_THROW (ri->runBytecode (bytecode)) ;
+		EXPECT_EQ (ri->getMRubyVariable<int> ("$a"), 2 * i) ;
+		EXPECT_NO_THROW (ri->runScript ("$b = twice(5)")) ;
+		EXPECT_EQ (ri->getMRubyVariable<int> ("$b"), 10) ;
+	}
+
+	// bytecode kept alive by interpreter
+	std::unique_ptr<MRubyInterpreter> ri = MRubyInterpreter::getMRubyInterpreter() ;
+	ri->runScript ("A = 1") ;
+	ri->runBytecode (compiler->compile ("$c = :symbol_from_bytecode ; def three() 3 end")) ;
+	EXPECT_NO_THROW (ri->runScript ("$d = three() ; $e = $c.to_s")) ;
+	EXPECT_EQ (ri->getMRubyVariable<int> ("$d"), 3) ;
+	EXPECT_EQ (ri->getMRubyVariable<std::string> ("$e"), "symbol_from_bytecode") ;
+}
+
+TEST (MRubyInterpreter, runScript_cache_eviction)
+{
+	std::unique_ptr<MRubyInterpreter> ri = MRubyInterpreter::getMRubyInterpreter() ;
+
+	// Every 10th script is new - it is compiled and evicts an old one from 
+	// the cache. Evicted scripts must be freed by GC.
+	auto runScripts = [&] (unsigned first, unsigned count)
+	{
+		for (unsigned i = first ; i < first + count ; i++)
+		{
+			if (0 == i % 10)
+			{
+				ri->runScript ("$s = 'script " + std::to_string (i) + "' * 2") ;
+			}
+			else
+			{
+				ri->runScript ("$a = [1, 2.5, 'abc'].size") ;
+			}
+		}
+	} ;
+	auto countLiveProcs = [&] ()
+	{
+		ri->runScript ("GC.start ; $procs = ObjectSpace.count_objects[:T_PROC]") ;
+		return ri->getMRubyVariable<int> ("$procs") ;
+	} ;
+
+	// Fills the cache.
+	runScripts (0, 1000) ;
+	countLiveProcs () ;
+	const int procsBefore = countLiveProcs () ;
+	runScripts (1000, 4000) ;
+	const int procsAfter = countLiveProcs () ;
+
+	EXPECT_EQ (ri->getMRubyVariable<int> ("$a"), 3) ;
+	EXPECT_EQ (ri->getMRubyVariable<std::string> ("$s"), "script 4990script 4990") ;
+	EXPECT_EQ (procsAfter, procsBefore) ;
+
+	EXPECT_ANY_THROW (ri->runScript ("def (")) ;
+	EXPECT_NO_THROW (ri->runScript ("$a = 1")) ;
+}
+
+TEST (MRubyInterpreter, modifyNodeLayout_errors_are_ruby_exceptions)
+{
+	std::unique_ptr<MRubyInterpreter> ri = nullptr ;
+
+	EXPECT_NO_THROW( ri = MRubyInterpreter::getMRubyInterpreter() ; ) ;
+
+	NodeLayout nodeLayout = createSolidNodeLayout (4,4,4) ;
+
+	EXPECT_NO_THROW (ri->modifyNodeLayout (nodeLayout, 
+		"$e1 = begin ; setNodeRhoPhysical(1,2) ; rescue ArgumentError => e ; e.message ; end ; "
+		"$e2 = begin ; setNodeRhoPhysical(1,2,3,'x') ; rescue TypeError => e ; e.message ; end ; "
+		"$e3 = begin ; setRegionRhoPhysical(1,0,0, 0,1,1, 0.5) ; rescue => e ; e.message ; end ; "
+		"$e4 = begin ; setNodeUPhysical(1,1,1, [1,2]) ; rescue ArgumentError => e ; e.message ; end ; ")) ;
+
+	EXPECT_EQ (ri->getMRubyVariable<std::string> ("$e1"), "wrong number of arguments (2 for 4)") ;
+	EXPECT_EQ (ri->getMRubyVariable<std::string> ("$e2"), "expected Float") ;
+	EXPECT_EQ (ri->getMRubyVariable<std::string> ("$e3"), "Empty region") ;
+	EXPECT_EQ (ri->getMRubyVariable<std::string> ("$e4"), "expected Array of 3 elements") ;
+
+	EXPECT_ANY_THROW (ri->modifyNodeLayout (nodeLayout, "setNodeRhoPhysical(1,2) ; ")) ;
+
+	auto modificationsRhoU = expand (ri->modifyNodeLayout (nodeLayout, 
+		"a = [1,2,3, 2] ; setNodeRhoPhysical(*a) ; ")) ;
+	ASSERT_EQ (modificationsRhoU.rhoPhysical.size(), 1u) ;
+	EXPECT_EQ (modificationsRhoU.rhoPhysical[0].coordinates, Coordinates(1,2,3) ) ;
+	EXPECT_EQ (modificationsRhoU.rhoPhysical[0].value, 2.0 ) ;
+
+	// raised inside getNode, after its C++ temporaries are gone
+	EXPECT_NO_THROW (ri->modifyNodeLayout (nodeLayout, 
+		"Node = 1 ; "
+		"$e5 = begin ; getNode(1,1,1) ; rescue => e ; e.class.to_s ; end ; ")) ;
+	EXPECT_EQ (ri->getMRubyVariable<std::string> ("$e5"), "TypeError") ;
+
+	// out of range coordinates are not truncated
+	EXPECT_NO_THROW (ri->modifyNodeLayout (nodeLayout, 
+		"$e6 = begin ; setNodeRhoPhysical(1e300,1,1, 1.0) ; rescue RangeError => e ; e.message ; end ; "
+		"$e7 = begin ; setNodeRhoPhysical(0.0/0.0,1,1, 1.0) ; rescue RangeError => e ; e.message ; end ; "
+		"$e8 = begin ; setNodeRhoPhysical(-1.0/0.0,1,1, 1.0) ; rescue RangeError => e ; e.message ; end ; "
+		"$e9 = begin ; setNodeRhoPhysical(2**32 + 1,1,1, 1.0) ; rescue RangeError => e ; e.class.to_s ; end ; ")) ;
+	EXPECT_EQ (ri->getMRubyVariable<std::string> ("$e6"), "float too big for int") ;
+	EXPECT_EQ (ri->getMRubyVariable<std::string> ("$e7"), "float too big for int") ;
+	EXPECT_EQ (ri->getMRubyVariable<std::string> ("$e8"), "float too big for int") ;
+	EXPECT_EQ (ri->getMRubyVariable<std::string> ("$e9"), "RangeError") ;
+}
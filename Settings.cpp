@@ -12,6 +12,9 @@ Dec 2017
 #include <iomanip>
 #include <cmath>
 #include <memory>
+#include <atomic>
+#include <thread>
+#include <algorithm>
 
 #include "Settings.hpp"
 #include "RubyInterpreter.hpp"
@@ -32,12 +35,24 @@ namespace microflow
 			Embedding ruby interpreter - only once, have problems with second load.
 		*/
 		_rbi = MRubyInterpreter::getMRubyInterpreter () ;
+		configurationScript_ = read_config_rb ;
 		
 		// load below is needed only to read lattice type and set simulation directory
 		// Arbitrary Nx, Ny, will be overriden later
 		loadConfiguration(10000, 10000, 10000) ; 
 	}
 
+	Settings::
+	Settings(const std::string simulationDirectoryPath, 
+					 const std::string configurationScriptPath) :
+	simulationDirectoryPath_( simulationDirectoryPath )
+	{
+		_rbi = MRubyInterpreter::getMRubyInterpreter () ;
+		configurationScript_ = readFileContents (configurationScriptPath) ;
+
+		loadConfiguration(10000, 10000, 10000) ; 
+	}
+
 	Settings::
 	Settings()
 	{
@@ -72,6 +87,7 @@ namespace microflow
 		characteristicVelocityLB_ = NAN ;
 
 		_rbi = nullptr ;
+		configurationScript_ = read_config_rb ;
 	}
 
 	Settings::
@@ -121,10 +137,18 @@ namespace microflow
 		ss << "GeometryDirectory = \"" 
 			 << getGeometryDirectoryPath() << "\" ; \n" ;
 
-		_rbi->runScript (ss.str ()) ;
+		configurationPrologue_ = ss.str () ;
+
+		_rbi->runScript (configurationPrologue_) ;
 
-		_rbi->runScript (read_config_rb ) ;
-	
+		_rbi->runScript (configurationScript_) ;
+
+		readConfiguration () ;
+	}
+
+	void Settings::
+	readConfiguration()
+	{
 		// Belowe we do not cath exceptions because ruby script initialises all
 		// global variables.
 		latticeArrangementName_ = 
@@ -231,6 +255,78 @@ namespace microflow
 		recalculateCoefficients() ;
 	}
 
+	std::vector< std::unique_ptr<Settings> > Settings::
+	sweep( const Settings & baseSettings, 
+				 const std::vector<std::string> & overrides,
+				 unsigned numberOfThreads )
+	{
+		// Compiled once, loaded without copying by every interpreter.
+		auto prologue = baseSettings._rbi->compile (baseSettings.configurationPrologue_) ;
+		auto configuration = baseSettings._rbi->compile (baseSettings.configurationScript_) ;
+
+		std::vector< std::unique_ptr<Settings> > variants (overrides.size()) ;
+		std::vector< std::exception_ptr > errors (overrides.size()) ;
+		std::atomic<size_t> nextVariant (0) ;
+
+		auto worker = [&] ()
+		{
+			for (size_t i = nextVariant++ ; i < overrides.size() ; i = nextVariant++)
+			{
+				try
+				{
+					std::unique_ptr<Settings> settings (new Settings()) ;
+					settings->simulationDirectoryPath_ = baseSettings.simulationDirectoryPath_ ;
+					settings->configurationPrologue_ = baseSettings.configurationPrologue_ ;
+					settings->configurationScript_ = baseSettings.configurationScript_ ;
+					settings->_rbi = MRubyInterpreter::getMRubyInterpreter () ;
+
+					// Override is run also before the configuration script, so 
+					// values derived by the script follow it. Run after the script 
+					// it takes precedence over values the script sets itself. 
+					// Coefficients derived in C++ are recomputed by readConfiguration.
+					settings->_rbi->runBytecode (prologue) ;
+					settings->_rbi->runScript (overrides [i]) ;
+					settings->_rbi->runBytecode (configuration) ;
+					settings->_rbi->runScript (overrides [i]) ;
+					settings->readConfiguration () ;
+
+					variants [i] = std::move (settings) ;
+				}
+				catch (...)
+				{
+					errors [i] = std::current_exception () ;
+				}
+			}
+		} ;
+
+		if (0 == numberOfThreads)
+		{
+			numberOfThreads = std::max (1u, std::thread::hardware_concurrency()) ;
+		}
+		numberOfThreads = std::min<size_t> (numberOfThreads, overrides.size()) ;
+
+		std::vector< std::thread > threads ;
+		for (unsigned t = 1 ; t < numberOfThreads ; t++)
+		{
+			threads.emplace_back (worker) ;
+		}
+		worker () ;
+		for (auto & thread : threads)
+		{
+			thread.join () ;
+		}
+
+		for (auto & error : errors)
+		{
+			if (error)
+			{
+				std::rethrow_exception (error) ;
+			}
+		}
+
+		return variants ;
+	}
+
 	ostream & Settings::
 	write( ostream & ostr)
 	{
@@ -368,4 +464,102 @@ namespace microflow
 
 
 
+	std::future<RegionModificationRhoU> Settings::
+	finalModifyAsync (NodeLayout & nodeLayout) const
+	{
+		std::string modificatorScript = 
+			readFileContents (getFinalGeometryModificatorPath()) ;
+
+		std::string configurationScript = configurationPrologue_ + configurationScript_ ;
+
+		return MRubyInterpreter::modifyNodeLayoutAsync
+							(nodeLayout, modificatorScript, configurationScript) ;
+	}
+
+
+
+	void Settings::
+	finishModify (std::future<RegionModificationRhoU> & pendingModification)
+	{
+		modificationRhoU_ += pendingModification.get () ;
+	}
+
+
+
+	/*
+		Scalar conversion applied to each element, nothing is assumed about its
+		form. Scalar conversions are inline (Settings.hh), so the loop body is 
+		just the arithmetic of the conversion. source == destination is allowed.
+	*/
+	template <class T, class Function>
+	static void 
+	transformArray (Function transform, const T * source, T * destination, size_t size)
+	{
+		for (size_t i = 0 ; i < size ; i++)
+		{
+			destination [i] = static_cast<T> (transform (source [i])) ;
+		}
+	}
+
+
+
+#define DEFINE_ARRAY_TRANSFORM(name)                                          \
+	template <class T>                                                          \
+	void Settings::                                                             \
+	name( T * values, size_t size ) const                                       \
+	{                                                                           \
+		transformArray<T> ([this] (double v) { return name (v) ; },               \
+											 values, values, size) ;                                  \
+	}                                                                           \
+                                                                              \
+	template <class T>                                                          \
+	void Settings::                                                             \
+	name( const T * source, T * destination, size_t size ) const                \
+	{                                                                           \
+		transformArray<T> ([this] (double v) { return name (v) ; },               \
+											 source, destination, size) ;                             \
+	}                                                                           \
+                                                                              \
+	template void Settings::name<float>  (float  *, size_t) const ;            \
+	template void Settings::name<double> (double *, size_t) const ;            \
+	template void Settings::name<float>  (const float  *, float  *, size_t) const ; \
+	template void Settings::name<double> (const double *, double *, size_t) const ;
+
+	DEFINE_ARRAY_TRANSFORM (transformVelocityLBToPhysical)
+	DEFINE_ARRAY_TRANSFORM (transformVelocityPhysicalToLB)
+	DEFINE_ARRAY_TRANSFORM (transformVolumetricMassDensityLBToPressurePhysical)
+	DEFINE_ARRAY_TRANSFORM (transformPressurePhysicalToVolumetricMassDensityLB)
+
+#undef DEFINE_ARRAY_TRANSFORM
+
+
+
+	template <class T>
+	void Settings::
+	transformLBToPhysical( const T * __restrict__ velocityLB, 
+												 const T * __restrict__ volumetricMassDensityLB,
+												 T * __restrict__ velocityPhysical, 
+												 T * __restrict__ pressurePhysical,
+												 size_t numberOfNodes ) const
+	{
+		for (size_t i = 0 ; i < numberOfNodes ; i++)
+		{
+			velocityPhysical [3*i    ] = 
+				static_cast<T> (transformVelocityLBToPhysical (velocityLB [3*i    ])) ;
+			velocityPhysical [3*i + 1] = 
+				static_cast<T> (transformVelocityLBToPhysical (velocityLB [3*i + 1])) ;
+			velocityPhysical [3*i + 2] = 
+				static_cast<T> (transformVelocityLBToPhysical (velocityLB [3*i + 2])) ;
+			pressurePhysical [i] = static_cast<T> 
+				(transformVolumetricMassDensityLBToPressurePhysical (volumetricMassDensityLB [i])) ;
+		}
+	}
+
+	template void Settings::transformLBToPhysical<float> 
+		(const float *, const float *, float *, float *, size_t) const ;
+	template void Settings::transformLBToPhysical<double> 
+		(const double *, const double *, double *, double *, size_t) const ;
+
+
+
 }
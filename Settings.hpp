@@ -11,6 +11,9 @@ Dec 2017
 #include <string>
 #include <ostream>
 #include <cstddef>
+#include <future>
+#include <memory>
+#include <vector>
 
 #include "RubyInterpreter.hpp"
 #include "Axis.hpp"
@@ -41,6 +44,10 @@ class Settings
 														unsigned characteristicLengthInCells ) ;
 
 		Settings( const std::string simulationDirectoryPath ) ;
+		// Configuration is read by the script from configurationScriptPath 
+		// instead of the built-in one, e.g. for tests.
+		Settings( const std::string simulationDirectoryPath, 
+							const std::string configurationScriptPath ) ;
 		Settings() ;
 		~Settings() ;
 
@@ -79,6 +86,42 @@ class Settings
 		double transformPressurePhysicalToVolumetricMassDensityLB
 							(double pressurePhysical) const ;
 
+		// Versions of the above for whole arrays (float or double), e.g. fields
+		// written to vtk files. The scalar conversion is applied to each element.
+		// Out of place versions accept source == destination, other overlaps
+		// are not allowed.
+		template <class T>
+		void transformVelocityLBToPhysical( T * velocity, size_t size ) const ;
+		template <class T>
+		void transformVelocityLBToPhysical( const T * velocityLB, 
+																				T * velocityPhysical, size_t size ) const ;
+		template <class T>
+		void transformVelocityPhysicalToLB( T * velocity, size_t size ) const ;
+		template <class T>
+		void transformVelocityPhysicalToLB( const T * velocityPhysical, 
+																				T * velocityLB, size_t size ) const ;
+		template <class T>
+		void transformVolumetricMassDensityLBToPressurePhysical
+							( T * values, size_t size ) const ;
+		template <class T>
+		void transformVolumetricMassDensityLBToPressurePhysical
+							( const T * volumetricMassDensityLB, T * pressurePhysical, 
+								size_t size ) const ;
+		template <class T>
+		void transformPressurePhysicalToVolumetricMassDensityLB
+							( T * values, size_t size ) const ;
+		template <class T>
+		void transformPressurePhysicalToVolumetricMassDensityLB
+							( const T * pressurePhysical, T * volumetricMassDensityLB, 
+								size_t size ) const ;
+
+		// Single pass over both output fields. Velocities are stored as x,y,z
+		// triples, one triple per node.
+		template <class T>
+		void transformLBToPhysical( const T * velocityLB, const T * volumetricMassDensityLB,
+																T * velocityPhysical, T * pressurePhysical,
+																size_t numberOfNodes ) const ;
+
 		std::string getSimulationDirectoryPath       () const ;
 		std::string getSettingsDirectoryPath         () const ;
 		std::string getGeometryDirectoryPath         () const ;
@@ -145,6 +188,19 @@ class Settings
 														unsigned characteristicLengthInCells ) ;
 		
 		
+		// Parameter sweep: for each element of overrides one Settings object
+		// with the configuration of baseSettings modified by the Ruby code from
+		// this element, for example "$tau = 0.6". Overrides are run before and
+		// after the configuration script, thus values derived from overridden
+		// parameters are recomputed. 
+		// Variants are read concurrently, each one in its own interpreter, 
+		// configuration script is compiled only once. baseSettings must have
+		// configuration loaded. 0 threads means one per hardware thread.
+		static std::vector< std::unique_ptr<Settings> > 
+		sweep( const Settings & baseSettings, 
+					 const std::vector<std::string> & overrides,
+					 unsigned numberOfThreads = 0 ) ;
+
 		std::ostream & write( std::ostream & ostr) ;
 
 
@@ -154,11 +210,21 @@ class Settings
 		void initialModify (NodeLayout & nodeLayout) ;
 		void finalModify   (NodeLayout & nodeLayout) ;
 
+		// Runs final geometry modificator in background, in a separate interpreter 
+		// with the same configuration loaded. nodeLayout must not be used until
+		// the result is passed to finishModify().
+		std::future<RegionModificationRhoU> finalModifyAsync (NodeLayout & nodeLayout) const ;
+		// Waits for modificator started with finalModifyAsync() and adds its
+		// modifications to modificationRhoU.
+		void finishModify (std::future<RegionModificationRhoU> & pendingModification) ;
+
 		// WARNING: modificationRhoU is updated in initialModify() and 
 		//					finalModify() methods.
 		//          Calling getModificationRhoU() before the above methods
 		//					is useless - returns no modifications.
-		const ModificationRhoU & getModificationRhoU() const ;
+		// Modifications are kept as (box, value) regions, expand them with
+		// applyTo() only where they are applied to the lattice.
+		const RegionModificationRhoU & getModificationRhoU() const ;
 
 
 		enum class DefaultValue
@@ -219,6 +285,9 @@ class Settings
 
 		NodeType buildNodeType (const std::string name) const ;
 
+		// Reads global variables set by configuration script.
+		void readConfiguration() ;
+
 
 		double requiredVelocityRelativeError_ ;
 		double initialVolumetricMassDensityLB_ ;
@@ -243,7 +312,13 @@ class Settings
 
 		std::unique_ptr<MRubyInterpreter> _rbi = nullptr ; 
 
-		ModificationRhoU modificationRhoU_ ;
+		// Script defining geometry constants, run before configuration script.
+		// Needed to load the same configuration in background interpreters.
+		std::string configurationPrologue_ ;
+		// Script setting global variables read by readConfiguration().
+		std::string configurationScript_ ;
+
+		RegionModificationRhoU modificationRhoU_ ;
 
 		UniversalCoordinates<double> geometryOrigin_ ;
 } ;
@@ -0,0 +1,156 @@
+/*
+Modified by Szymon Bagiński
+baginski.szymon@gmail.com
+Wrocław University of Technology
+Dec 2017
+*/
+
+#include "gtest/gtest.h"
+#include "Settings.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace microflow ;
+
+static void setPhysicalParameters (Settings & settings)
+{
+	settings.setCharacteristicLengthLB (10.0) ;
+	settings.setCharacteristicLengthPhysical (0.01) ;
+	settings.setCharacteristicVelocityPhysical (0.1) ;
+	settings.setKinematicViscosityPhysical (1e-6) ;
+	settings.setInitialVolumetricMassDensityLB (1.0) ;
+	settings.setInitialVolumetricMassDensityPhysical (1000.0) ;
+	settings.setTau (0.8) ;
+	settings.recalculateCoefficients () ;
+}
+
+template <class T>
+static std::vector<T> createValues ()
+{
+	return std::vector<T> {T(-1.5), T(0), T(0.25), T(1), T(1.003), T(2), T(1e3)} ;
+}
+
+// Array versions must give exactly the scalar conversion of each element.
+#define EXPECT_ARRAY_TRANSFORM(T, name)                                      \
+	{                                                                          \
+		const std::vector<T> source = createValues<T> () ;                       \
+		std::vector<T> inPlace = source ;                                        \
+		std::vector<T> outOfPlace (source.size ()) ;                             \
+		settings.name (inPlace.data (), inPlace.size ()) ;                       \
+		settings.name (source.data (), outOfPlace.data (), source.size ()) ;     \
+		for (size_t i = 0 ; i < source.size () ; i++)                            \
+		{                                                                        \
+			const T expected = static_cast<T> (settings.name (double (source [i]))) ; \
+			EXPECT_EQ (inPlace [i], expected) << #name << " [" << i << "]" ;       \
+			EXPECT_EQ (outOfPlace [i], expected) << #name << " [" << i << "]" ;    \
+		}                                                                        \
+	}
+
+template <class T>
+static void testArrayTransforms (const Settings & settings)
+{
+	EXPECT_ARRAY_TRANSFORM (T, transformVelocityLBToPhysical) ;
+	EXPECT_ARRAY_TRANSFORM (T, transformVelocityPhysicalToLB) ;
+	EXPECT_ARRAY_TRANSFORM (T, transformVolumetricMassDensityLBToPressurePhysical) ;
+	EXPECT_ARRAY_TRANSFORM (T, transformPressurePhysicalToVolumetricMassDensityLB) ;
+}
+
+#undef EXPECT_ARRAY_TRANSFORM
+
+TEST (Settings, transformArrays_double)
+{
+	Settings settings ;
+	setPhysicalParameters (settings) ;
+	testArrayTransforms<double> (settings) ;
+}
+
+TEST (Settings, transformArrays_float)
+{
+	Settings settings ;
+	setPhysicalParameters (settings) ;
+	testArrayTransforms<float> (settings) ;
+}
+
+TEST (Settings, transformLBToPhysical)
+{
+	Settings settings ;
+	setPhysicalParameters (settings) ;
+
+	const std::vector<double> rhoLB = createValues<double> () ;
+	std::vector<double> uLB ;
+	for (double rho : rhoLB)
+	{
+		uLB.insert (uLB.end (), {rho, -rho, 0.5 * rho}) ;
+	}
+	std::vector<double> uPhysical (uLB.size ()) ;
+	std::vector<double> pPhysical (rhoLB.size ()) ;
+
+	settings.transformLBToPhysical (uLB.data (), rhoLB.data (),
+																	uPhysical.data (), pPhysical.data (), rhoLB.size ()) ;
+
+	for (size_t i = 0 ; i < uLB.size () ; i++)
+	{
+		EXPECT_EQ (uPhysical [i], settings.transformVelocityLBToPhysical (uLB [i])) ;
+	}
+	for (size_t i = 0 ; i < rhoLB.size () ; i++)
+	{
+		EXPECT_EQ (pPhysical [i],
+							 settings.transformVolumetricMassDensityLBToPressurePhysical (rhoLB [i])) ;
+	}
+}
+
+// Directory of this file, test data are kept next to the sources.
+static std::string getTestDirectoryPath ()
+{
+	const std::string sourcePath (__FILE__) ;
+	const size_t separatorPosition = sourcePath.find_last_of ('/') ;
+
+	if (std::string::npos == separatorPosition)
+	{
+		return "tests" ;
+	}
+	return sourcePath.substr (0, separatorPosition) + "/tests" ;
+}
+
+TEST (Settings, sweep_recomputes_derived_values)
+{
+	const std::string caseDirectory = getTestDirectoryPath () ;
+	const std::string configurationPath = 
+		caseDirectory + "/settingsSweepConfiguration.rb" ;
+
+	Settings base (caseDirectory, configurationPath) ;
+	ASSERT_EQ (base.getTau (), 0.8) ;
+
+	auto variants = Settings::sweep (base, 
+		{"$tau = 0.6", "$tau = 1.1", "$Re = 100.0", "$Re = 100.0 ; $tau = 0.6"}, 2) ;
+	ASSERT_EQ (variants.size (), 4u) ;
+
+	const double taus [] = {0.6, 1.1, 0.8, 0.6} ;
+	const double reynoldsNumbers [] = {1000.0, 1000.0, 100.0, 100.0} ;
+
+	for (size_t i = 0 ; i < variants.size () ; i++)
+	{
+		Settings expected (caseDirectory, configurationPath) ;
+		expected.setTau (taus [i]) ;
+		// $nu_phys is derived from $Re by the configuration script.
+		expected.setKinematicViscosityPhysical (0.1 * 0.01 / reynoldsNumbers [i]) ;
+		expected.recalculateCoefficients () ;
+
+		EXPECT_EQ (variants [i]->getTau (), taus [i]) << i ;
+		EXPECT_DOUBLE_EQ (variants [i]->getKinematicViscosityPhysical (), 
+											expected.getKinematicViscosityPhysical ()) << i ;
+		EXPECT_DOUBLE_EQ (variants [i]->getKinematicViscosityLB (), 
+											expected.getKinematicViscosityLB ()) << i ;
+		EXPECT_DOUBLE_EQ (variants [i]->getLatticeTimeStepPhysical (), 
+											expected.getLatticeTimeStepPhysical ()) << i ;
+	}
+	EXPECT_NE (variants [0]->getKinematicViscosityLB (), 
+						 variants [1]->getKinematicViscosityLB ()) ;
+	EXPECT_NE (variants [0]->getLatticeTimeStepPhysical (), 
+						 variants [3]->getLatticeTimeStepPhysical ()) ;
+
+	// Base configuration is not changed by the sweep.
+	EXPECT_EQ (base.getTau (), 0.8) ;
+	EXPECT_DOUBLE_EQ (base.getKinematicViscosityPhysical (), 0.1 * 0.01 / 1000.0) ;
+}
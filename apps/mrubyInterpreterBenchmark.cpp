@@ -0,0 +1,384 @@
+/*
+Created by Szymon Bagiński
+baginski.szymon@gmail.com
+Wrocław University of Technology
+Dec 2017
+*/
+
+/*
+	Microbenchmarks of MRubyInterpreter wrapper.
+
+	Usage: mrubyInterpreterBenchmark [simulation_directory] [--large]
+
+	Results are written to stdout as JSON. loadConfiguration is measured only 
+	when simulation_directory is given, 512^3 layout only with --large.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <malloc.h>
+
+#include "RubyInterpreter.hpp"
+#include "Settings.hpp"
+#include "NodeLayoutTest.hpp"
+
+using namespace microflow ;
+using namespace std ;
+
+
+
+/*
+	Allocation counting - all allocations (C++ and mruby) go through malloc
+	family, which is replaced below by thin wrappers over glibc functions.
+	Aligned variants are wrapped too, aligned operator new uses them. The 
+	counter is atomic, allocations from other threads (e.g. parallel sweeps) 
+	are counted as well.
+*/
+extern "C" 
+{
+	void * __libc_malloc   (size_t size) ;
+	void * __libc_calloc   (size_t n, size_t size) ;
+	void * __libc_realloc  (void * ptr, size_t size) ;
+	void * __libc_memalign (size_t alignment, size_t size) ;
+	void * __libc_valloc   (size_t size) ;
+	void * __libc_pvalloc  (size_t size) ;
+	void   __libc_free     (void * ptr) ;
+}
+
+static atomic<size_t> numberOfAllocations (0) ;
+
+static void countAllocation ()
+{
+	numberOfAllocations.fetch_add (1, memory_order_relaxed) ;
+}
+
+extern "C" void * malloc (size_t size)
+{
+	countAllocation () ;
+	return __libc_malloc (size) ;
+}
+
+extern "C" void * calloc (size_t n, size_t size)
+{
+	countAllocation () ;
+	return __libc_calloc (n, size) ;
+}
+
+extern "C" void * realloc (void * ptr, size_t size)
+{
+	countAllocation () ;
+	return __libc_realloc (ptr, size) ;
+}
+
+extern "C" void * memalign (size_t alignment, size_t size)
+{
+	countAllocation () ;
+	return __libc_memalign (alignment, size) ;
+}
+
+extern "C" void * aligned_alloc (size_t alignment, size_t size)
+{
+	countAllocation () ;
+	return __libc_memalign (alignment, size) ;
+}
+
+extern "C" int posix_memalign (void ** ptr, size_t alignment, size_t size)
+{
+	if (0 != alignment % sizeof (void *) || 0 != (alignment & (alignment - 1)))
+	{
+		return EINVAL ;
+	}
+
+	countAllocation () ;
+	void * result = __libc_memalign (alignment, size) ;
+	if (nullptr == result)
+	{
+		return ENOMEM ;
+	}
+	*ptr = result ;
+	return 0 ;
+}
+
+extern "C" void * valloc (size_t size)
+{
+	countAllocation () ;
+	return __libc_valloc (size) ;
+}
+
+extern "C" void * pvalloc (size_t size)
+{
+	countAllocation () ;
+	return __libc_pvalloc (size) ;
+}
+
+extern "C" void free (void * ptr)
+{
+	__libc_free (ptr) ;
+}
+
+
+
+// Returns value in kB of given field from /proc/self/status (VmRSS, VmHWM).
+static size_t readProcStatus (const string & fieldName)
+{
+	ifstream status ("/proc/self/status") ;
+	string line ;
+
+	while (getline (status, line))
+	{
+		if (0 == line.compare (0, fieldName.size(), fieldName))
+		{
+			return strtoul (line.c_str() + fieldName.size() + 1, nullptr, 10) ;
+		}
+	}
+	return 0 ;
+}
+
+
+
+class BenchmarkReport
+{
+	public:
+		void measure (const string & name, unsigned numberOfIterations,
+									function<void ()> benchmark) ;
+		void write (ostream & ostr) const ;
+
+	private:
+		struct Result
+		{
+			string name ;
+			unsigned numberOfIterations ;
+			double medianNs ;
+			double p99Ns ;
+			double allocationsPerIteration ;
+			size_t rssKb ;
+			size_t peakRssKb ;
+		} ;
+
+		vector<Result> results_ ;
+} ;
+
+
+
+void BenchmarkReport::
+measure (const string & name, unsigned numberOfIterations, 
+				 function<void ()> benchmark)
+{
+	benchmark () ; // warm up
+
+	vector<double> timesNs (numberOfIterations) ;
+	size_t allocationsBefore = numberOfAllocations.load () ;
+
+	for (unsigned i=0 ; i < numberOfIterations ; i++)
+	{
+		auto begin = chrono::steady_clock::now() ;
+		benchmark () ;
+		auto end   = chrono::steady_clock::now() ;
+
+		timesNs[i] = chrono::duration<double, nano> (end - begin).count() ;
+	}
+
+	size_t allocations = numberOfAllocations.load () - allocationsBefore ;
+
+	sort (timesNs.begin(), timesNs.end()) ;
+
+	Result result ;
+	result.name = name ;
+	result.numberOfIterations = numberOfIterations ;
+	result.medianNs = timesNs [numberOfIterations / 2] ;
+	result.p99Ns    = timesNs [min<size_t> (numberOfIterations - 1, 
+																					(numberOfIterations * 99) / 100)] ;
+	result.allocationsPerIteration = double (allocations) / numberOfIterations ;
+	result.rssKb     = readProcStatus ("VmRSS:") ;
+	result.peakRssKb = readProcStatus ("VmHWM:") ;
+
+	results_.push_back (result) ;
+
+	cerr << name << " done\n" ;
+}
+
+
+
+void BenchmarkReport::
+write (ostream & ostr) const
+{
+	ostr << "{\n  \"benchmarks\": [\n" ;
+
+	for (size_t i=0 ; i < results_.size() ; i++)
+	{
+		const Result & r = results_[i] ;
+
+		ostr << "    {"
+				 << "\"name\": \"" << r.name << "\", "
+				 << "\"iterations\": " << r.numberOfIterations << ", "
+				 << "\"median_ns\": " << r.medianNs << ", "
+				 << "\"p99_ns\": " << r.p99Ns << ", "
+				 << "\"allocations_per_iteration\": " << r.allocationsPerIteration << ", "
+				 << "\"rss_kb\": " << r.rssKb << ", "
+				 << "\"peak_rss_kb\": " << r.peakRssKb 
+				 << "}" << (i+1 < results_.size() ? ",\n" : "\n") ;
+	}
+
+	ostr << "  ]\n}\n" ;
+}
+
+
+
+// Config-like script with many global assignments and some computations.
+static string buildLargeScript (unsigned numberOfLines)
+{
+	stringstream ss ;
+
+	for (unsigned i=0 ; i < numberOfLines ; i++)
+	{
+		ss << "$variable_" << i << " = " << i << " * 0.5 + Math.sqrt(" << i << ")\n" ;
+	}
+
+	return ss.str() ;
+}
+
+
+
+// Typical modificator: velocity inlet and pressure outlet on opposite walls,
+// node by node, plus a fluid box set with region API.
+static string buildModificatorScript (unsigned size)
+{
+	stringstream ss ;
+
+	ss << "n = " << size - 1 << "\n"
+		 << "for z in 1...n ; for y in 1...n\n"
+		 << "  setNodeUPhysical(0, y, z, [0.01, 0.0, 0.0])\n"
+		 << "  setNodeRhoPhysical(n, y, z, 1000.0)\n"
+		 << "end ; end\n"
+		 << "setRegionRhoBoundaryPhysical(1,1,1, n-1,n-1,n-1, 1000.0)\n" ;
+
+	return ss.str() ;
+}
+
+
+
+static void benchmarkModifyNodeLayout (BenchmarkReport & report, unsigned size,
+																			 unsigned numberOfIterations)
+{
+	NodeLayout nodeLayout = createSolidNodeLayout (size, size, size) ;
+	auto interpreter = MRubyInterpreter::getMRubyInterpreter() ;
+	string script = buildModificatorScript (size) ;
+
+	stringstream name ;
+	name << "modifyNodeLayout_" << size << "^3" ;
+
+	report.measure (name.str(), numberOfIterations, [&] ()
+	{
+		interpreter->modifyNodeLayout (nodeLayout, script) ;
+	}) ;
+}
+
+
+
+int main (int argc, char ** argv)
+{
+	string simulationDirectoryPath ;
+	bool runLarge = false ;
+
+	for (int i=1 ; i < argc ; i++)
+	{
+		if (0 == strcmp ("--large", argv[i])) 
+		{
+			runLarge = true ;
+		}
+		else
+		{
+			simulationDirectoryPath = argv[i] ;
+		}
+	}
+
+	BenchmarkReport report ;
+
+	{
+		auto interpreter = MRubyInterpreter::getMRubyInterpreter() ;
+		report.measure ("runScript_small", 10000, [&] ()
+		{
+			interpreter->runScript ("$a = 59") ;
+		}) ;
+	}
+	{
+		// Soak test of the compiled script cache: 1000 iterations of 1000 runs,
+		// every 100th script is new and evicts an old one. rss_kb should stay 
+		// close to the one of runScript_small.
+		auto interpreter = MRubyInterpreter::getMRubyInterpreter() ;
+		unsigned scriptIndex = 0 ;
+		report.measure ("runScript_soak_1000", 1000, [&] ()
+		{
+			for (unsigned i=0 ; i < 1000 ; i++, scriptIndex++)
+			{
+				if (0 == scriptIndex % 100)
+				{
+					interpreter->runScript ("$s = 'script " + to_string (scriptIndex) + "' * 2") ;
+				}
+				else
+				{
+					interpreter->runScript ("$a = [1, 2.5, 'abc'].size") ;
+				}
+			}
+		}) ;
+	}
+	{
+		auto interpreter = MRubyInterpreter::getMRubyInterpreter() ;
+		string script = buildLargeScript (10000) ;
+		report.measure ("runScript_large", 20, [&] ()
+		{
+			interpreter->runScript (script) ;
+		}) ;
+	}
+	{
+		auto interpreter = MRubyInterpreter::getMRubyInterpreter() ;
+		interpreter->runScript ("$d = 0.25 ; $i = 59 ; $b = true ; $s = \"D3Q19\"") ;
+
+		report.measure ("getMRubyVariable_double", 100000, [&] ()
+		{
+			interpreter->getMRubyVariable<double> ("$d") ;
+		}) ;
+		report.measure ("getMRubyVariable_unsigned", 100000, [&] ()
+		{
+			interpreter->getMRubyVariable<unsigned> ("$i") ;
+		}) ;
+		report.measure ("getMRubyVariable_bool", 100000, [&] ()
+		{
+			interpreter->getMRubyVariable<bool> ("$b") ;
+		}) ;
+		report.measure ("getMRubyVariable_string", 100000, [&] ()
+		{
+			interpreter->getMRubyVariable<string> ("$s") ;
+		}) ;
+	}
+
+	if (!simulationDirectoryPath.empty())
+	{
+		Settings settings (simulationDirectoryPath) ;
+		report.measure ("loadConfiguration", 100, [&] ()
+		{
+			settings.loadConfiguration (128, 128, 128) ;
+		}) ;
+	}
+
+	benchmarkModifyNodeLayout (report, 128, 10) ;
+	if (runLarge)
+	{
+		benchmarkModifyNodeLayout (report, 512, 3) ;
+	}
+
+	report.write (cout) ;
+
+	return 0 ;
+}
@@ -0,0 +1,15 @@
+a = (0...1000).to_a
+h = {}
+a.each {|i| h[i] = i * 2 }
+
+s = 0
+300.times do
+  a.each {|x| s += x }
+  a.each_index {|i| s += i }
+  h.each {|k, v| s += v }
+  h.each_key {|k| s += k }
+  s += h.select {|k, v| v > 1000 }.size
+  a.collect! {|x| x }
+end
+
+puts s
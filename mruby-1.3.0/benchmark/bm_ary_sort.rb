@@ -0,0 +1,15 @@
+seed = 1
+f = Array.new(20000) { seed = (seed * 1103515245 + 12345) % 2147483648; seed / 65536.0 }
+i = f.map {|x| x.to_i }
+w = i.map {|x| "w#{x}" }
+
+s = 0
+5.times do
+  s += f.sort[100].to_i
+  s += i.sort[100]
+  s += i.sort {|a, b| b <=> a }[100]
+  s += w.sort[100].size
+  s += i.sort_by {|x| -x }[100]
+end
+
+puts s
@@ -0,0 +1,31 @@
+# point in sphere / box tests over a lattice, like geometry modificators
+def inside_sphere(x, y, z, c, r)
+  dx = x - c[0]
+  dy = y - c[1]
+  dz = z - c[2]
+  dx * dx + dy * dy + dz * dz <= r * r
+end
+
+def inside_box(x, y, z, lo, hi)
+  x >= lo[0] && x <= hi[0] && y >= lo[1] && y <= hi[1] && z >= lo[2] && z <= hi[2]
+end
+
+c = [40.5, 40.5, 20.25]
+lo = [10.0, 5.0, 2.5]
+hi = [60.0, 70.0, 30.0]
+n = 0
+z = 0
+while z < 120
+  y = 0
+  while y < 80
+    x = 0
+    while x < 80
+      fx = x * 0.5 + 0.25
+      n += 1 if inside_sphere(fx, y, z, c, 17.5) || inside_box(fx, y * 1.0, z - 0.5, lo, hi)
+      x += 1
+    end
+    y += 1
+  end
+  z += 1
+end
+puts n
@@ -0,0 +1,11 @@
+sum = 0
+1000.times do |i|
+  1.upto(1000) do |j|
+    sum += i ^ j
+  end
+  (0...1000).each do |k|
+    sum -= k
+  end
+end
+
+puts sum
@@ -58,6 +58,12 @@
 /* initial size for IV khash; ignored when MRB_USE_IV_SEGLIST is set */
 //#define MRB_IVHASH_INIT_SIZE 8
 
+/* objects with more instance variables keep them in IV table, not in shape slots */
+//#define MRB_SHAPE_MAX_IVS 64
+
+/* maximum number of object shapes; later objects keep variables in IV table */
+//#define MRB_SHAPE_MAX 8192
+
 /* if _etext and _edata available, mruby can reduce memory used by symbols */
 //#define MRB_USE_ETEXT_EDATA
 
@@ -92,6 +98,16 @@
 /* fixed size state atexit stack */
 //#define MRB_FIXED_STATE_ATEXIT_STACK
 
+/* turn off global method cache */
+//#define MRB_NO_METHOD_CACHE
+
+/* number of global method cache entries; must be a power of 2 */
+//#define MRB_METHOD_CACHE_SIZE (1<<8)
+
+/* turn off rewriting of instructions specialized to operand types;
+   implied by MRB_NO_METHOD_CACHE and MRB_BYTECODE_DECODE_OPTION */
+//#define MRB_NO_QUICKENING
+
 /* -DMRB_DISABLE_XXXX to drop following features */
 //#define MRB_DISABLE_STDIO	/* use of stdio */
 
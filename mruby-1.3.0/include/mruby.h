@@ -157,6 +157,43 @@ typedef void (*mrb_atexit_func)(struct mrb_state*);
 #define MRB_STATE_NO_REGEXP 1
 #define MRB_STATE_REGEXP    2
 
+#ifndef MRB_NO_METHOD_CACHE
+#ifndef MRB_METHOD_CACHE_SIZE
+# define MRB_METHOD_CACHE_SIZE (1<<8)
+#endif
+#if (MRB_METHOD_CACHE_SIZE & (MRB_METHOD_CACHE_SIZE - 1)) != 0
+# error MRB_METHOD_CACHE_SIZE must be a power of 2
+#endif
+
+/* result of method lookup, valid while serial equals mrb->method_serial */
+struct mrb_cache_entry {
+  struct RClass *c;             /* receiver class */
+  struct RClass *c0;            /* class defining the method */
+  mrb_sym mid;
+  struct RProc *m;              /* NULL if not found */
+  uint64_t serial;
+};
+
+/* classes remembered by a call site before it turns megamorphic */
+#define MRB_CALL_CACHE_WAYS 4
+
+/* inline caches of send instructions, see mruby/irep.h */
+struct mrb_call_cache_stats {
+  size_t hit;                   /* sends that skipped method lookup */
+  size_t miss;                  /* sends that searched the method */
+  size_t megamorphic;           /* sends of megamorphic sites */
+  /* number of sites by state: sites[n] remember n classes,
+     sites[MRB_CALL_CACHE_WAYS+1] are megamorphic */
+  size_t sites[MRB_CALL_CACHE_WAYS+2];
+};
+#endif
+
+/* quickening keeps its state in the call caches and rewrites
+   undecoded instructions */
+#if (defined(MRB_NO_METHOD_CACHE) || defined(MRB_BYTECODE_DECODE_OPTION)) && !defined(MRB_NO_QUICKENING)
+# define MRB_NO_QUICKENING
+#endif
+
 typedef struct mrb_state {
   struct mrb_jmpbuf *jmp;
 
@@ -166,7 +203,10 @@ typedef struct mrb_state {
 
   struct mrb_context *c;
   struct mrb_context *root_c;
-  struct iv_tbl *globals;                 /* global variable table */
+  struct gv_tbl *globals;                 /* global variables by slot */
+  struct mrb_shape *root_shape;           /* parent of one variable shapes */
+  size_t shape_count;
+  uint64_t const_serial;                  /* bumped on any change of constants or ancestors */
 
   struct RObject *exc;                    /* exception */
 
@@ -220,6 +260,12 @@ typedef struct mrb_state {
   mrb_atexit_func *atexit_stack;
 #endif
   mrb_int atexit_stack_len;
+
+#ifndef MRB_NO_METHOD_CACHE
+  struct mrb_cache_entry cache[MRB_METHOD_CACHE_SIZE];
+  uint64_t method_serial;       /* bumped on any change of method tables or ancestors */
+  struct mrb_call_cache_stats call_cache_stats;
+#endif
 } mrb_state;
 
 
@@ -311,6 +357,15 @@ MRB_API void mrb_prepend_module(mrb_state*, struct RClass*, struct RClass*);
  */
 MRB_API void mrb_define_method(mrb_state *mrb, struct RClass *cla, const char *name, mrb_func_t func, mrb_aspec aspec);
 
+/**
+ * Defines a method like mrb_define_method() for a function which calls
+ * its block only before it returns and never stores it nor passes it
+ * to other methods (e.g. Integer#times).  Variables captured by a block
+ * literal given to such a method are not copied to the heap when the
+ * caller returns.
+ */
+MRB_API void mrb_define_iterator(mrb_state *mrb, struct RClass *cla, const char *name, mrb_func_t func, mrb_aspec aspec);
+
 /**
  * Defines a class method.
  *
@@ -1107,6 +1162,23 @@ MRB_API mrb_value mrb_yield(mrb_state *mrb, mrb_value b, mrb_value arg);
 MRB_API mrb_value mrb_yield_argv(mrb_state *mrb, mrb_value b, mrb_int argc, const mrb_value *argv);
 MRB_API mrb_value mrb_yield_with_class(mrb_state *mrb, mrb_value b, mrb_int argc, const mrb_value *argv, mrb_value self, struct RClass *c);
 
+/* repeated yield of the same block, e.g. by C iterators */
+/* the block frame is set up once by mrb_yield_prepare(); each */
+/* mrb_yield_fast() only stores the arguments and runs the block */
+/* e.g. mrb_yield_prepare(mrb, &y, blk, 1); */
+/*      for (...) mrb_yield_fast(mrb, &y, &v); */
+typedef struct mrb_yieldinfo {
+  struct RProc *proc;
+  mrb_value self;
+  struct RClass *target_class;
+  mrb_sym mid;
+  mrb_int argc;
+  int nregs;
+} mrb_yieldinfo;
+
+MRB_API void mrb_yield_prepare(mrb_state *mrb, mrb_yieldinfo *y, mrb_value b, mrb_int argc);
+MRB_API mrb_value mrb_yield_fast(mrb_state *mrb, mrb_yieldinfo *y, const mrb_value *argv);
+
 /* continue execution to the proc */
 /* this function should always be called as the last function of a method */
 /* e.g. return mrb_yield_cont(mrb, proc, self, argc, argv); */
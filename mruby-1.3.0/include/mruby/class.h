@@ -52,6 +52,9 @@ mrb_class(mrb_state *mrb, mrb_value v)
 }
 
 /* TODO: figure out where to put user flags */
+#define MRB_FLAG_IN_CONST_CACHE (1 << 15)
+#define MRB_FLAG_IN_METHOD_CACHE (1 << 16)
+#define MRB_FLAG_IN_CALL_CACHE (1 << 17)
 #define MRB_FLAG_IS_FROZEN (1 << 18)
 #define MRB_FLAG_IS_PREPENDED (1 << 19)
 #define MRB_FLAG_IS_ORIGIN (1 << 20)
@@ -84,6 +87,8 @@ MRB_API struct RClass* mrb_class_real(struct RClass* cl);
 void mrb_gc_mark_mt(mrb_state*, struct RClass*);
 size_t mrb_gc_mark_mt_size(mrb_state*, struct RClass*);
 void mrb_gc_free_mt(mrb_state*, struct RClass*);
+void mrb_method_cache_clear(mrb_state*);
+void mrb_method_cache_forget(mrb_state*, struct RClass*);
 
 MRB_END_DECL
 
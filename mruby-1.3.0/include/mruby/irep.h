@@ -26,6 +26,42 @@ struct mrb_locals {
   uint16_t r;
 };
 
+#ifndef MRB_NO_METHOD_CACHE
+struct mrb_call_target {
+  struct RClass *c;             /* receiver class */
+  struct RClass *c0;            /* class defining the method */
+  struct RProc *m;
+};
+
+/* polymorphic inline cache of a send instruction */
+struct mrb_call_cache {
+  struct mrb_call_target e[MRB_CALL_CACHE_WAYS];
+  uint64_t serial;              /* mrb->method_serial when filled */
+  uint8_t n;                    /* number of filled entries */
+  mrb_bool megamorphic;         /* too many classes, uses global method cache */
+  uint8_t deopt;                /* times the quickened instruction was reverted */
+};
+
+#endif
+
+/* inline cache of OP_GETIV and OP_SETIV for objects with shapes */
+struct mrb_iv_cache {
+  struct mrb_shape *shape;      /* shape of self; NULL if empty */
+  struct mrb_shape *from;       /* OP_SETIV: shape before adding the variable */
+  uint16_t idx;                 /* slot of the variable */
+};
+
+/* inline cache of OP_GETCONST and OP_GETMCNST */
+struct mrb_const_cache {
+  struct RClass *c;             /* lexical class or receiver module */
+  mrb_value v;
+  uint64_t serial;              /* mrb->const_serial when filled */
+};
+
+/* instructions over this number of each kind share an entry that is
+   never filled */
+#define MRB_INLINE_CACHE_MAX (UINT16_MAX-1)
+
 /* Program data array struct */
 typedef struct mrb_irep {
   uint16_t nlocals;        /* Number of local variables */
@@ -45,6 +81,16 @@ typedef struct mrb_irep {
   struct mrb_irep_debug_info* debug_info;
 
   size_t ilen, plen, slen, rlen, refcnt;
+
+  /* inline caches, allocated on first run; cidx maps instruction to its
+     entry in the cache array of the instruction kind */
+  uint16_t *cidx;
+#ifndef MRB_NO_METHOD_CACHE
+  struct mrb_call_cache *ccache;
+  uint16_t cclen;
+#endif
+  struct mrb_iv_cache *ivcache;
+  struct mrb_const_cache *kcache;
 } mrb_irep;
 
 #define MRB_ISEQ_NO_FREE 1
@@ -55,6 +101,8 @@ MRB_API mrb_value mrb_load_irep_cxt(mrb_state*, const uint8_t*, mrbc_context*);
 void mrb_irep_free(mrb_state*, struct mrb_irep*);
 void mrb_irep_incref(mrb_state*, struct mrb_irep*);
 void mrb_irep_decref(mrb_state*, struct mrb_irep*);
+/* instruction with a quickened opcode replaced by the generic one */
+mrb_code mrb_insn_generic(mrb_code i);
 
 MRB_END_DECL
 
@@ -26,9 +26,29 @@ struct RBasic {
 #define MRB_SET_FROZEN_FLAG(o) ((o)->flags |= MRB_FLAG_IS_FROZEN)
 #define MRB_UNSET_FROZEN_FLAG(o) ((o)->flags &= ~MRB_FLAG_IS_FROZEN)
 
+/*
+ * Instance variable layout shared by objects that got the same variables
+ * in the same order (hidden class). Shapes form a tree: a child adds one
+ * variable to its parent. They live until mrb_close().
+ */
+struct mrb_shape {
+  struct mrb_shape *parent;
+  struct mrb_shape *child;      /* first child */
+  struct mrb_shape *sibling;    /* next child of parent */
+  mrb_sym name;                 /* variable added by this shape */
+  uint16_t n;                   /* number of variables; slot of name is n-1 */
+};
+
 struct RObject {
   MRB_OBJECT_HEADER;
   struct iv_tbl *iv;
+  /* MRB_TT_OBJECT without iv table: ivs[i] is the i-th variable of shape */
+  struct mrb_shape *shape;
+#ifdef MRB_WORD_BOXING
+  union mrb_value *ivs;         /* mrb_value is not defined yet */
+#else
+  struct mrb_value *ivs;
+#endif
 };
 #define mrb_obj_ptr(v)   ((struct RObject*)(mrb_ptr(v)))
 
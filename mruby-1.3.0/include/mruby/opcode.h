@@ -141,6 +141,48 @@ enum {
   OP_STOP,/*              stop VM                                         */
   OP_ERR,/*       Bx      raise RuntimeError with message Lit(Bx)         */
 
+  /* superinstructions: fused by the peephole optimizer from sequences
+     frequent in the benchmarks */
+  OP_MOVE2,/*     A B C   R(A) := R(B); R(A+1) := R(C)                    */
+  OP_EQI,/*       A B C   R(A) := R(A)==C (Syms[B]=:==)                   */
+  OP_LTI,/*       A B C   R(A) := R(A)<C  (Syms[B]=:<)                    */
+  OP_LEI,/*       A B C   R(A) := R(A)<=C (Syms[B]=:<=)                   */
+  OP_GTI,/*       A B C   R(A) := R(A)>C  (Syms[B]=:>)                    */
+  OP_GEI,/*       A B C   R(A) := R(A)>=C (Syms[B]=:>=)                   */
+  OP_EQJ,/*       A B C   OP_EQ, then the OP_JMPIF/OP_JMPNOT R(A) at pc+1 */
+  OP_LTJ,/*       A B C   OP_LT, then the OP_JMPIF/OP_JMPNOT R(A) at pc+1 */
+  OP_LEJ,/*       A B C   OP_LE, then the OP_JMPIF/OP_JMPNOT R(A) at pc+1 */
+  OP_GTJ,/*       A B C   OP_GT, then the OP_JMPIF/OP_JMPNOT R(A) at pc+1 */
+  OP_GEJ,/*       A B C   OP_GE, then the OP_JMPIF/OP_JMPNOT R(A) at pc+1 */
+
+  /* quickened instructions: the VM rewrites a generic instruction into
+     one of these after seeing the operand types, and back when they
+     change; never produced by the compiler nor dumped.
+     I: Fixnum, F: Float (or a Float and a Fixnum) */
+  OP_ADD_II,/*    A B C   OP_ADD                                          */
+  OP_ADD_FF,/*    A B C   OP_ADD                                          */
+  OP_ADDI_I,/*    A B C   OP_ADDI                                         */
+  OP_ADDI_F,/*    A B C   OP_ADDI                                         */
+  OP_SUB_II,/*    A B C   OP_SUB                                          */
+  OP_SUB_FF,/*    A B C   OP_SUB                                          */
+  OP_SUBI_I,/*    A B C   OP_SUBI                                         */
+  OP_SUBI_F,/*    A B C   OP_SUBI                                         */
+  OP_MUL_II,/*    A B C   OP_MUL                                          */
+  OP_MUL_FF,/*    A B C   OP_MUL                                          */
+  OP_DIV_FF,/*    A B C   OP_DIV (any two numbers)                        */
+  OP_EQ_II,/*     A B C   OP_EQ                                           */
+  OP_EQ_FF,/*     A B C   OP_EQ                                           */
+  OP_LT_II,/*     A B C   OP_LT                                           */
+  OP_LT_FF,/*     A B C   OP_LT                                           */
+  OP_LE_II,/*     A B C   OP_LE                                           */
+  OP_LE_FF,/*     A B C   OP_LE                                           */
+  OP_GT_II,/*     A B C   OP_GT                                           */
+  OP_GT_FF,/*     A B C   OP_GT                                           */
+  OP_GE_II,/*     A B C   OP_GE                                           */
+  OP_GE_FF,/*     A B C   OP_GE                                           */
+  OP_AREF_ARY_I,/*A B C   OP_SEND of Array#[] with a Fixnum (C=1)         */
+  OP_ASET_ARY_I,/*A B C   OP_SEND of Array#[]= with a Fixnum (C=2)        */
+
   OP_RSVD1,/*             reserved instruction #1                         */
   OP_RSVD2,/*             reserved instruction #2                         */
   OP_RSVD3,/*             reserved instruction #3                         */
@@ -25,12 +25,19 @@ struct REnv {
   } cxt;
 };
 
+/* flags hold the stack length and MRB_ENV_NOESCAPE */
+#define MRB_ENV_NOESCAPE (1 << 20)
 #define MRB_SET_ENV_STACK_LEN(e,len) (e)->flags = (unsigned int)(len)
-#define MRB_ENV_STACK_LEN(e) ((mrb_int)(e)->flags)
+#define MRB_ENV_STACK_LEN(e) ((mrb_int)((e)->flags & (MRB_ENV_NOESCAPE - 1)))
 #define MRB_ENV_UNSHARE_STACK(e) ((e)->cioff = -1)
 #define MRB_ENV_STACK_SHARED_P(e) ((e)->cioff >= 0)
+/* only blocks passed to iterators (MRB_PROC_ITERATOR) refer to the env;
+   it is not copied to the heap when its frame returns */
+#define MRB_ENV_NOESCAPE_P(e) (((e)->flags & MRB_ENV_NOESCAPE) != 0)
 
 MRB_API void mrb_env_unshare(mrb_state*, struct REnv*);
+/* clears MRB_ENV_NOESCAPE of the env and the envs it refers to */
+void mrb_env_escape(mrb_state*, struct REnv*);
 
 struct RProc {
   MRB_OBJECT_HEADER;
@@ -57,11 +64,16 @@ struct RProc {
 #define MRB_PROC_STRICT_P(p) (((p)->flags & MRB_PROC_STRICT) != 0)
 #define MRB_PROC_ORPHAN 512
 #define MRB_PROC_ORPHAN_P(p) (((p)->flags & MRB_PROC_ORPHAN) != 0)
+/* C method calling its block only during the call, see mrb_define_iterator() */
+#define MRB_PROC_ITERATOR 1024
+#define MRB_PROC_ITERATOR_P(p) (((p)->flags & MRB_PROC_ITERATOR) != 0)
 
 #define mrb_proc_ptr(v)    ((struct RProc*)(mrb_ptr(v)))
 
 struct RProc *mrb_proc_new(mrb_state*, mrb_irep*);
 struct RProc *mrb_closure_new(mrb_state*, mrb_irep*);
+struct RProc *mrb_closure_new_noescape(mrb_state*, mrb_irep*);
+mrb_bool mrb_proc_spread_p(struct RProc*);
 MRB_API struct RProc *mrb_proc_new_cfunc(mrb_state*, mrb_func_t);
 MRB_API struct RProc *mrb_closure_new_cfunc(mrb_state *mrb, mrb_func_t func, int nlocals);
 void mrb_proc_copy(struct RProc *a, struct RProc *b);
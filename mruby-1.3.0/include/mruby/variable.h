@@ -36,6 +36,8 @@ void mrb_vm_iv_set(mrb_state*, mrb_sym, mrb_value);
 mrb_value mrb_vm_cv_get(mrb_state*, mrb_sym);
 void mrb_vm_cv_set(mrb_state*, mrb_sym, mrb_value);
 mrb_value mrb_vm_const_get(mrb_state*, mrb_sym);
+mrb_bool mrb_vm_const_find(mrb_state*, struct RClass*, mrb_sym, mrb_value*);
+mrb_bool mrb_const_find(mrb_state*, struct RClass*, mrb_sym, mrb_value*);
 void mrb_vm_const_set(mrb_state*, mrb_sym, mrb_value);
 MRB_API mrb_value mrb_const_get(mrb_state*, mrb_value, mrb_sym);
 MRB_API void mrb_const_set(mrb_state*, mrb_value, mrb_sym, mrb_value);
@@ -128,9 +130,13 @@ mrb_value mrb_mod_cv_get(mrb_state *mrb, struct RClass * c, mrb_sym sym);
 mrb_bool mrb_mod_cv_defined(mrb_state *mrb, struct RClass * c, mrb_sym sym);
 mrb_sym mrb_class_sym(mrb_state *mrb, struct RClass *c, struct RClass *outer);
 
+int mrb_obj_iv_slot(mrb_state *mrb, struct RObject *obj, mrb_sym sym);
+void mrb_obj_shape_set(mrb_state *mrb, struct RObject *obj, struct mrb_shape *shape);
+
 /* GC functions */
 void mrb_gc_mark_gv(mrb_state*);
 void mrb_gc_free_gv(mrb_state*);
+void mrb_gc_free_shapes(mrb_state*);
 void mrb_gc_mark_iv(mrb_state*, struct RObject*);
 size_t mrb_gc_mark_iv_size(mrb_state*, struct RObject*);
 void mrb_gc_free_iv(mrb_state*, struct RObject*);
@@ -18,6 +18,7 @@ struct mrbc_args {
   const char *initname;
   mrb_bool check_syntax : 1;
   mrb_bool verbose      : 1;
+  mrb_bool optimize     : 1;
   unsigned int flags    : 4;
 };
 
@@ -30,6 +31,7 @@ usage(const char *name)
   "-o<outfile>  place the output into <outfile>",
   "-v           print version number, then turn on verbose mode",
   "-g           produce debugging information",
+  "-O           optimize the generated bytecode",
   "-B<symbol>   binary <symbol> output in C language format",
   "-e           generate little endian iseq data",
   "-E           generate big endian iseq data",
@@ -118,6 +120,9 @@ parse_args(mrb_state *mrb, int argc, char **argv, struct mrbc_args *args)
       case 'g':
         args->flags |= DUMP_DEBUG_INFO;
         break;
+      case 'O':
+        args->optimize = TRUE;
+        break;
       case 'E':
         args->flags = DUMP_ENDIAN_BIG | (args->flags & ~DUMP_ENDIAN_MASK);
         break;
@@ -200,6 +205,8 @@ load_file(mrb_state *mrb, struct mrbc_args *args)
   if (args->verbose)
     c->dump_result = TRUE;
   c->no_exec = TRUE;
+  if (args->optimize)
+    c->optimize = TRUE;
   if (input[0] == '-' && input[1] == '\0') {
     infile = stdin;
   }
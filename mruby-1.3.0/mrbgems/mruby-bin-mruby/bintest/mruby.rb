@@ -15,6 +15,20 @@ assert('regression for #1572') do
   assert_equal o, '"ok"'
 end
 
+assert('binary format version') do
+  script, bin = Tempfile.new('test.rb'), Tempfile.new('test.mrb')
+  File.write script.path, 'p "ok"'
+  system "#{cmd('mrbc')} -o #{bin.path} #{script.path}"
+  mrb = File.binread(bin.path)
+  assert_equal "0005", mrb[4, 4]
+  mrb[4, 4] = "0004"
+  File.binwrite bin.path, mrb
+  assert_equal '"ok"', `#{cmd('mruby')} -b #{bin.path}`.strip
+  mrb[4, 4] = "0006"
+  File.binwrite bin.path, mrb
+  assert_not_equal '"ok"', `#{cmd('mruby')} -b #{bin.path} 2>&1`.strip
+end
+
 assert '$0 value' do
   script, bin = Tempfile.new('test.rb'), Tempfile.new('test.mrb')
 
@@ -58,3 +72,32 @@ RUBY
   assert_equal "NilClass", `#{cmd('mruby')} #{script.path}`
   assert_equal 0, $?.exitstatus
 end
+
+assert('quickened instructions with changing operand types') do
+  script = Tempfile.new('test.rb')
+
+  script.write <<RUBY
+def add(a, b); a + b; end
+def lt(a, b); a < b; end
+def inc(a); a + 1; end
+def get(a, i); a[i]; end
+def set(a, i, v); a[i] = v; end
+r = []
+[1, 2.5, 4611686018427387903, "s"].each do |x|
+  2.times { r << add(x, x) << lt(x, x) << (inc(x) rescue :err) }
+end
+a = [1, 2]
+2.times { r << get(a, 1) << set(a, 3, 4) }
+r << get({1 => :h}, 1) << get(a, -1)
+class Array; alias aref_ []; def [](i); :redefined; end; end
+r << get(a, 0)
+class Array; alias [] aref_; end
+p r
+RUBY
+  script.flush
+  assert_equal "[2, false, 2, 2, false, 2, 5, false, 3.5, 5, false, 3.5, " \
+               "9.2233720368548e+18, false, 4.6116860184274e+18, " \
+               "9.2233720368548e+18, false, 4.6116860184274e+18, " \
+               "\"ss\", false, :err, \"ss\", false, :err, " \
+               "2, 4, 2, 4, :h, 4, :redefined]\n", `#{cmd('mruby')} #{script.path}`
+end
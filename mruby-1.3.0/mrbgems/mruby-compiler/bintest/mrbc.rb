@@ -28,3 +28,36 @@ assert('embedded document with invalid terminator') do
   assert_equal "#{a.path}:3:0: embedded document meets end of file", result.chomp
   assert_equal 1, $?.exitstatus
 end
+
+assert('optimized bytecode (-O) behaves like the unoptimized one') do
+  a, out, opt = Tempfile.new('a.rb'), Tempfile.new('out.mrb'), Tempfile.new('opt.mrb')
+  a.write(<<'SCRIPT')
+def f(c, a, b = 2)
+  x = 1 + 2 * 3
+  y = c ? a : b
+  z = if a then :s else 1.5 + 2 end
+  return [x, y] if c == 1
+  w = 60 * 60 * 24
+  while a
+    a = nil
+  end
+  [x, y, z, w, 2**62 * 4]
+end
+p f(true, 5), f(1, nil), f(false, nil, 3)
+SCRIPT
+  a.flush
+  `#{cmd('mrbc')} -o #{out.path} #{a.path}`
+  `#{cmd('mrbc')} -O -o #{opt.path} #{a.path}`
+  assert_equal 0, $?.exitstatus
+  assert_equal `#{cmd('mruby')} -b #{out.path}`, `#{cmd('mruby')} -b #{opt.path}`
+  assert_true File.size(opt.path) < File.size(out.path)
+end
+
+assert('optimized bytecode (-O) keeps negative zero') do
+  a, opt = Tempfile.new('a.rb'), Tempfile.new('opt.mrb')
+  a.write("x = 0.0\np 0.0 * -1, 1 / (0.0 * -1), -0.0, x\n")
+  a.flush
+  `#{cmd('mrbc')} -O -o #{opt.path} #{a.path}`
+  assert_equal 0, $?.exitstatus
+  assert_equal "-0\n-inf\n-0\n0\n", `#{cmd('mruby')} -b #{opt.path}`
+end
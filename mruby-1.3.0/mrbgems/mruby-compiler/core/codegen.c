@@ -6,6 +6,7 @@
 
 #include <ctype.h>
 #include <limits.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <mruby.h>
@@ -208,6 +209,11 @@ genop_peep(codegen_scope *s, mrb_code i, int val)
           s->pc--;
           return genop_peep(s, MKOP_AB(OP_MOVE, GETARG_A(i), GETARG_B(i0)), val);
         }
+        if (GETARG_A(i) == GETARG_A(i0)+1 && GETARG_B(i) <= 0x7f) {
+          /* argument setup: two moves into consecutive registers */
+          s->iseq[s->pc-1] = MKOP_ABC(OP_MOVE2, GETARG_A(i0), GETARG_B(i0), GETARG_B(i));
+          return 0;
+        }
         break;
       case OP_LOADI:
         if (GETARG_B(i) == GETARG_A(i0) && GETARG_A(i0) >= s->nlocals) {
@@ -353,12 +359,41 @@ genop_peep(codegen_scope *s, mrb_code i, int val)
         }
       }
       break;
+    case OP_EQ:
+    case OP_LT:
+    case OP_LE:
+    case OP_GT:
+    case OP_GE:
+      if (c0 == OP_LOADI && GETARG_A(i0) == GETARG_A(i)+1) {
+        int c = GETARG_sBx(i0);
+
+        if (c < 0 || c > 127) break;
+        s->iseq[s->pc-1] = MKOP_ABC(c1 - OP_EQ + OP_EQI, GETARG_A(i), GETARG_B(i), c);
+        return 0;
+      }
+      break;
     case OP_JMPIF:
     case OP_JMPNOT:
-      if (c0 == OP_MOVE && GETARG_A(i) == GETARG_A(i0)) {
+      /* val: R(A) is read after the jump, or the jump offset is relative
+         to s->pc, so the jump may not move */
+      if (!val && c0 == OP_MOVE && GETARG_A(i) == GETARG_A(i0)) {
         s->iseq[s->pc-1] = MKOP_AsBx(c1, GETARG_B(i0), GETARG_sBx(i));
         return s->pc-1;
       }
+      switch (c0) {
+      case OP_EQ:
+      case OP_LT:
+      case OP_LE:
+      case OP_GT:
+      case OP_GE:
+        if (GETARG_A(i) == GETARG_A(i0)) {
+          /* compare and branch; the jump stays in place as the operand */
+          s->iseq[s->pc-1] = MKOP_ABC(c0 - OP_EQ + OP_EQJ, GETARG_A(i0), GETARG_B(i0), GETARG_C(i0));
+        }
+        break;
+      default:
+        break;
+      }
       break;
     default:
       break;
@@ -466,7 +501,9 @@ new_lit(codegen_scope *s, mrb_value val)
     for (i=0; i<s->irep->plen; i++) {
       pv = &s->irep->pool[i];
       if (mrb_type(*pv) != MRB_TT_FLOAT) continue;
-      if (mrb_float(*pv) == mrb_float(val)) return i;
+      /* 0.0 == -0.0, but the literals differ */
+      if (mrb_float(*pv) == mrb_float(val) &&
+          !signbit(mrb_float(*pv)) == !signbit(mrb_float(val))) return i;
     }
     break;
   case MRB_TT_FIXNUM:
@@ -923,19 +960,19 @@ gen_call(codegen_scope *s, node *tree, mrb_sym name, int sp, int val, int safe)
       genop(s, MKOP_ABC(OP_DIV, cursp(), idx, n));
     }
     else if (!noop && symlen == 1 && symname[0] == '<' && n == 1)  {
-      genop(s, MKOP_ABC(OP_LT, cursp(), idx, n));
+      genop_peep(s, MKOP_ABC(OP_LT, cursp(), idx, n), val);
     }
     else if (!noop && symlen == 2 && symname[0] == '<' && symname[1] == '=' && n == 1)  {
-      genop(s, MKOP_ABC(OP_LE, cursp(), idx, n));
+      genop_peep(s, MKOP_ABC(OP_LE, cursp(), idx, n), val);
     }
     else if (!noop && symlen == 1 && symname[0] == '>' && n == 1)  {
-      genop(s, MKOP_ABC(OP_GT, cursp(), idx, n));
+      genop_peep(s, MKOP_ABC(OP_GT, cursp(), idx, n), val);
     }
     else if (!noop && symlen == 2 && symname[0] == '>' && symname[1] == '=' && n == 1)  {
-      genop(s, MKOP_ABC(OP_GE, cursp(), idx, n));
+      genop_peep(s, MKOP_ABC(OP_GE, cursp(), idx, n), val);
     }
     else if (!noop && symlen == 2 && symname[0] == '=' && symname[1] == '=' && n == 1)  {
-      genop(s, MKOP_ABC(OP_EQ, cursp(), idx, n));
+      genop_peep(s, MKOP_ABC(OP_EQ, cursp(), idx, n), val);
     }
     else {
       if (sendv) n = CALL_MAXARGS;
@@ -1467,7 +1504,7 @@ codegen(codegen_scope *s, node *tree, int val)
 
       codegen(s, tree->car, VAL);
       pop();
-      pos = genop(s, MKOP_AsBx(OP_JMPNOT, cursp(), 0));
+      pos = genop_peep(s, MKOP_AsBx(OP_JMPNOT, cursp(), 0), VAL);
       codegen(s, tree->cdr, val);
       dispatch(s, pos);
     }
@@ -1479,7 +1516,7 @@ codegen(codegen_scope *s, node *tree, int val)
 
       codegen(s, tree->car, VAL);
       pop();
-      pos = genop(s, MKOP_AsBx(OP_JMPIF, cursp(), 0));
+      pos = genop_peep(s, MKOP_AsBx(OP_JMPIF, cursp(), 0), VAL);
       codegen(s, tree->cdr, val);
       dispatch(s, pos);
     }
@@ -1495,7 +1532,7 @@ codegen(codegen_scope *s, node *tree, int val)
       dispatch(s, lp->pc1);
       codegen(s, tree->car, VAL);
       pop();
-      genop(s, MKOP_AsBx(OP_JMPIF, cursp(), lp->pc2 - s->pc));
+      genop_peep(s, MKOP_AsBx(OP_JMPIF, cursp(), lp->pc2 - s->pc), VAL);
 
       loop_pop(s, val);
     }
@@ -1511,7 +1548,7 @@ codegen(codegen_scope *s, node *tree, int val)
       dispatch(s, lp->pc1);
       codegen(s, tree->car, VAL);
       pop();
-      genop(s, MKOP_AsBx(OP_JMPNOT, cursp(), lp->pc2 - s->pc));
+      genop_peep(s, MKOP_AsBx(OP_JMPNOT, cursp(), lp->pc2 - s->pc), VAL);
 
       loop_pop(s, val);
     }
@@ -2873,6 +2910,521 @@ scope_new(mrb_state *mrb, codegen_scope *prev, node *lv)
   return p;
 }
 
+/* optimizer over the finished iseq of a scope (mrbc_context#optimize,
+   mrbc -O): folds arithmetic on numeric literals, threads jumps to
+   jumps, drops unreachable code and jumps to the next instruction, and
+   coalesces the temporaries of conditional expressions assigned to a
+   local.  genop_peep only sees one instruction back, so this catches
+   what it misses across labels. */
+
+#define OPT_LABEL 1             /* jump target or entry of OP_ENTER */
+#define OPT_PIN   2             /* OP_ENTER table; position is fixed */
+#define OPT_LIVE  4             /* reachable */
+#define OPT_DEAD  8             /* to be removed */
+
+static mrb_bool
+opt_jump_p(int op)
+{
+  return op == OP_JMP || op == OP_JMPIF || op == OP_JMPNOT || op == OP_ONERR;
+}
+
+static int
+opt_prev(uint8_t *flags, int pc)
+{
+  for (pc--; pc >= 0; pc--) {
+    if (!(flags[pc] & OPT_DEAD)) return pc;
+  }
+  return -1;
+}
+
+static int
+opt_next(uint8_t *flags, int pc, int n)
+{
+  for (pc++; pc < n; pc++) {
+    if (!(flags[pc] & OPT_DEAD)) return pc;
+  }
+  return n;
+}
+
+static mrb_bool
+opt_number(codegen_scope *s, mrb_code i, mrb_value *v)
+{
+  switch (GET_OPCODE(i)) {
+  case OP_LOADI:
+    *v = mrb_fixnum_value(GETARG_sBx(i));
+    return TRUE;
+  case OP_LOADL:
+    *v = s->irep->pool[GETARG_Bx(i)];
+    return mrb_fixnum_p(*v) || mrb_float_p(*v);
+  default:
+    return FALSE;
+  }
+}
+
+/* same result as OP_ADD, OP_SUB or OP_MUL on the numbers; fixnum
+   overflow and NaN are left to run time */
+static mrb_bool
+opt_fold(codegen_scope *s, int op, mrb_value x, mrb_value y, mrb_code *i)
+{
+  int a = GETARG_A(*i);
+
+  if (mrb_fixnum_p(x) && mrb_fixnum_p(y)) {
+    mrb_int z;
+    mrb_bool overflow;
+
+    switch (op) {
+    case OP_ADD: overflow = mrb_int_add_overflow(mrb_fixnum(x), mrb_fixnum(y), &z); break;
+    case OP_SUB: overflow = mrb_int_sub_overflow(mrb_fixnum(x), mrb_fixnum(y), &z); break;
+    default:     overflow = mrb_int_mul_overflow(mrb_fixnum(x), mrb_fixnum(y), &z); break;
+    }
+    if (overflow) return FALSE;
+    if (z < MAXARG_sBx && z > -MAXARG_sBx) {
+      *i = MKOP_AsBx(OP_LOADI, a, z);
+    }
+    else {
+      *i = MKOP_ABx(OP_LOADL, a, new_lit(s, mrb_fixnum_value(z)));
+    }
+  }
+  else {
+    mrb_float f = mrb_fixnum_p(x) ? (mrb_float)mrb_fixnum(x) : mrb_float(x);
+    mrb_float g = mrb_fixnum_p(y) ? (mrb_float)mrb_fixnum(y) : mrb_float(y);
+
+    switch (op) {
+    case OP_ADD: f += g; break;
+    case OP_SUB: f -= g; break;
+    default:     f *= g; break;
+    }
+    if (f != f) return FALSE;
+    *i = MKOP_ABx(OP_LOADL, a, new_lit(s, mrb_float_value(s->mrb, f)));
+  }
+  return TRUE;
+}
+
+static void
+opt_fold_constants(codegen_scope *s, uint8_t *flags)
+{
+  mrb_code *iseq = s->iseq;
+  int pc, p1, p2;
+  mrb_value x, y;
+
+  for (pc = 0; pc < s->pc; pc++) {
+    mrb_code i = iseq[pc];
+    int op = GET_OPCODE(i);
+
+    if (flags[pc] & OPT_LABEL) continue;
+    switch (op) {
+    case OP_ADDI:
+    case OP_SUBI:
+      p1 = opt_prev(flags, pc);
+      if (p1 < 0 || GETARG_A(iseq[p1]) != GETARG_A(i) || !opt_number(s, iseq[p1], &x)) break;
+      y = mrb_fixnum_value(GETARG_C(i));
+      if (opt_fold(s, op == OP_ADDI ? OP_ADD : OP_SUB, x, y, &iseq[p1])) {
+        flags[pc] |= OPT_DEAD;
+      }
+      break;
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+      p1 = opt_prev(flags, pc);
+      if (p1 < 0 || (flags[p1] & OPT_LABEL)) break;
+      p2 = opt_prev(flags, p1);
+      if (p2 < 0) break;
+      if (GETARG_A(iseq[p2]) != GETARG_A(i) || GETARG_A(iseq[p1]) != GETARG_A(i)+1) break;
+      if (!opt_number(s, iseq[p2], &x) || !opt_number(s, iseq[p1], &y)) break;
+      if (opt_fold(s, op, x, y, &iseq[p2])) {
+        flags[p1] |= OPT_DEAD;
+        flags[pc] |= OPT_DEAD;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+static void
+opt_thread_jumps(codegen_scope *s, uint8_t *flags)
+{
+  mrb_code *iseq = s->iseq;
+  int pc, n;
+
+  for (pc = 0; pc < s->pc; pc++) {
+    mrb_code i = iseq[pc];
+    int op = GET_OPCODE(i);
+    int target;
+
+    if (op != OP_JMP && op != OP_JMPIF && op != OP_JMPNOT) continue;
+    target = pc + GETARG_sBx(i);
+    for (n = 0; n < s->pc && GET_OPCODE(iseq[target]) == OP_JMP; n++) {
+      target += GETARG_sBx(iseq[target]);
+    }
+    if (op == OP_JMP && !(flags[pc] & OPT_PIN) && GET_OPCODE(iseq[target]) == OP_RETURN) {
+      /* the return would run next anyway */
+      iseq[pc] = iseq[target];
+    }
+    else {
+      iseq[pc] = MKOP_AsBx(op, GETARG_A(i), target - pc);
+    }
+  }
+}
+
+static void
+opt_mark_live(codegen_scope *s, uint8_t *flags)
+{
+  mrb_code *iseq = s->iseq;
+  int *stack = (int*)codegen_palloc(s, sizeof(int)*s->pc);
+  int sp = 0, pc;
+
+  for (pc = 0; pc < s->pc; pc++) {
+    if (pc == 0 || (flags[pc] & OPT_PIN)) {
+      flags[pc] |= OPT_LIVE;
+      stack[sp++] = pc;
+    }
+  }
+  while (sp > 0) {
+    mrb_code i;
+    int succ[2], n = 0, k;
+
+    pc = stack[--sp];
+    i = iseq[pc];
+    switch (GET_OPCODE(i)) {
+    case OP_JMP:
+      succ[n++] = pc + GETARG_sBx(i);
+      break;
+    case OP_JMPIF:
+    case OP_JMPNOT:
+    case OP_ONERR:
+      succ[n++] = pc + GETARG_sBx(i);
+      succ[n++] = pc + 1;
+      break;
+    case OP_RETURN:
+    case OP_TAILCALL:
+    case OP_RAISE:
+    case OP_STOP:
+    case OP_ERR:
+      break;
+    default:
+      succ[n++] = pc + 1;
+      break;
+    }
+    for (k = 0; k < n; k++) {
+      if (succ[k] < s->pc && !(flags[succ[k]] & OPT_LIVE)) {
+        flags[succ[k]] |= OPT_LIVE;
+        stack[sp++] = succ[k];
+      }
+    }
+  }
+  for (pc = 0; pc < s->pc; pc++) {
+    if (!(flags[pc] & (OPT_LIVE|OPT_PIN))) flags[pc] |= OPT_DEAD;
+  }
+}
+
+/* how an instruction uses register r */
+#define OPT_USE_NONE 0
+#define OPT_USE_READ 1          /* read, or not known */
+#define OPT_USE_KILL 2          /* overwritten without being read */
+
+static int
+opt_use(mrb_code i, int r)
+{
+  int a = GETARG_A(i), b = GETARG_B(i), c = GETARG_C(i);
+
+  switch (GET_OPCODE(i)) {
+  case OP_NOP: case OP_JMP: case OP_ONERR: case OP_POPERR: case OP_EPOP:
+  case OP_STOP: case OP_ERR:
+    return OPT_USE_NONE;
+  case OP_LOADL: case OP_LOADI: case OP_LOADSYM: case OP_LOADNIL:
+  case OP_LOADSELF: case OP_LOADT: case OP_LOADF: case OP_STRING:
+  case OP_GETGLOBAL: case OP_GETSPECIAL: case OP_GETIV: case OP_GETCV:
+  case OP_GETCONST: case OP_GETUPVAR: case OP_OCLASS: case OP_TCLASS:
+  case OP_LAMBDA:
+    return r == a ? OPT_USE_KILL : OPT_USE_NONE;
+  case OP_MOVE: case OP_AREF: case OP_SCLASS:
+    if (r == b) return OPT_USE_READ;
+    return r == a ? OPT_USE_KILL : OPT_USE_NONE;
+  case OP_MOVE2:
+    if (r == b || r == c) return OPT_USE_READ;
+    return (r == a || r == a+1) ? OPT_USE_KILL : OPT_USE_NONE;
+  case OP_RANGE:
+    if (r == b || r == b+1) return OPT_USE_READ;
+    return r == a ? OPT_USE_KILL : OPT_USE_NONE;
+  case OP_ARRAY:
+    if (r >= b && r < b+c) return OPT_USE_READ;
+    return r == a ? OPT_USE_KILL : OPT_USE_NONE;
+  case OP_HASH:
+    if (r >= b && r < b+c*2) return OPT_USE_READ;
+    return r == a ? OPT_USE_KILL : OPT_USE_NONE;
+  case OP_SETGLOBAL: case OP_SETSPECIAL: case OP_SETIV: case OP_SETCV:
+  case OP_SETCONST: case OP_SETUPVAR: case OP_GETMCNST:
+  case OP_JMPIF: case OP_JMPNOT: case OP_RETURN: case OP_MODULE: case OP_EXEC:
+  case OP_ADDI: case OP_SUBI:
+  case OP_EQI: case OP_LTI: case OP_LEI: case OP_GTI: case OP_GEI:
+    return r == a ? OPT_USE_READ : OPT_USE_NONE;
+  case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
+  case OP_EQ: case OP_LT: case OP_LE: case OP_GT: case OP_GE:
+  case OP_EQJ: case OP_LTJ: case OP_LEJ: case OP_GTJ: case OP_GEJ:
+  case OP_SETMCNST: case OP_CLASS: case OP_METHOD:
+    return (r == a || r == a+1) ? OPT_USE_READ : OPT_USE_NONE;
+  case OP_ARYCAT: case OP_ARYPUSH: case OP_ASET: case OP_STRCAT:
+    return (r == a || r == b) ? OPT_USE_READ : OPT_USE_NONE;
+  case OP_SEND: case OP_SENDB: case OP_FSEND:
+    /* receiver, arguments and block; the callee's frame starts at R(A) */
+    if (r < a) return OPT_USE_NONE;
+    return r <= a + (c == CALL_MAXARGS ? 1 : c) + 1 ? OPT_USE_READ : OPT_USE_KILL;
+  default:
+    return OPT_USE_READ;
+  }
+}
+
+typedef struct opt_state {
+  codegen_scope *s;
+  uint8_t *flags;
+  int *jsrc, *jnext;            /* jumps to each instruction, linked */
+  int *defs;
+  int *work;                    /* walk stack, 2*pc+2 entries */
+  int *seen;
+  int stamp;
+} opt_state;
+
+#define OPT_WALK_MAX 64
+
+/* no path from pc reads R(r) before overwriting it; gives up after a
+   few instructions */
+static mrb_bool
+opt_dead_p(opt_state *o, int pc, int r)
+{
+  codegen_scope *s = o->s;
+  int sp = 0, steps = 0;
+
+  o->stamp++;
+  o->work[sp++] = pc;
+  while (sp > 0) {
+    mrb_code i;
+    int use;
+
+    pc = o->work[--sp];
+    if (pc >= s->pc) return FALSE;
+    if (o->seen[pc] == o->stamp) continue;
+    o->seen[pc] = o->stamp;
+    if (++steps > OPT_WALK_MAX) return FALSE;
+    if (o->flags[pc] & OPT_DEAD) {
+      o->work[sp++] = pc + 1;
+      continue;
+    }
+    i = s->iseq[pc];
+    use = opt_use(i, r);
+    if (use == OPT_USE_READ) return FALSE;
+    if (use == OPT_USE_KILL) continue;
+    switch (GET_OPCODE(i)) {
+    case OP_JMP:
+      o->work[sp++] = pc + GETARG_sBx(i);
+      break;
+    case OP_JMPIF:
+    case OP_JMPNOT:
+    case OP_ONERR:
+      o->work[sp++] = pc + GETARG_sBx(i);
+      o->work[sp++] = pc + 1;
+      break;
+    case OP_RETURN:
+    case OP_TAILCALL:
+    case OP_RAISE:
+    case OP_STOP:
+    case OP_ERR:
+      break;
+    default:
+      o->work[sp++] = pc + 1;
+      break;
+    }
+  }
+  return TRUE;
+}
+
+/* MOVE l t whose every path in is a definition of the temporary t right
+   before it, or right before a JMP to it: define l there instead */
+static void
+opt_coalesce_move(opt_state *o, int pc)
+{
+  codegen_scope *s = o->s;
+  mrb_code *iseq = s->iseq;
+  int l = GETARG_A(iseq[pc]), t = GETARG_B(iseq[pc]);
+  int *defs = o->defs;
+  int q, p, n = 0;
+
+  if (l >= s->nlocals || t < s->nlocals) return;
+  p = opt_prev(o->flags, pc);
+  if (p >= 0) {
+    int op = GET_OPCODE(iseq[p]);
+
+    if (opt_use(iseq[p], t) == OPT_USE_KILL && opt_use(iseq[p], l) == OPT_USE_NONE &&
+        GETARG_A(iseq[p]) == t && op != OP_MOVE2) {
+      defs[n++] = p;
+    }
+    else if (op != OP_JMP && op != OP_RETURN && op != OP_RAISE && op != OP_STOP) {
+      return;
+    }
+  }
+  for (q = o->jsrc[pc]; q >= 0; q = o->jnext[q]) {
+    int d;
+
+    if (GET_OPCODE(iseq[q]) != OP_JMP || o->jsrc[q] >= 0 || (o->flags[q] & OPT_PIN)) return;
+    d = opt_prev(o->flags, q);
+    if (d < 0 || GETARG_A(iseq[d]) != t || GET_OPCODE(iseq[d]) == OP_MOVE2 ||
+        opt_use(iseq[d], t) != OPT_USE_KILL || opt_use(iseq[d], l) != OPT_USE_NONE) return;
+    defs[n++] = d;
+  }
+  if (n == 0 || !opt_dead_p(o, pc + 1, t)) return;
+  while (n--) {
+    iseq[defs[n]] = (iseq[defs[n]] & ~MKARG_A(0x1ff)) | MKARG_A(l);
+  }
+  o->flags[pc] |= OPT_DEAD;
+}
+
+/* MOVE t x; JMPIF t (or JMPNOT) with t dead after the jump: test x */
+static void
+opt_move_branch(opt_state *o, int pc)
+{
+  codegen_scope *s = o->s;
+  mrb_code *iseq = s->iseq;
+  mrb_code i = iseq[pc];
+  int t = GETARG_A(i), j, op;
+
+  if (t < s->nlocals) return;
+  j = opt_next(o->flags, pc, s->pc);
+  if (j >= s->pc || o->jsrc[j] >= 0) return;
+  op = GET_OPCODE(iseq[j]);
+  if ((op != OP_JMPIF && op != OP_JMPNOT) || GETARG_A(iseq[j]) != t) return;
+  if (!opt_dead_p(o, j + GETARG_sBx(iseq[j]), t) || !opt_dead_p(o, j + 1, t)) return;
+  iseq[j] = MKOP_AsBx(op, GETARG_B(i), GETARG_sBx(iseq[j]));
+  o->flags[pc] |= OPT_DEAD;
+}
+
+static void
+optimize_iseq(codegen_scope *s)
+{
+  mrb_code *iseq = s->iseq;
+  uint8_t *flags = (uint8_t*)codegen_palloc(s, s->pc);
+  opt_state o;
+  int *map;
+  int pc, n, op;
+
+  memset(flags, 0, s->pc);
+  for (pc = 0; pc < s->pc; pc++) {
+    mrb_code i = iseq[pc];
+
+    op = GET_OPCODE(i);
+    if (opt_jump_p(op)) {
+      flags[pc + GETARG_sBx(i)] |= OPT_LABEL;
+    }
+    else if (op == OP_ENTER && MRB_ASPEC_OPT(GETARG_Ax(i)) > 0) {
+      /* OP_ENTER jumps into the table of OP_JMP after it */
+      int k, oa = MRB_ASPEC_OPT(GETARG_Ax(i));
+
+      for (k = 1; k <= oa + 1 && pc + k < s->pc; k++) {
+        flags[pc + k] |= OPT_LABEL|OPT_PIN;
+      }
+    }
+  }
+
+  opt_fold_constants(s, flags);
+  opt_thread_jumps(s, flags);
+  opt_mark_live(s, flags);
+
+  o.s = s;
+  o.flags = flags;
+  o.jsrc = (int*)codegen_palloc(s, sizeof(int)*(s->pc*6+2));
+  o.jnext = o.jsrc + s->pc;
+  o.defs = o.jnext + s->pc;
+  o.seen = o.defs + s->pc;
+  o.work = o.seen + s->pc;
+  o.stamp = 0;
+  for (pc = 0; pc < s->pc; pc++) {
+    o.jsrc[pc] = -1;
+    o.seen[pc] = 0;
+  }
+  for (pc = 0; pc < s->pc; pc++) {
+    mrb_code i = iseq[pc];
+
+    if (!(flags[pc] & OPT_DEAD) && opt_jump_p(GET_OPCODE(i))) {
+      o.jnext[pc] = o.jsrc[pc + GETARG_sBx(i)];
+      o.jsrc[pc + GETARG_sBx(i)] = pc;
+    }
+  }
+  for (pc = 0; pc < s->pc; pc++) {
+    if (!(flags[pc] & OPT_DEAD) && GET_OPCODE(iseq[pc]) == OP_MOVE) {
+      opt_coalesce_move(&o, pc);
+      if (!(flags[pc] & OPT_DEAD)) opt_move_branch(&o, pc);
+    }
+  }
+  for (pc = s->pc - 1; pc >= 0; pc--) {
+    mrb_code i = iseq[pc];
+    int target, prev;
+
+    if (flags[pc] & (OPT_DEAD|OPT_PIN)) continue;
+    op = GET_OPCODE(i);
+    if (op == OP_MOVE && GETARG_A(i) == GETARG_B(i)) {
+      flags[pc] |= OPT_DEAD;
+      continue;
+    }
+    if (op != OP_JMP && op != OP_JMPIF && op != OP_JMPNOT) continue;
+    target = pc + GETARG_sBx(i);
+    if (target <= pc || opt_next(flags, pc, s->pc) < target) continue;
+    prev = opt_prev(flags, pc);
+    if (op != OP_JMP && prev >= 0 &&
+        GET_OPCODE(iseq[prev]) >= OP_EQJ && GET_OPCODE(iseq[prev]) <= OP_GEJ) {
+      /* operand of the compare before it */
+      continue;
+    }
+    flags[pc] |= OPT_DEAD;
+  }
+
+  /* compact; a removed instruction maps to the next one kept */
+  map = (int*)codegen_palloc(s, sizeof(int)*(s->pc+1));
+  for (pc = 0, n = 0; pc < s->pc; pc++) {
+    map[pc] = n;
+    if (!(flags[pc] & OPT_DEAD)) n++;
+  }
+  map[s->pc] = n;
+  for (pc = 0; pc < s->pc; pc++) {
+    mrb_code i = iseq[pc];
+
+    if (flags[pc] & OPT_DEAD) continue;
+    op = GET_OPCODE(i);
+    if (opt_jump_p(op)) {
+      i = MKOP_AsBx(op, GETARG_A(i), map[pc + GETARG_sBx(i)] - map[pc]);
+    }
+    iseq[map[pc]] = i;
+    if (s->lines) s->lines[map[pc]] = s->lines[pc];
+  }
+  s->pc = n;
+
+  /* numbers whose loads were folded away */
+  map = (int*)codegen_palloc(s, sizeof(int)*(s->irep->plen+1));
+  for (n = 0; n < (int)s->irep->plen; n++) {
+    map[n] = mrb_string_p(s->irep->pool[n]) ? 1 : 0;
+  }
+  for (pc = 0; pc < s->pc; pc++) {
+    op = GET_OPCODE(iseq[pc]);
+    if (op == OP_LOADL || op == OP_STRING || op == OP_ERR) {
+      map[GETARG_Bx(iseq[pc])] = 1;
+    }
+  }
+  for (pc = 0, n = 0; pc < (int)s->irep->plen; pc++) {
+    if (map[pc]) {
+      s->irep->pool[n] = s->irep->pool[pc];
+      map[pc] = n++;
+    }
+  }
+  s->irep->plen = n;
+  for (pc = 0; pc < s->pc; pc++) {
+    mrb_code i = iseq[pc];
+
+    op = GET_OPCODE(i);
+    if (op == OP_LOADL || op == OP_STRING || op == OP_ERR) {
+      iseq[pc] = MKOP_ABx(op, GETARG_A(i), map[GETARG_Bx(i)]);
+    }
+  }
+}
+
 static void
 scope_finish(codegen_scope *s)
 {
@@ -2882,6 +3434,10 @@ scope_finish(codegen_scope *s)
   char *fname;
 
   irep->flags = 0;
+  if (s->iseq && s->pc > 0 && s->parser && s->parser->optimize &&
+      !no_optimize(s) && s->debug_start_pos == 0) {
+    optimize_iseq(s);
+  }
   if (s->iseq) {
     irep->iseq = (mrb_code *)codegen_realloc(s, s->iseq, sizeof(mrb_code)*s->pc);
     irep->ilen = s->pc;
@@ -5523,6 +5523,7 @@ parser_init_cxt(parser_state *p, mrbc_context *cxt)
   }
   p->capture_errors = cxt->capture_errors;
   p->no_optimize = cxt->no_optimize;
+  p->optimize = cxt->optimize;
   if (cxt->partial_hook) {
     p->cxt = cxt;
   }
@@ -195,17 +195,13 @@ module Enumerable
     return to_enum :sort_by unless block
 
     ary = []
-    orig = []
-    self.each_with_index{|e, i|
-      orig.push(e)
-      ary.push([block.call(e), i])
+    keys = []
+    self.each{|*val|
+      e = val.__svalue
+      ary.push(e)
+      keys.push(block.call(e))
     }
-    if ary.size > 1
-      __sort_sub__(ary, ::Array.new(ary.size), 0, 0, ary.size - 1) do |a,b|
-        a <=> b
-      end
-    end
-    ary.collect{|e,i| orig[i]}
+    ary.__sort_by_keys!(keys)
   end
 
   NONE = Object.new
@@ -46,6 +46,8 @@ end
 
 assert("Enumerable#sort_by") do
   assert_equal ["car", "train", "bicycle"], %w{car bicycle train}.sort_by {|e| e.length}
+  a = (0..99).to_a
+  assert_equal a.select {|e| e % 2 == 0 } + a.select {|e| e % 2 == 1 }, a.sort_by {|e| e % 2 }
 end
 
 assert("Enumerable#first") do
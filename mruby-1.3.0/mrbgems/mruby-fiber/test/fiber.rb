@@ -29,6 +29,56 @@ assert('Fiber#transfer') do
   assert_false f2.alive?
 end
 
+assert('Fiber.yield from blocks of Integer and Range iterators') do
+  f = Fiber.new do
+    3.times {|i| Fiber.yield i }
+    1.step(3, 2) {|i| Fiber.yield i }
+    for z in 0..1
+      Fiber.yield z * 10
+    end
+    :done
+  end
+  assert_equal [0, 1, 2, 1, 3, 0, 10, :done], (1..8).map { f.resume }
+end
+
+assert('Fiber.yield from sort blocks and <=>') do
+  f = Fiber.new { [3, 1, 2].sort { |a, b| Fiber.yield :in_sort; a <=> b } }
+  r = f.resume
+  assert_equal :in_sort, r
+  r = f.resume while r == :in_sort
+  assert_equal [1, 2, 3], r
+  f = Fiber.new { [3, 1, 2, 5, 4].sort! { |a, b| Fiber.yield(a <=> b) } }
+  r = f.resume
+  r = f.resume(r) while f.alive? && r.kind_of?(Integer)
+  assert_equal [1, 2, 3, 4, 5], r
+  c = Class.new do
+    attr_reader :v
+    def initialize(v) @v = v end
+    def <=>(o) Fiber.yield(:cmp); v <=> o.v end
+  end
+  f = Fiber.new { [c.new(2), c.new(1)].sort.map { |x| x.v } }
+  r = f.resume
+  r = f.resume while r == :cmp
+  assert_equal [1, 2], r
+  assert_raise(ArgumentError) { Fiber.new { [1, :a].sort { nil } }.resume }
+end
+
+assert('Fiber.yield from blocks of Array and Hash iterators') do
+  f = Fiber.new do
+    [1, 2].each {|i| Fiber.yield i }
+    [3].collect! {|i| Fiber.yield i }
+    { :a => 4 }.each {|k, v| Fiber.yield v }
+    { :b => 5 }.select {|k, v| Fiber.yield k }
+    [6].map {|i| Fiber.yield i }
+    [7].select {|i| Fiber.yield i }
+    [0, 8].inject {|s, i| Fiber.yield i }
+    [9].each_with_index {|x, i| Fiber.yield x }
+    [10].find {|i| Fiber.yield i }
+    :done
+  end
+  assert_equal [1, 2, 3, 4, :b, 6, 7, 8, 9, 10, :done], (1..11).map { f.resume }
+end
+
 assert('Fiber#alive?') do
   f = Fiber.new{ Fiber.yield }
   f.resume
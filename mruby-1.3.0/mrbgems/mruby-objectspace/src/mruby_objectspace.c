@@ -173,12 +173,71 @@ os_each_object(mrb_state *mrb, mrb_value self)
   return mrb_fixnum_value(d.count);
 }
 
+#ifndef MRB_NO_METHOD_CACHE
+/*
+ *  call-seq:
+ *     ObjectSpace.call_cache_stats([result_hash]) -> hash
+ *
+ *  Counts sends resolved by inline caches of call sites (:HIT), sends
+ *  that had to search the method (:MISS) and sends of megamorphic sites
+ *  that always use the global method cache (:MEGAMORPHIC_SEND), and the
+ *  number of call sites in each state, such as:
+ *  {
+ *    :HIT=>71977459,
+ *    :MISS=>405,
+ *    :MEGAMORPHIC_SEND=>0,
+ *    :SITE_EMPTY=>1342,
+ *    :SITE_MONOMORPHIC=>208,
+ *    :SITE_POLYMORPHIC=>3,
+ *    :SITE_MEGAMORPHIC=>0,
+ *  }
+ *
+ *  If the optional argument +result_hash+ is given,
+ *  it is overwritten and returned.
+ *
+ */
+
+static mrb_value
+os_call_cache_stats(mrb_state *mrb, mrb_value self)
+{
+  struct mrb_call_cache_stats stats = mrb->call_cache_stats;
+  size_t polymorphic = 0;
+  mrb_value hash;
+  int i;
+
+  if (mrb_get_args(mrb, "|H", &hash) == 0) {
+    hash = mrb_hash_new(mrb);
+  }
+
+  if (!mrb_test(mrb_hash_empty_p(mrb, hash))) {
+    mrb_hash_clear(mrb, hash);
+  }
+
+  mrb_hash_set(mrb, hash, mrb_symbol_value(mrb_intern_lit(mrb, "HIT")), mrb_fixnum_value((mrb_int)stats.hit));
+  mrb_hash_set(mrb, hash, mrb_symbol_value(mrb_intern_lit(mrb, "MISS")), mrb_fixnum_value((mrb_int)stats.miss));
+  mrb_hash_set(mrb, hash, mrb_symbol_value(mrb_intern_lit(mrb, "MEGAMORPHIC_SEND")), mrb_fixnum_value((mrb_int)stats.megamorphic));
+
+  for (i = 2; i <= MRB_CALL_CACHE_WAYS; i++) {
+    polymorphic += stats.sites[i];
+  }
+  mrb_hash_set(mrb, hash, mrb_symbol_value(mrb_intern_lit(mrb, "SITE_EMPTY")), mrb_fixnum_value((mrb_int)stats.sites[0]));
+  mrb_hash_set(mrb, hash, mrb_symbol_value(mrb_intern_lit(mrb, "SITE_MONOMORPHIC")), mrb_fixnum_value((mrb_int)stats.sites[1]));
+  mrb_hash_set(mrb, hash, mrb_symbol_value(mrb_intern_lit(mrb, "SITE_POLYMORPHIC")), mrb_fixnum_value((mrb_int)polymorphic));
+  mrb_hash_set(mrb, hash, mrb_symbol_value(mrb_intern_lit(mrb, "SITE_MEGAMORPHIC")), mrb_fixnum_value((mrb_int)stats.sites[MRB_CALL_CACHE_WAYS+1]));
+
+  return hash;
+}
+#endif
+
 void
 mrb_mruby_objectspace_gem_init(mrb_state *mrb)
 {
   struct RClass *os = mrb_define_module(mrb, "ObjectSpace");
   mrb_define_class_method(mrb, os, "count_objects", os_count_objects, MRB_ARGS_OPT(1));
   mrb_define_class_method(mrb, os, "each_object", os_each_object, MRB_ARGS_OPT(1));
+#ifndef MRB_NO_METHOD_CACHE
+  mrb_define_class_method(mrb, os, "call_cache_stats", os_call_cache_stats, MRB_ARGS_OPT(1));
+#endif
 }
 
 void
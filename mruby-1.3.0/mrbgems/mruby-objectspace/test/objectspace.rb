@@ -58,3 +58,27 @@ end
 assert 'Check class pointer of ObjectSpace.each_object.' do
   ObjectSpace.each_object { |obj| !obj }
 end
+
+assert('ObjectSpace.call_cache_stats') do
+  skip unless ObjectSpace.respond_to?(:call_cache_stats)
+  o = Object.new
+  before = ObjectSpace.call_cache_stats
+  10.times { o.to_s }
+  after = ObjectSpace.call_cache_stats({})
+  assert_true after[:MISS] > before[:MISS]
+  assert_true after[:HIT] >= before[:HIT] + 9
+end
+
+assert('ObjectSpace.call_cache_stats site states') do
+  skip unless ObjectSpace.respond_to?(:call_cache_stats)
+  objs = (1..6).map { |i| Class.new { define_method(:m) { i } }.new }
+  site = lambda { |o| o.m }
+  before = ObjectSpace.call_cache_stats
+  assert_equal [1, 2], objs[0, 2].map { |o| site.call(o) }
+  assert_true ObjectSpace.call_cache_stats[:SITE_POLYMORPHIC] > 0
+  assert_equal [1, 2, 3, 4, 5, 6], objs.map { |o| site.call(o) }
+  mega = ObjectSpace.call_cache_stats
+  assert_true mega[:SITE_MEGAMORPHIC] > before[:SITE_MEGAMORPHIC]
+  assert_equal [1, 2, 3, 4, 5, 6], objs.map { |o| site.call(o) }
+  assert_true ObjectSpace.call_cache_stats[:MEGAMORPHIC_SEND] >= mega[:MEGAMORPHIC_SEND] + 6
+end
@@ -0,0 +1,36 @@
+/*
+** mruby/typed_buffer.h - FloatBuffer and IntBuffer classes
+**
+** See Copyright Notice in mruby.h
+*/
+
+#ifndef MRUBY_TYPED_BUFFER_H
+#define MRUBY_TYPED_BUFFER_H
+
+#include "mruby.h"
+
+/**
+ * Contiguous arrays of unboxed numbers.
+ *
+ * FloatBuffer elements are C doubles, IntBuffer elements are mrb_int.
+ * Slices share storage with the buffer they were taken from.
+ */
+MRB_BEGIN_DECL
+
+MRB_API mrb_value mrb_float_buffer_new(mrb_state *mrb, mrb_int len);
+MRB_API mrb_value mrb_int_buffer_new(mrb_state *mrb, mrb_int len);
+
+MRB_API mrb_bool mrb_float_buffer_p(mrb_value obj);
+MRB_API mrb_bool mrb_int_buffer_p(mrb_value obj);
+
+/*
+ * Returns pointer to the first element and stores number of elements in len.
+ * Raises TypeError when obj is not a buffer of given type.
+ * The pointer is valid as long as obj is alive.
+ */
+MRB_API double *mrb_float_buffer_ptr(mrb_state *mrb, mrb_value obj, mrb_int *len);
+MRB_API mrb_int *mrb_int_buffer_ptr(mrb_state *mrb, mrb_value obj, mrb_int *len);
+
+MRB_END_DECL
+
+#endif  /* MRUBY_TYPED_BUFFER_H */
@@ -0,0 +1,628 @@
+/*
+** typed_buffer.c - FloatBuffer and IntBuffer classes
+**
+** See Copyright Notice in mruby.h
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <mruby.h>
+#include <mruby/array.h>
+#include <mruby/class.h>
+#include <mruby/data.h>
+#include <mruby/numeric.h>
+#include <mruby/string.h>
+#include <mruby/typed_buffer.h>
+
+/*
+ * Storage is reference counted, so slices can share it with the buffer
+ * they were taken from.
+ */
+typedef struct buf_storage {
+  mrb_int refcnt;
+  void *data;
+} buf_storage;
+
+typedef struct mrb_typed_buffer {
+  buf_storage *storage;
+  mrb_int offset;
+  mrb_int len;
+} mrb_typed_buffer;
+
+static void
+buf_free(mrb_state *mrb, void *p)
+{
+  mrb_typed_buffer *b = (mrb_typed_buffer*)p;
+
+  if (!b) return;
+  if (--b->storage->refcnt == 0) {
+    mrb_free(mrb, b->storage->data);
+    mrb_free(mrb, b->storage);
+  }
+  mrb_free(mrb, b);
+}
+
+static const struct mrb_data_type float_buffer_type = { "FloatBuffer", buf_free };
+static const struct mrb_data_type int_buffer_type = { "IntBuffer", buf_free };
+
+#define FBUF_PTR(b) ((double*)(b)->storage->data + (b)->offset)
+#define IBUF_PTR(b) ((mrb_int*)(b)->storage->data + (b)->offset)
+
+static mrb_bool
+buf_float_p(mrb_value self)
+{
+  return DATA_TYPE(self) == &float_buffer_type;
+}
+
+static size_t
+buf_elem_size(mrb_value self)
+{
+  return buf_float_p(self) ? sizeof(double) : sizeof(mrb_int);
+}
+
+static mrb_typed_buffer*
+buf_get(mrb_state *mrb, mrb_value self)
+{
+  mrb_typed_buffer *b;
+
+  if (mrb_type(self) != MRB_TT_DATA ||
+      (DATA_TYPE(self) != &float_buffer_type && DATA_TYPE(self) != &int_buffer_type)) {
+    mrb_raise(mrb, E_TYPE_ERROR, "expected FloatBuffer or IntBuffer");
+  }
+  b = (mrb_typed_buffer*)DATA_PTR(self);
+  if (!b) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "uninitialized buffer");
+  }
+  return b;
+}
+
+static mrb_typed_buffer*
+buf_alloc(mrb_state *mrb, mrb_int len, size_t elem_size)
+{
+  mrb_typed_buffer *b;
+  buf_storage *s;
+
+  if (len < 0) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "negative buffer size");
+  }
+  if ((size_t)len > SIZE_MAX / elem_size) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "buffer size too big");
+  }
+  s = (buf_storage*)mrb_malloc(mrb, sizeof(buf_storage));
+  s->refcnt = 1;
+  s->data = mrb_calloc(mrb, len > 0 ? len : 1, elem_size);
+  b = (mrb_typed_buffer*)mrb_malloc(mrb, sizeof(mrb_typed_buffer));
+  b->storage = s;
+  b->offset = 0;
+  b->len = len;
+  return b;
+}
+
+MRB_API mrb_value
+mrb_float_buffer_new(mrb_state *mrb, mrb_int len)
+{
+  struct RClass *c = mrb_class_get(mrb, "FloatBuffer");
+  mrb_typed_buffer *b = buf_alloc(mrb, len, sizeof(double));
+
+  return mrb_obj_value(mrb_data_object_alloc(mrb, c, b, &float_buffer_type));
+}
+
+MRB_API mrb_value
+mrb_int_buffer_new(mrb_state *mrb, mrb_int len)
+{
+  struct RClass *c = mrb_class_get(mrb, "IntBuffer");
+  mrb_typed_buffer *b = buf_alloc(mrb, len, sizeof(mrb_int));
+
+  return mrb_obj_value(mrb_data_object_alloc(mrb, c, b, &int_buffer_type));
+}
+
+MRB_API mrb_bool
+mrb_float_buffer_p(mrb_value obj)
+{
+  return mrb_type(obj) == MRB_TT_DATA && DATA_TYPE(obj) == &float_buffer_type && DATA_PTR(obj);
+}
+
+MRB_API mrb_bool
+mrb_int_buffer_p(mrb_value obj)
+{
+  return mrb_type(obj) == MRB_TT_DATA && DATA_TYPE(obj) == &int_buffer_type && DATA_PTR(obj);
+}
+
+MRB_API double*
+mrb_float_buffer_ptr(mrb_state *mrb, mrb_value obj, mrb_int *len)
+{
+  mrb_typed_buffer *b;
+
+  if (!mrb_float_buffer_p(obj)) {
+    mrb_raise(mrb, E_TYPE_ERROR, "expected FloatBuffer");
+  }
+  b = (mrb_typed_buffer*)DATA_PTR(obj);
+  if (len) *len = b->len;
+  return FBUF_PTR(b);
+}
+
+MRB_API mrb_int*
+mrb_int_buffer_ptr(mrb_state *mrb, mrb_value obj, mrb_int *len)
+{
+  mrb_typed_buffer *b;
+
+  if (!mrb_int_buffer_p(obj)) {
+    mrb_raise(mrb, E_TYPE_ERROR, "expected IntBuffer");
+  }
+  b = (mrb_typed_buffer*)DATA_PTR(obj);
+  if (len) *len = b->len;
+  return IBUF_PTR(b);
+}
+
+static mrb_value
+buf_elem_get(mrb_state *mrb, mrb_value self, mrb_typed_buffer *b, mrb_int i)
+{
+  if (buf_float_p(self)) {
+    return mrb_float_value(mrb, (mrb_float)FBUF_PTR(b)[i]);
+  }
+  return mrb_fixnum_value(IBUF_PTR(b)[i]);
+}
+
+static void
+buf_elem_set(mrb_state *mrb, mrb_value self, mrb_typed_buffer *b, mrb_int i, mrb_value v)
+{
+  if (buf_float_p(self)) {
+    FBUF_PTR(b)[i] = (double)mrb_to_flo(mrb, v);
+  }
+  else {
+    IBUF_PTR(b)[i] = mrb_int(mrb, v);
+  }
+}
+
+static void
+buf_fill(mrb_state *mrb, mrb_value self, mrb_typed_buffer *b, mrb_value v)
+{
+  mrb_int i;
+
+  if (buf_float_p(self)) {
+    double *p = FBUF_PTR(b);
+    double f = (double)mrb_to_flo(mrb, v);
+    for (i = 0; i < b->len; i++) p[i] = f;
+  }
+  else {
+    mrb_int *p = IBUF_PTR(b);
+    mrb_int n = mrb_int(mrb, v);
+    for (i = 0; i < b->len; i++) p[i] = n;
+  }
+}
+
+/*
+ *  call-seq:
+ *     FloatBuffer.new(size, value=0.0)  -> buffer
+ *     IntBuffer.new(size, value=0)      -> buffer
+ */
+static mrb_value
+buf_initialize(mrb_state *mrb, mrb_value self)
+{
+  mrb_int len;
+  mrb_value fill = mrb_nil_value();
+  mrb_typed_buffer *b;
+
+  mrb_get_args(mrb, "i|o", &len, &fill);
+  if (DATA_PTR(self)) {
+    buf_free(mrb, DATA_PTR(self));
+  }
+  mrb_data_init(self, NULL, NULL);
+  if (mrb_obj_is_kind_of(mrb, self, mrb_class_get(mrb, "FloatBuffer"))) {
+    b = buf_alloc(mrb, len, sizeof(double));
+    mrb_data_init(self, b, &float_buffer_type);
+  }
+  else {
+    b = buf_alloc(mrb, len, sizeof(mrb_int));
+    mrb_data_init(self, b, &int_buffer_type);
+  }
+  if (!mrb_nil_p(fill)) {
+    buf_fill(mrb, self, b, fill);
+  }
+  return self;
+}
+
+static mrb_value
+buf_initialize_copy(mrb_state *mrb, mrb_value copy)
+{
+  mrb_value src;
+  mrb_typed_buffer *s, *b;
+  size_t elem_size;
+
+  mrb_get_args(mrb, "o", &src);
+  if (mrb_obj_equal(mrb, copy, src)) return copy;
+  if (!mrb_obj_is_instance_of(mrb, src, mrb_obj_class(mrb, copy))) {
+    mrb_raise(mrb, E_TYPE_ERROR, "initialize_copy should take same class object");
+  }
+  s = buf_get(mrb, src);
+  elem_size = buf_elem_size(src);
+  b = buf_alloc(mrb, s->len, elem_size);
+  memcpy(b->storage->data, (char*)s->storage->data + s->offset * elem_size, s->len * elem_size);
+  if (DATA_PTR(copy)) {
+    buf_free(mrb, DATA_PTR(copy));
+  }
+  mrb_data_init(copy, b, DATA_TYPE(src));
+  return copy;
+}
+
+/*
+ *  call-seq:
+ *     FloatBuffer.from_a(array)  -> buffer
+ */
+static mrb_value
+buf_s_from_a(mrb_state *mrb, mrb_value klass)
+{
+  mrb_value ary, buf, len;
+  mrb_typed_buffer *b;
+  mrb_int i;
+
+  mrb_get_args(mrb, "A", &ary);
+  len = mrb_fixnum_value(RARRAY_LEN(ary));
+  buf = mrb_obj_new(mrb, mrb_class_ptr(klass), 1, &len);
+  b = buf_get(mrb, buf);
+  for (i = 0; i < b->len && i < RARRAY_LEN(ary); i++) {
+    buf_elem_set(mrb, buf, b, i, RARRAY_PTR(ary)[i]);
+  }
+  return buf;
+}
+
+static mrb_value
+buf_to_a(mrb_state *mrb, mrb_value self)
+{
+  mrb_typed_buffer *b = buf_get(mrb, self);
+  mrb_value ary = mrb_ary_new_capa(mrb, b->len);
+  int ai = mrb_gc_arena_save(mrb);
+  mrb_int i;
+
+  for (i = 0; i < b->len; i++) {
+    mrb_ary_push(mrb, ary, buf_elem_get(mrb, self, b, i));
+    mrb_gc_arena_restore(mrb, ai);
+  }
+  return ary;
+}
+
+static mrb_value
+buf_size(mrb_state *mrb, mrb_value self)
+{
+  return mrb_fixnum_value(buf_get(mrb, self)->len);
+}
+
+/* view of [start, start+len) sharing storage with self */
+static mrb_value
+buf_view(mrb_state *mrb, mrb_value self, mrb_int start, mrb_int len)
+{
+  mrb_typed_buffer *b = buf_get(mrb, self);
+  mrb_typed_buffer *v;
+
+  if (start < 0) start += b->len;
+  if (start < 0 || start > b->len || len < 0) return mrb_nil_value();
+  if (len > b->len - start) len = b->len - start;
+
+  v = (mrb_typed_buffer*)mrb_malloc(mrb, sizeof(mrb_typed_buffer));
+  v->storage = b->storage;
+  v->storage->refcnt++;
+  v->offset = b->offset + start;
+  v->len = len;
+  return mrb_obj_value(mrb_data_object_alloc(mrb, mrb_obj_class(mrb, self), v, DATA_TYPE(self)));
+}
+
+/*
+ *  call-seq:
+ *     buf[index]          -> number or nil
+ *     buf[start, length]  -> buffer (shares storage) or nil
+ */
+static mrb_value
+buf_aref(mrb_state *mrb, mrb_value self)
+{
+  mrb_typed_buffer *b = buf_get(mrb, self);
+  mrb_int idx, len;
+
+  if (mrb_get_args(mrb, "i|i", &idx, &len) == 2) {
+    return buf_view(mrb, self, idx, len);
+  }
+  if (idx < 0) idx += b->len;
+  if (idx < 0 || idx >= b->len) return mrb_nil_value();
+  return buf_elem_get(mrb, self, b, idx);
+}
+
+static mrb_value
+buf_slice(mrb_state *mrb, mrb_value self)
+{
+  mrb_int start, len;
+
+  mrb_get_args(mrb, "ii", &start, &len);
+  return buf_view(mrb, self, start, len);
+}
+
+static mrb_value
+buf_aset(mrb_state *mrb, mrb_value self)
+{
+  mrb_typed_buffer *b = buf_get(mrb, self);
+  mrb_int idx;
+  mrb_value v;
+
+  mrb_get_args(mrb, "io", &idx, &v);
+  if (idx < 0) idx += b->len;
+  if (idx < 0 || idx >= b->len) {
+    mrb_raisef(mrb, E_INDEX_ERROR, "index %S out of buffer", mrb_fixnum_value(idx));
+  }
+  buf_elem_set(mrb, self, b, idx, v);
+  return v;
+}
+
+static mrb_value
+buf_each(mrb_state *mrb, mrb_value self)
+{
+  mrb_typed_buffer *b = buf_get(mrb, self);
+  mrb_value blk;
+  mrb_int i;
+
+  mrb_get_args(mrb, "&", &blk);
+  if (mrb_nil_p(blk)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "no block given");
+  }
+  for (i = 0; i < b->len; i++) {
+    mrb_yield(mrb, blk, buf_elem_get(mrb, self, b, i));
+  }
+  return self;
+}
+
+static mrb_value
+buf_fill_m(mrb_state *mrb, mrb_value self)
+{
+  mrb_value v;
+
+  mrb_get_args(mrb, "o", &v);
+  buf_fill(mrb, self, buf_get(mrb, self), v);
+  return self;
+}
+
+static mrb_value
+buf_sum(mrb_state *mrb, mrb_value self)
+{
+  mrb_typed_buffer *b = buf_get(mrb, self);
+  mrb_int i;
+
+  if (buf_float_p(self)) {
+    const double *p = FBUF_PTR(b);
+    double sum = 0.0;
+    for (i = 0; i < b->len; i++) sum += p[i];
+    return mrb_float_value(mrb, (mrb_float)sum);
+  }
+  else {
+    const mrb_int *p = IBUF_PTR(b);
+    mrb_int sum = 0, s;
+    for (i = 0; i < b->len; i++) {
+      if (mrb_int_add_overflow(sum, p[i], &s)) {
+        /* continues in Float, as Integer#+ does */
+        mrb_float f = (mrb_float)sum;
+        for (; i < b->len; i++) f += (mrb_float)p[i];
+        return mrb_float_value(mrb, f);
+      }
+      sum = s;
+    }
+    return mrb_fixnum_value(sum);
+  }
+}
+
+static mrb_value
+buf_equal(mrb_state *mrb, mrb_value self)
+{
+  mrb_value other;
+  mrb_typed_buffer *a, *b;
+
+  mrb_get_args(mrb, "o", &other);
+  if (mrb_type(other) != MRB_TT_DATA || DATA_TYPE(other) != DATA_TYPE(self)) {
+    return mrb_false_value();
+  }
+  a = buf_get(mrb, self);
+  b = buf_get(mrb, other);
+  if (a->len != b->len) return mrb_false_value();
+  if (buf_float_p(self)) {
+    const double *p = FBUF_PTR(a), *q = FBUF_PTR(b);
+    mrb_int i;
+    for (i = 0; i < a->len; i++) {
+      if (p[i] != q[i]) return mrb_false_value();
+    }
+    return mrb_true_value();
+  }
+  return mrb_bool_value(memcmp(IBUF_PTR(a), IBUF_PTR(b), a->len * sizeof(mrb_int)) == 0);
+}
+
+/*
+ * Bulk arithmetic.  The right operand is a number or a buffer of the
+ * same class and size.
+ */
+enum buf_op { BUF_ADD, BUF_SUB, BUF_MUL, BUF_DIV };
+
+#define BUF_APPLY(p, q, n, op, expr_q) do {\
+  mrb_int i_;\
+  switch (op) {\
+  case BUF_ADD: for (i_ = 0; i_ < (n); i_++) (p)[i_] += (expr_q); break;\
+  case BUF_SUB: for (i_ = 0; i_ < (n); i_++) (p)[i_] -= (expr_q); break;\
+  case BUF_MUL: for (i_ = 0; i_ < (n); i_++) (p)[i_] *= (expr_q); break;\
+  case BUF_DIV: for (i_ = 0; i_ < (n); i_++) (p)[i_] /= (expr_q); break;\
+  }\
+} while (0)
+
+static mrb_bool
+buf_int_op_overflow(enum buf_op op, mrb_int x, mrb_int y, mrb_int *z)
+{
+  switch (op) {
+  case BUF_ADD: return mrb_int_add_overflow(x, y, z);
+  case BUF_SUB: return mrb_int_sub_overflow(x, y, z);
+  default:      return mrb_int_mul_overflow(x, y, z);
+  }
+}
+
+/*
+ * An IntBuffer can not hold the Float an overflowing Integer operation
+ * would return, so overflow raises.  All elements are checked before
+ * any is written, so a raising add!/sub!/mul! leaves the buffer as it was.
+ */
+static void
+buf_int_arith(mrb_state *mrb, mrb_int *p, const mrb_int *q, mrb_int n, mrb_int len, enum buf_op op)
+{
+  mrb_int i, z;
+
+  for (i = 0; i < len; i++) {
+    if (buf_int_op_overflow(op, p[i], q ? q[i] : n, &z)) {
+      mrb_raise(mrb, E_RANGE_ERROR, "integer overflow in IntBuffer arithmetic");
+    }
+  }
+  for (i = 0; i < len; i++) {
+    buf_int_op_overflow(op, p[i], q ? q[i] : n, &p[i]);
+  }
+}
+
+static void
+buf_arith(mrb_state *mrb, mrb_value dst, mrb_value other, enum buf_op op)
+{
+  mrb_typed_buffer *d = buf_get(mrb, dst);
+
+  if (mrb_type(other) == MRB_TT_DATA && DATA_TYPE(other) == DATA_TYPE(dst)) {
+    mrb_typed_buffer *o = buf_get(mrb, other);
+
+    if (o->len != d->len) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "buffer sizes differ");
+    }
+    if (buf_float_p(dst)) {
+      double *p = FBUF_PTR(d);
+      const double *q = FBUF_PTR(o);
+      BUF_APPLY(p, q, d->len, op, q[i_]);
+    }
+    else {
+      buf_int_arith(mrb, IBUF_PTR(d), IBUF_PTR(o), 0, d->len, op);
+    }
+  }
+  else if (mrb_type(other) == MRB_TT_DATA) {
+    mrb_raise(mrb, E_TYPE_ERROR, "buffer classes differ");
+  }
+  else if (buf_float_p(dst)) {
+    double *p = FBUF_PTR(d);
+    double f = (double)mrb_to_flo(mrb, other);
+    BUF_APPLY(p, f, d->len, op, f);
+  }
+  else {
+    buf_int_arith(mrb, IBUF_PTR(d), NULL, mrb_int(mrb, other), d->len, op);
+  }
+}
+
+static mrb_value
+buf_arith_new(mrb_state *mrb, mrb_value self, enum buf_op op)
+{
+  mrb_value other, result;
+
+  mrb_get_args(mrb, "o", &other);
+  result = mrb_obj_dup(mrb, self);
+  buf_arith(mrb, result, other, op);
+  return result;
+}
+
+static mrb_value
+buf_arith_bang(mrb_state *mrb, mrb_value self, enum buf_op op)
+{
+  mrb_value other;
+
+  mrb_get_args(mrb, "o", &other);
+  buf_arith(mrb, self, other, op);
+  return self;
+}
+
+static mrb_value buf_plus(mrb_state *mrb, mrb_value self) { return buf_arith_new(mrb, self, BUF_ADD); }
+static mrb_value buf_minus(mrb_state *mrb, mrb_value self) { return buf_arith_new(mrb, self, BUF_SUB); }
+static mrb_value buf_mul(mrb_state *mrb, mrb_value self) { return buf_arith_new(mrb, self, BUF_MUL); }
+static mrb_value buf_div(mrb_state *mrb, mrb_value self) { return buf_arith_new(mrb, self, BUF_DIV); }
+static mrb_value buf_add_bang(mrb_state *mrb, mrb_value self) { return buf_arith_bang(mrb, self, BUF_ADD); }
+static mrb_value buf_sub_bang(mrb_state *mrb, mrb_value self) { return buf_arith_bang(mrb, self, BUF_SUB); }
+static mrb_value buf_mul_bang(mrb_state *mrb, mrb_value self) { return buf_arith_bang(mrb, self, BUF_MUL); }
+static mrb_value buf_div_bang(mrb_state *mrb, mrb_value self) { return buf_arith_bang(mrb, self, BUF_DIV); }
+
+/*
+ *  call-seq:
+ *     buf.pack  -> string
+ *
+ *  Returns elements as a binary string in native byte order.
+ */
+static mrb_value
+buf_pack(mrb_state *mrb, mrb_value self)
+{
+  mrb_typed_buffer *b = buf_get(mrb, self);
+  size_t elem_size = buf_elem_size(self);
+
+  return mrb_str_new(mrb, (char*)b->storage->data + b->offset * elem_size, b->len * elem_size);
+}
+
+/*
+ *  call-seq:
+ *     FloatBuffer.unpack(string)  -> buffer
+ */
+static mrb_value
+buf_s_unpack(mrb_state *mrb, mrb_value klass)
+{
+  mrb_value str, buf, zero = mrb_fixnum_value(0);
+  mrb_typed_buffer *b, *old;
+  size_t elem_size;
+
+  mrb_get_args(mrb, "S", &str);
+  buf = mrb_obj_new(mrb, mrb_class_ptr(klass), 1, &zero);
+  elem_size = buf_elem_size(buf);
+  if (RSTRING_LEN(str) % elem_size != 0) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "string length is not a multiple of element size");
+  }
+  b = buf_alloc(mrb, RSTRING_LEN(str) / elem_size, elem_size);
+  old = (mrb_typed_buffer*)DATA_PTR(buf);
+  DATA_PTR(buf) = b;
+  buf_free(mrb, old);
+  memcpy(b->storage->data, RSTRING_PTR(str), RSTRING_LEN(str));
+  return buf;
+}
+
+static void
+buf_define_methods(mrb_state *mrb, struct RClass *c)
+{
+  MRB_SET_INSTANCE_TT(c, MRB_TT_DATA);
+
+  mrb_define_class_method(mrb, c, "from_a",  buf_s_from_a,        MRB_ARGS_REQ(1));
+  mrb_define_class_method(mrb, c, "unpack",  buf_s_unpack,        MRB_ARGS_REQ(1));
+
+  mrb_define_method(mrb, c, "initialize",      buf_initialize,      MRB_ARGS_ARG(1,1));
+  mrb_define_method(mrb, c, "initialize_copy", buf_initialize_copy, MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "size",            buf_size,            MRB_ARGS_NONE());
+  mrb_define_method(mrb, c, "length",          buf_size,            MRB_ARGS_NONE());
+  mrb_define_method(mrb, c, "[]",              buf_aref,            MRB_ARGS_ARG(1,1));
+  mrb_define_method(mrb, c, "[]=",             buf_aset,            MRB_ARGS_REQ(2));
+  mrb_define_method(mrb, c, "slice",           buf_slice,           MRB_ARGS_REQ(2));
+  mrb_define_method(mrb, c, "each",            buf_each,            MRB_ARGS_BLOCK());
+  mrb_define_method(mrb, c, "fill",            buf_fill_m,          MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "sum",             buf_sum,             MRB_ARGS_NONE());
+  mrb_define_method(mrb, c, "to_a",            buf_to_a,            MRB_ARGS_NONE());
+  mrb_define_method(mrb, c, "==",              buf_equal,           MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "pack",            buf_pack,            MRB_ARGS_NONE());
+  mrb_define_method(mrb, c, "+",               buf_plus,            MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "-",               buf_minus,           MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "*",               buf_mul,             MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "add!",            buf_add_bang,        MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "sub!",            buf_sub_bang,        MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "mul!",            buf_mul_bang,        MRB_ARGS_REQ(1));
+}
+
+void
+mrb_mruby_typed_buffer_gem_init(mrb_state *mrb)
+{
+  struct RClass *fbuf, *ibuf;
+
+  fbuf = mrb_define_class(mrb, "FloatBuffer", mrb->object_class);
+  buf_define_methods(mrb, fbuf);
+  /* integer division by zero is undefined, so only FloatBuffer divides */
+  mrb_define_method(mrb, fbuf, "/",    buf_div,      MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, fbuf, "div!", buf_div_bang, MRB_ARGS_REQ(1));
+
+  ibuf = mrb_define_class(mrb, "IntBuffer", mrb->object_class);
+  buf_define_methods(mrb, ibuf);
+}
+
+void
+mrb_mruby_typed_buffer_gem_final(mrb_state *mrb)
+{
+}
@@ -0,0 +1,99 @@
+##
+# FloatBuffer and IntBuffer Test
+
+assert('FloatBuffer.new') do
+  b = FloatBuffer.new(3)
+  assert_equal 3, b.size
+  assert_equal [0.0, 0.0, 0.0], b.to_a
+  assert_equal [1.5, 1.5], FloatBuffer.new(2, 1.5).to_a
+  assert_raise(ArgumentError) { FloatBuffer.new(-1) }
+end
+
+assert('IntBuffer.new') do
+  b = IntBuffer.new(2, 7)
+  assert_equal 2, b.length
+  assert_equal [7, 7], b.to_a
+end
+
+assert('FloatBuffer#[] and #[]=') do
+  b = FloatBuffer.from_a([1, 2.5, 3])
+  assert_equal 2.5, b[1]
+  assert_equal 3.0, b[-1]
+  assert_nil b[3]
+  b[0] = 4
+  assert_equal 4.0, b[0]
+  assert_raise(IndexError) { b[3] = 1.0 }
+end
+
+assert('FloatBuffer slice shares storage') do
+  b = FloatBuffer.from_a([1, 2, 3, 4])
+  s = b[1, 2]
+  assert_equal [2.0, 3.0], s.to_a
+  s[0] = 10
+  assert_equal 10.0, b[1]
+  t = b.slice(2, 10)
+  assert_equal [3.0, 4.0], t.to_a
+  t.add!(1)
+  assert_equal [1.0, 10.0, 4.0, 5.0], b.to_a
+end
+
+assert('FloatBuffer#dup does not share storage') do
+  b = FloatBuffer.from_a([1, 2])
+  c = b.dup
+  c[0] = 5
+  assert_equal 1.0, b[0]
+end
+
+assert('FloatBuffer arithmetic') do
+  a = FloatBuffer.from_a([1, 2, 3])
+  b = FloatBuffer.from_a([2, 2, 2])
+  assert_equal [3.0, 4.0, 5.0], (a + b).to_a
+  assert_equal [-1.0, 0.0, 1.0], (a - b).to_a
+  assert_equal [2.0, 4.0, 6.0], (a * 2).to_a
+  assert_equal [0.5, 1.0, 1.5], (a / 2).to_a
+  assert_equal [1.0, 2.0, 3.0], a.to_a
+  a.mul!(b)
+  assert_equal [2.0, 4.0, 6.0], a.to_a
+  assert_equal 12.0, a.sum
+  assert_raise(ArgumentError) { a + FloatBuffer.new(2) }
+  assert_raise(TypeError) { a + IntBuffer.new(3) }
+end
+
+assert('IntBuffer arithmetic') do
+  a = IntBuffer.from_a([1, 2, 3])
+  assert_equal [2, 3, 4], (a + 1).to_a
+  a.sub!(IntBuffer.new(3, 1))
+  assert_equal [0, 1, 2], a.to_a
+  assert_equal 3, a.sum
+  assert_false a.respond_to?(:/)
+end
+
+assert('IntBuffer overflow') do
+  max = 1
+  max = max * 2 + 1 while (max * 2 + 1).kind_of?(Integer)
+  a = IntBuffer.from_a([0, max])
+  assert_raise(RangeError) { a + 1 }
+  assert_raise(RangeError) { a.mul!(2) }
+  assert_raise(RangeError) { IntBuffer.from_a([-max, 0]).sub!(IntBuffer.from_a([2, 0])) }
+  assert_equal [0, max], a.to_a
+  assert_equal Float, IntBuffer.from_a([max, max]).sum.class
+  assert_equal max, IntBuffer.from_a([-1, max, 1]).sum
+  assert_kind_of Integer, IntBuffer.from_a([-1, max, 1]).sum
+end
+
+assert('FloatBuffer#pack and .unpack') do
+  a = FloatBuffer.from_a([1.25, -2.5])
+  s = a.pack
+  assert_equal 16, s.size
+  assert_equal a, FloatBuffer.unpack(s)
+  assert_raise(ArgumentError) { FloatBuffer.unpack("abc") }
+  i = IntBuffer.from_a([1, 2, 3])
+  assert_equal [2, 3, 1], IntBuffer.unpack(i[1, 2].pack + i[0, 1].pack).to_a
+end
+
+assert('FloatBuffer#each and #fill') do
+  a = FloatBuffer.new(3).fill(0.5)
+  sum = 0
+  a.each { |x| sum += x }
+  assert_equal 1.5, sum
+end
@@ -4,12 +4,16 @@
 # ISO 15.2.12
 class Array
 
+  # each, each_index and collect! are implemented in C (array.c).
+  # These versions run instead inside fibers: a block called from C
+  # cannot Fiber.yield.
+
   ##
   # Calls the given block for each element of +self+
   # and pass the respective element.
   #
   # ISO 15.2.12.5.10
-  def each(&block)
+  def __each(&block)
     return to_enum :each unless block_given?
 
     idx = 0
@@ -25,7 +29,7 @@ class Array
   # and pass the index of the respective element.
   #
   # ISO 15.2.12.5.11
-  def each_index(&block)
+  def __each_index(&block)
     return to_enum :each_index unless block_given?
 
     idx = 0
@@ -42,13 +46,61 @@ class Array
   # be replaced by the resulting values.
   #
   # ISO 15.2.12.5.7
-  def collect!(&block)
+  def __collect!(&block)
     return to_enum :collect! unless block_given?
 
     self.each_index { |idx| self[idx] = block.call(self[idx]) }
     self
   end
 
+  ##
+  # Merge sort used instead of sort and sort! (array.c) inside fibers,
+  # when the block or <=> may Fiber.yield.
+  def __sort!(&block)
+    n = self.size
+    src = self.dup
+    dst = Array.new(n)
+    width = 1
+    while width < n
+      lo = 0
+      while lo < n
+        mid = lo + width
+        mid = n if mid > n
+        hi = mid + width
+        hi = n if hi > n
+        i = lo
+        j = mid
+        k = lo
+        while k < hi
+          take_left = i < mid
+          if take_left && j < hi
+            a = src[i]
+            b = src[j]
+            c = block ? block.call(a, b) : a <=> b
+            raise ArgumentError, "comparison of #{a.class} with #{b.class} failed" if c.nil?
+            take_left = !(c > 0)
+          end
+          if take_left
+            dst[k] = src[i]
+            i += 1
+          else
+            dst[k] = src[j]
+            j += 1
+          end
+          k += 1
+        end
+        lo = hi
+      end
+      src, dst = dst, src
+      width *= 2
+    end
+    self.replace(src)
+  end
+
+  def __sort(&block)
+    ([] + self).__sort!(&block)
+  end
+
   ##
   # Alias for collect!
   #
@@ -191,11 +243,4 @@ end
 class Array
   # ISO 15.2.12.3
   include Enumerable
-
-  ##
-  # Sort all elements and replace +self+ with these
-  # elements.
-  def sort!(&block)
-    self.replace(self.sort(&block))
-  end
 end
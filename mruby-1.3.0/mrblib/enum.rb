@@ -315,45 +315,6 @@ module Enumerable
   # ISO 15.3.2.2.18
   alias select find_all
 
-  ##
-  # TODO
-  # Does this OK? Please test it.
-  def __sort_sub__(sorted, work, src_ary, head, tail, &block)
-    if head == tail
-      sorted[head] = work[head] if src_ary == 1
-      return
-    end
-
-    # on current step, which is a src ary?
-    if src_ary == 0
-      src, dst = sorted, work
-    else
-      src, dst = work, sorted
-    end
-
-    key = src[head]    # key value for dividing values
-    i, j = head, tail  # position to store on the dst ary
-
-    (head + 1).upto(tail){|idx|
-      if ((block)? block.call(src[idx], key): (src[idx] <=> key)) > 0
-        # larger than key
-        dst[j] = src[idx]
-        j -= 1
-      else
-        dst[i] = src[idx]
-        i += 1
-      end
-    }
-
-    sorted[i] = key
-
-    # sort each sub-array
-    src_ary = (src_ary + 1) % 2  # exchange a src ary
-    __sort_sub__(sorted, work, src_ary, head, i - 1, &block) if i > head
-    __sort_sub__(sorted, work, src_ary, i + 1, tail, &block) if i < tail
-  end
-#  private :__sort_sub__
-
   ##
   # Return a sorted array of all elements
   # which are yield by +each+. If no block
@@ -366,10 +327,7 @@ module Enumerable
   def sort(&block)
     ary = []
     self.each{|*val| ary.push(val.__svalue)}
-    if ary.size > 1
-      __sort_sub__(ary, ::Array.new(ary.size), 0, 0, ary.size - 1, &block)
-    end
-    ary
+    ary.sort!(&block)
   end
 
   ##
@@ -378,6 +336,15 @@ module Enumerable
   # ISO 15.3.2.2.20
   alias to_a entries
 
+  ##
+  # Array defines these in C (array.c). The Ruby versions run for
+  # subclasses that redefine each, and inside fibers.
+  alias __collect collect
+  alias __detect detect
+  alias __each_with_index each_with_index
+  alias __find_all find_all
+  alias __inject inject
+
   # redefine #hash 15.3.1.3.15
   def hash
     h = 12347
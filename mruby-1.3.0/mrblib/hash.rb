@@ -82,8 +82,12 @@ class Hash
   # a is 100
   # b is 200
   #
+  # Hash#each is implemented in C (hash.c), like each_key, each_value,
+  # select and reject. These versions run instead inside fibers: a block
+  # called from C cannot Fiber.yield.
+  #
   # ISO 15.2.13.4.9
-  def each(&block)
+  def __each(&block)
     return to_enum :each unless block_given?
 
     keys = self.keys
@@ -116,7 +120,7 @@ class Hash
   #  b
   #
   # ISO 15.2.13.4.10
-  def each_key(&block)
+  def __each_key(&block)
     return to_enum :each_key unless block_given?
 
     self.keys.each{|k| block.call(k)}
@@ -142,7 +146,7 @@ class Hash
   #  200
   #
   # ISO 15.2.13.4.11
-  def each_value(&block)
+  def __each_value(&block)
     return to_enum :each_value unless block_given?
 
     self.keys.each{|k| block.call(self[k])}
@@ -255,7 +259,7 @@ class Hash
   #
   #  1.8/1.9 Hash#reject returns Hash; ISO says nothing.
   #
-  def reject(&b)
+  def __reject(&b)
     return to_enum :reject unless block_given?
 
     h = {}
@@ -308,7 +312,7 @@ class Hash
   #
   #  1.9 Hash#select returns Hash; ISO says nothing
   #
-  def select(&b)
+  def __select(&b)
     return to_enum :select unless block_given?
 
     h = {}
@@ -39,12 +39,16 @@ end
 # mruby special - module to share methods between Floats and Integers
 #                 to make them compatible
 module Integral
+  # downto, times, upto and step are implemented in C (numeric.c).
+  # These versions run instead inside fibers: a block called from C
+  # cannot Fiber.yield.
+
   ##
   # Calls the given block once for each Integer
   # from +self+ downto +num+.
   #
   # ISO 15.2.8.3.15
-  def downto(num, &block)
+  def __downto(num, &block)
     return to_enum(:downto, num) unless block_given?
 
     i = self.to_i
@@ -69,7 +73,7 @@ module Integral
   # Calls the given block +self+ times.
   #
   # ISO 15.2.8.3.22
-  def times &block
+  def __times &block
     return to_enum :times unless block_given?
 
     i = 0
@@ -85,7 +89,7 @@ module Integral
   # from +self+ upto +num+.
   #
   # ISO 15.2.8.3.27
-  def upto(num, &block)
+  def __upto(num, &block)
     return to_enum(:upto, num) unless block_given?
 
     i = self.to_i
@@ -100,7 +104,7 @@ module Integral
   # Calls the given block from +self+ to +num+
   # incremented by +step+ (default 1).
   #
-  def step(num=nil, step=1, &block)
+  def __step(num=nil, step=1, &block)
     raise ArgumentError, "step can't be 0" if step == 0
     return to_enum(:step, num, step) unless block_given?
 
@@ -8,8 +8,11 @@ class Range
   # Calls the given block for each element of +self+
   # and pass the respective element.
   #
+  # Range#each is implemented in C (range.c). This version runs
+  # instead inside fibers: a block called from C cannot Fiber.yield.
+  #
   # ISO 15.2.14.4.4
-  def each(&block)
+  def __each(&block)
     return to_enum :each unless block_given?
 
     val = self.first
@@ -4,9 +4,11 @@
 ** See Copyright Notice in mruby.h
 */
 
+#include <math.h>
 #include <mruby.h>
 #include <mruby/array.h>
 #include <mruby/class.h>
+#include <mruby/proc.h>
 #include <mruby/string.h>
 #include <mruby/range.h>
 #include "value_array.h"
@@ -106,11 +108,17 @@ ary_fill_with_nil(mrb_value *ptr, mrb_int size)
 }
 
 static void
-ary_modify(mrb_state *mrb, struct RArray *a)
+ary_modify_check(mrb_state *mrb, struct RArray *a)
 {
   if (MRB_FROZEN_P(a)) {
     mrb_raise(mrb, E_RUNTIME_ERROR, "can't modify frozen array");
   }
+}
+
+static void
+ary_modify(mrb_state *mrb, struct RArray *a)
+{
+  ary_modify_check(mrb, a);
 
   if (ARY_SHARED_P(a)) {
     mrb_shared_array *shared = a->aux.shared;
@@ -458,7 +466,8 @@ mrb_ary_shift(mrb_state *mrb, mrb_value self)
   struct RArray *a = mrb_ary_ptr(self);
   mrb_value val;
 
-  ary_modify(mrb, a);
+  /* a shared array only moves its own window, the elements stay in place */
+  ary_modify_check(mrb, a);
   if (a->len == 0) return mrb_nil_value();
   if (ARY_SHARED_P(a)) {
   L_SHIFT:
@@ -1138,6 +1147,760 @@ mrb_ary_cmp(mrb_state *mrb, mrb_value ary1)
   return ary2;
 }
 
+/*
+ * Iterators of Array.  The storage is indexed on every step, so the
+ * block may change the array as it could with the Ruby versions they
+ * replace.  Those are kept as __each etc. and run inside fibers.
+ */
+
+mrb_bool mrb_iter_fallback(mrb_state *mrb, mrb_value self, const char *rname, mrb_value *vp);
+
+static mrb_value
+ary_enum(mrb_state *mrb, mrb_value ary, const char *name)
+{
+  return mrb_funcall(mrb, ary, "to_enum", 1, mrb_symbol_value(mrb_intern_cstr(mrb, name)));
+}
+
+/* 15.2.12.5.10 */
+/*
+ *  call-seq:
+ *     ary.each {|item| block }  -> ary
+ *
+ *  Calls the given block once for each element in +self+, passing
+ *  that element as a parameter.
+ */
+static mrb_value
+mrb_ary_each(mrb_state *mrb, mrb_value ary)
+{
+  mrb_value blk, v;
+  mrb_yieldinfo y;
+  mrb_int i;
+  int ai;
+
+  if (mrb_iter_fallback(mrb, ary, "__each", &v)) {
+    return v;
+  }
+  mrb_get_args(mrb, "&", &blk);
+  if (mrb_nil_p(blk)) {
+    return ary_enum(mrb, ary, "each");
+  }
+  ai = mrb_gc_arena_save(mrb);
+  mrb_yield_prepare(mrb, &y, blk, 1);
+  for (i = 0; i < RARRAY_LEN(ary); i++) {
+    v = RARRAY_PTR(ary)[i];
+    mrb_yield_fast(mrb, &y, &v);
+    mrb_gc_arena_restore(mrb, ai);
+  }
+  return ary;
+}
+
+/* 15.2.12.5.11 */
+/*
+ *  call-seq:
+ *     ary.each_index {|index| block }  -> ary
+ *
+ *  Same as Array#each, but passes the index of the element instead of
+ *  the element itself.
+ */
+static mrb_value
+mrb_ary_each_index(mrb_state *mrb, mrb_value ary)
+{
+  mrb_value blk, v;
+  mrb_yieldinfo y;
+  mrb_int i;
+  int ai;
+
+  if (mrb_iter_fallback(mrb, ary, "__each_index", &v)) {
+    return v;
+  }
+  mrb_get_args(mrb, "&", &blk);
+  if (mrb_nil_p(blk)) {
+    return ary_enum(mrb, ary, "each_index");
+  }
+  ai = mrb_gc_arena_save(mrb);
+  mrb_yield_prepare(mrb, &y, blk, 1);
+  for (i = 0; i < RARRAY_LEN(ary); i++) {
+    v = mrb_fixnum_value(i);
+    mrb_yield_fast(mrb, &y, &v);
+    mrb_gc_arena_restore(mrb, ai);
+  }
+  return ary;
+}
+
+/* 15.2.12.5.7 */
+/*
+ *  call-seq:
+ *     ary.collect! {|item| block }  -> ary
+ *     ary.map!     {|item| block }  -> ary
+ *
+ *  Invokes the block once for each element of +self+, replacing the
+ *  element with the value returned by the block.
+ */
+static mrb_value
+mrb_ary_collect_bang(mrb_state *mrb, mrb_value ary)
+{
+  mrb_value blk, v;
+  mrb_yieldinfo y;
+  mrb_int i;
+  int ai;
+
+  if (mrb_iter_fallback(mrb, ary, "__collect!", &v)) {
+    return v;
+  }
+  mrb_get_args(mrb, "&", &blk);
+  if (mrb_nil_p(blk)) {
+    return ary_enum(mrb, ary, "collect!");
+  }
+  ai = mrb_gc_arena_save(mrb);
+  mrb_yield_prepare(mrb, &y, blk, 1);
+  for (i = 0; i < RARRAY_LEN(ary); i++) {
+    v = RARRAY_PTR(ary)[i];
+    v = mrb_yield_fast(mrb, &y, &v);
+    mrb_ary_set(mrb, ary, i, v);
+    mrb_gc_arena_restore(mrb, ai);
+  }
+  return ary;
+}
+
+/*
+ * The Enumerable methods below read the elements directly. Array
+ * subclasses that redefine +each+ get the Ruby versions (__collect
+ * etc. in enum.rb), which call it, as do blocks inside fibers.
+ */
+static mrb_value
+ary_enum_send(mrb_state *mrb, mrb_value ary, const char *rname)
+{
+  mrb_value *argv, blk;
+  mrb_int argc;
+
+  mrb_get_args(mrb, "*&", &argv, &argc, &blk);
+  /* the Ruby version may keep the block */
+  if (mrb_type(blk) == MRB_TT_PROC && mrb_proc_ptr(blk)->env) {
+    mrb_env_escape(mrb, mrb_proc_ptr(blk)->env);
+  }
+  return mrb_funcall_with_block(mrb, ary, mrb_intern_cstr(mrb, rname), argc, argv, blk);
+}
+
+static mrb_bool
+ary_enum_ruby_p(mrb_state *mrb, mrb_value ary, const char *rname, mrb_value *vp)
+{
+  struct RClass *c;
+  struct RProc *p;
+
+  if (mrb_iter_fallback(mrb, ary, rname, vp)) {
+    return TRUE;
+  }
+  c = mrb_class(mrb, ary);
+  if (c == mrb->array_class) return FALSE;
+  p = mrb_method_search_vm(mrb, &c, mrb_intern_lit(mrb, "each"));
+  if (p && MRB_PROC_CFUNC_P(p) && p->body.func == mrb_ary_each) {
+    return FALSE;
+  }
+  *vp = ary_enum_send(mrb, ary, rname);
+  return TRUE;
+}
+
+/* 15.3.2.2.3 */
+/*
+ *  call-seq:
+ *     ary.collect {|item| block }  -> new_ary
+ *     ary.map     {|item| block }  -> new_ary
+ *
+ *  Returns a new array with the results of running the block once for
+ *  every element.
+ */
+static mrb_value
+mrb_ary_collect(mrb_state *mrb, mrb_value ary)
+{
+  mrb_value blk, v, result;
+  mrb_yieldinfo y;
+  mrb_int i;
+  int ai;
+
+  if (ary_enum_ruby_p(mrb, ary, "__collect", &v)) {
+    return v;
+  }
+  mrb_get_args(mrb, "&", &blk);
+  if (mrb_nil_p(blk)) {
+    return ary_enum(mrb, ary, "collect");
+  }
+  result = mrb_ary_new_capa(mrb, RARRAY_LEN(ary));
+  ai = mrb_gc_arena_save(mrb);
+  mrb_yield_prepare(mrb, &y, blk, 1);
+  for (i = 0; i < RARRAY_LEN(ary); i++) {
+    v = RARRAY_PTR(ary)[i];
+    mrb_ary_push(mrb, result, mrb_yield_fast(mrb, &y, &v));
+    mrb_gc_arena_restore(mrb, ai);
+  }
+  return result;
+}
+
+/* 15.3.2.2.4 */
+/*
+ *  call-seq:
+ *     ary.detect(ifnone = nil) {|item| block }  -> obj or ifnone
+ *     ary.find(ifnone = nil)   {|item| block }  -> obj or ifnone
+ *
+ *  Returns the first element for which the block is not false, or
+ *  +ifnone+ if there is none.
+ */
+static mrb_value
+mrb_ary_detect(mrb_state *mrb, mrb_value ary)
+{
+  mrb_value ifnone = mrb_nil_value();
+  mrb_value blk, v;
+  mrb_yieldinfo y;
+  mrb_int i;
+  int ai;
+
+  if (ary_enum_ruby_p(mrb, ary, "__detect", &v)) {
+    return v;
+  }
+  mrb_get_args(mrb, "|o&", &ifnone, &blk);
+  if (mrb_nil_p(blk)) {
+    return ary_enum(mrb, ary, "detect");
+  }
+  ai = mrb_gc_arena_save(mrb);
+  mrb_yield_prepare(mrb, &y, blk, 1);
+  for (i = 0; i < RARRAY_LEN(ary); i++) {
+    v = RARRAY_PTR(ary)[i];
+    if (mrb_test(mrb_yield_fast(mrb, &y, &v))) {
+      return v;
+    }
+    mrb_gc_arena_restore(mrb, ai);
+  }
+  return ifnone;
+}
+
+/* 15.3.2.2.5 */
+/*
+ *  call-seq:
+ *     ary.each_with_index {|item, index| block }  -> ary
+ *
+ *  Calls the block with every element and its index.
+ */
+static mrb_value
+mrb_ary_each_with_index(mrb_state *mrb, mrb_value ary)
+{
+  mrb_value blk, v, args[2];
+  mrb_yieldinfo y;
+  mrb_int i;
+  int ai;
+
+  if (ary_enum_ruby_p(mrb, ary, "__each_with_index", &v)) {
+    return v;
+  }
+  mrb_get_args(mrb, "&", &blk);
+  if (mrb_nil_p(blk)) {
+    return ary_enum(mrb, ary, "each_with_index");
+  }
+  ai = mrb_gc_arena_save(mrb);
+  mrb_yield_prepare(mrb, &y, blk, 2);
+  for (i = 0; i < RARRAY_LEN(ary); i++) {
+    args[0] = RARRAY_PTR(ary)[i];
+    args[1] = mrb_fixnum_value(i);
+    mrb_yield_fast(mrb, &y, args);
+    mrb_gc_arena_restore(mrb, ai);
+  }
+  return ary;
+}
+
+/* 15.3.2.2.8 */
+/*
+ *  call-seq:
+ *     ary.find_all {|item| block }  -> new_ary
+ *     ary.select   {|item| block }  -> new_ary
+ *
+ *  Returns a new array with the elements for which the block is not
+ *  false.
+ */
+static mrb_value
+mrb_ary_find_all(mrb_state *mrb, mrb_value ary)
+{
+  mrb_value blk, v, result;
+  mrb_yieldinfo y;
+  mrb_int i;
+  int ai;
+
+  if (ary_enum_ruby_p(mrb, ary, "__find_all", &v)) {
+    return v;
+  }
+  mrb_get_args(mrb, "&", &blk);
+  if (mrb_nil_p(blk)) {
+    return ary_enum(mrb, ary, "find_all");
+  }
+  result = mrb_ary_new(mrb);
+  ai = mrb_gc_arena_save(mrb);
+  mrb_yield_prepare(mrb, &y, blk, 1);
+  for (i = 0; i < RARRAY_LEN(ary); i++) {
+    v = RARRAY_PTR(ary)[i];
+    if (mrb_test(mrb_yield_fast(mrb, &y, &v))) {
+      mrb_ary_push(mrb, result, v);
+    }
+    mrb_gc_arena_restore(mrb, ai);
+  }
+  return result;
+}
+
+/* 15.3.2.2.11 */
+/*
+ *  call-seq:
+ *     ary.inject(initial = nil) {|memo, item| block }  -> obj
+ *     ary.inject(initial = nil, sym)                   -> obj
+ *     ary.reduce(initial = nil) {|memo, item| block }  -> obj
+ *
+ *  Combines the elements by calling the block, or the method +sym+ of
+ *  the result so far, with the result so far and each element. Starts
+ *  with +initial+, or the first element if it is not given.
+ */
+static mrb_value
+mrb_ary_inject(mrb_state *mrb, mrb_value ary)
+{
+  mrb_value *argv, blk, v, result, args[2];
+  mrb_int argc, i;
+  mrb_sym sym = 0;
+  mrb_yieldinfo y;
+  int ai;
+
+  if (ary_enum_ruby_p(mrb, ary, "__inject", &v)) {
+    return v;
+  }
+  mrb_get_args(mrb, "*&", &argv, &argc, &blk);
+  if (argc > 2) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "too many arguments");
+  }
+  if (argc > 0 && mrb_symbol_p(argv[argc-1])) {
+    sym = mrb_symbol(argv[--argc]);
+  }
+  i = 0;
+  if (argc > 0) {
+    result = argv[0];
+  }
+  else if (RARRAY_LEN(ary) > 0) {
+    result = RARRAY_PTR(ary)[i++];
+  }
+  else {
+    return mrb_nil_value();
+  }
+  if (!sym && i < RARRAY_LEN(ary)) {
+    mrb_yield_prepare(mrb, &y, blk, 2);
+  }
+  ai = mrb_gc_arena_save(mrb);
+  for (; i < RARRAY_LEN(ary); i++) {
+    v = RARRAY_PTR(ary)[i];
+    if (sym) {
+      result = mrb_funcall_argv(mrb, result, sym, 1, &v);
+    }
+    else {
+      args[0] = result;
+      args[1] = v;
+      result = mrb_yield_fast(mrb, &y, args);
+    }
+    mrb_gc_arena_restore(mrb, ai);
+    mrb_gc_protect(mrb, result);
+  }
+  return result;
+}
+
+/*
+ * Sorting: pattern-defeating quicksort on a copy of the array, with
+ * insertion sort for short ranges and heapsort once partitions keep
+ * being unbalanced.  Arrays of only Fixnums, only numbers or only
+ * Strings are compared without calling <=>.  Elements are only swapped,
+ * so the copy holds all of them, reachable for the GC, whenever a
+ * comparison runs Ruby code.
+ */
+
+#define SORT_INSERTION 16
+#define SORT_NINTHER 128
+
+enum sort_type {
+  SORT_FIXNUM,
+  SORT_FLOAT,   /* Fixnums and Floats, no NaN */
+  SORT_STRING,
+  SORT_CMP,     /* <=> */
+  SORT_BLOCK
+};
+
+struct sort_ctx {
+  enum sort_type type;
+  const mrb_value *keys;  /* sort_by: elements are indexes of keys */
+  mrb_yieldinfo y;
+  int ai;
+};
+
+#define SORT_FLO(v) (mrb_fixnum_p(v) ? (mrb_float)mrb_fixnum(v) : mrb_float(v))
+
+static enum sort_type
+sort_type(mrb_state *mrb, const mrb_value *p, mrb_int len)
+{
+  mrb_int i;
+  mrb_bool fix = TRUE, num = TRUE, str = TRUE;
+
+  for (i = 0; i < len; i++) {
+    if (mrb_fixnum_p(p[i])) {
+      str = FALSE;
+    }
+    else if (mrb_float_p(p[i]) && !isnan(mrb_float(p[i]))) {
+      fix = str = FALSE;
+    }
+    else if (mrb_string_p(p[i]) && mrb_obj_class(mrb, p[i]) == mrb->string_class) {
+      fix = num = FALSE;
+    }
+    else {
+      return SORT_CMP;
+    }
+  }
+  if (fix) return SORT_FIXNUM;
+  if (num) return SORT_FLOAT;
+  if (str) return SORT_STRING;
+  return SORT_CMP;
+}
+
+/* sign of the value returned by <=> or the sort block */
+static int
+sort_cmpint(mrb_state *mrb, mrb_value c, mrb_value a, mrb_value b)
+{
+  if (mrb_fixnum_p(c)) {
+    return (mrb_fixnum(c) > 0) - (mrb_fixnum(c) < 0);
+  }
+  if (mrb_float_p(c)) {
+    return (mrb_float(c) > 0) - (mrb_float(c) < 0);
+  }
+  if (mrb_nil_p(c)) {
+    mrb_raisef(mrb, E_ARGUMENT_ERROR, "comparison of %S with %S failed",
+               mrb_obj_value(mrb_obj_class(mrb, a)), mrb_obj_value(mrb_obj_class(mrb, b)));
+  }
+  if (mrb_test(mrb_funcall(mrb, c, ">", 1, mrb_fixnum_value(0)))) return 1;
+  if (mrb_test(mrb_funcall(mrb, c, "<", 1, mrb_fixnum_value(0)))) return -1;
+  return 0;
+}
+
+static int
+sort_cmp(mrb_state *mrb, struct sort_ctx *ctx, mrb_value a, mrb_value b)
+{
+  mrb_value x = a, y = b;
+  int r;
+
+  if (ctx->keys) {
+    x = ctx->keys[mrb_fixnum(a)];
+    y = ctx->keys[mrb_fixnum(b)];
+  }
+  switch (ctx->type) {
+  case SORT_FIXNUM:
+    r = (mrb_fixnum(x) > mrb_fixnum(y)) - (mrb_fixnum(x) < mrb_fixnum(y));
+    break;
+  case SORT_FLOAT:
+    r = (SORT_FLO(x) > SORT_FLO(y)) - (SORT_FLO(x) < SORT_FLO(y));
+    break;
+  case SORT_STRING:
+    r = mrb_str_cmp(mrb, x, y);
+    break;
+  case SORT_BLOCK:
+    {
+      mrb_value argv[2];
+
+      argv[0] = x;
+      argv[1] = y;
+      r = sort_cmpint(mrb, mrb_yield_fast(mrb, &ctx->y, argv), x, y);
+      mrb_gc_arena_restore(mrb, ctx->ai);
+    }
+    break;
+  default:
+    r = sort_cmpint(mrb, mrb_funcall(mrb, x, "<=>", 1, y), x, y);
+    mrb_gc_arena_restore(mrb, ctx->ai);
+    break;
+  }
+  if (r == 0 && ctx->keys) {
+    /* sort_by keeps the order of equal keys */
+    r = (mrb_fixnum(a) > mrb_fixnum(b)) - (mrb_fixnum(a) < mrb_fixnum(b));
+  }
+  return r;
+}
+
+#define SORT_LT(i, j) (sort_cmp(mrb, ctx, v[i], v[j]) < 0)
+
+static void
+sort_swap(mrb_value *v, mrb_int i, mrb_int j)
+{
+  mrb_value t = v[i];
+
+  v[i] = v[j];
+  v[j] = t;
+}
+
+static void
+sort_insertion(mrb_state *mrb, struct sort_ctx *ctx, mrb_value *v, mrb_int lo, mrb_int hi)
+{
+  mrb_int i, j;
+
+  for (i = lo + 1; i < hi; i++) {
+    for (j = i; j > lo && SORT_LT(j, j - 1); j--) {
+      sort_swap(v, j, j - 1);
+    }
+  }
+}
+
+/* insertion sort giving up after a few moves; TRUE if [lo, hi) is sorted */
+static mrb_bool
+sort_insertion_partial(mrb_state *mrb, struct sort_ctx *ctx, mrb_value *v, mrb_int lo, mrb_int hi)
+{
+  mrb_int i, j, moves = 0;
+
+  for (i = lo + 1; i < hi; i++) {
+    for (j = i; j > lo && SORT_LT(j, j - 1); j--) {
+      sort_swap(v, j, j - 1);
+      moves++;
+    }
+    if (moves > 8) return FALSE;
+  }
+  return TRUE;
+}
+
+static void
+sort_sift(mrb_state *mrb, struct sort_ctx *ctx, mrb_value *v, mrb_int lo, mrb_int root, mrb_int n)
+{
+  mrb_int child;
+
+  while ((child = 2 * root + 1) < n) {
+    if (child + 1 < n && SORT_LT(lo + child, lo + child + 1)) child++;
+    if (!SORT_LT(lo + root, lo + child)) break;
+    sort_swap(v, lo + root, lo + child);
+    root = child;
+  }
+}
+
+static void
+sort_heap(mrb_state *mrb, struct sort_ctx *ctx, mrb_value *v, mrb_int lo, mrb_int hi)
+{
+  mrb_int i, n = hi - lo;
+
+  for (i = n / 2 - 1; i >= 0; i--) {
+    sort_sift(mrb, ctx, v, lo, i, n);
+  }
+  for (i = n - 1; i > 0; i--) {
+    sort_swap(v, lo, lo + i);
+    sort_sift(mrb, ctx, v, lo, 0, i);
+  }
+}
+
+/* puts the median of v[a], v[b], v[c] into v[b] */
+static void
+sort3(mrb_state *mrb, struct sort_ctx *ctx, mrb_value *v, mrb_int a, mrb_int b, mrb_int c)
+{
+  if (SORT_LT(b, a)) sort_swap(v, a, b);
+  if (SORT_LT(c, b)) {
+    sort_swap(v, b, c);
+    if (SORT_LT(b, a)) sort_swap(v, a, b);
+  }
+}
+
+/* partitions (lo, hi) around the pivot v[lo]: elements less than it to the
+   left; returns the final position of the pivot */
+static mrb_int
+sort_partition_right(mrb_state *mrb, struct sort_ctx *ctx, mrb_value *v,
+                     mrb_int lo, mrb_int hi, mrb_bool *already)
+{
+  mrb_int i = lo + 1, j = hi - 1;
+
+  while (i <= j && SORT_LT(i, lo)) i++;
+  while (i <= j && !SORT_LT(j, lo)) j--;
+  *already = i > j;
+  while (i < j) {
+    sort_swap(v, i++, j--);
+    while (i <= j && SORT_LT(i, lo)) i++;
+    while (i <= j && !SORT_LT(j, lo)) j--;
+  }
+  sort_swap(v, lo, j);
+  return j;
+}
+
+/* same, elements equal to the pivot to the left */
+static mrb_int
+sort_partition_left(mrb_state *mrb, struct sort_ctx *ctx, mrb_value *v, mrb_int lo, mrb_int hi)
+{
+  mrb_int i = lo + 1, j = hi - 1;
+
+  while (i <= j && !SORT_LT(lo, i)) i++;
+  while (i <= j && SORT_LT(lo, j)) j--;
+  while (i < j) {
+    sort_swap(v, i++, j--);
+    while (i <= j && !SORT_LT(lo, i)) i++;
+    while (i <= j && SORT_LT(lo, j)) j--;
+  }
+  sort_swap(v, lo, j);
+  return j;
+}
+
+static void
+sort_pdq(mrb_state *mrb, struct sort_ctx *ctx, mrb_value *v, mrb_int lo, mrb_int hi,
+         int bad, mrb_bool leftmost)
+{
+  for (;;) {
+    mrb_int n = hi - lo, m = lo + n / 2, p, l, r;
+    mrb_bool already;
+
+    if (n < SORT_INSERTION) {
+      sort_insertion(mrb, ctx, v, lo, hi);
+      return;
+    }
+    /* median of 3, or pseudo median of 9, as pivot in v[lo] */
+    if (n > SORT_NINTHER) {
+      sort3(mrb, ctx, v, lo, m, hi - 1);
+      sort3(mrb, ctx, v, lo + 1, m - 1, hi - 2);
+      sort3(mrb, ctx, v, lo + 2, m + 1, hi - 3);
+      sort3(mrb, ctx, v, m - 1, m, m + 1);
+      sort_swap(v, lo, m);
+    }
+    else {
+      sort3(mrb, ctx, v, m, lo, hi - 1);
+    }
+    /* pivot equal to the one before the range: skip elements equal to it */
+    if (!leftmost && !SORT_LT(lo - 1, lo)) {
+      lo = sort_partition_left(mrb, ctx, v, lo, hi) + 1;
+      continue;
+    }
+    p = sort_partition_right(mrb, ctx, v, lo, hi, &already);
+    l = p - lo;
+    r = hi - p - 1;
+    if (l < n / 8 || r < n / 8) {
+      /* unbalanced: break patterns, or give up on quicksort */
+      if (--bad == 0) {
+        sort_heap(mrb, ctx, v, lo, hi);
+        return;
+      }
+      if (l >= SORT_INSERTION) {
+        sort_swap(v, lo, lo + l / 4);
+        sort_swap(v, p - 1, p - l / 4);
+      }
+      if (r >= SORT_INSERTION) {
+        sort_swap(v, p + 1, p + 1 + r / 4);
+        sort_swap(v, hi - 1, hi - r / 4);
+      }
+    }
+    else if (already &&
+             sort_insertion_partial(mrb, ctx, v, lo, p) &&
+             sort_insertion_partial(mrb, ctx, v, p + 1, hi)) {
+      return;
+    }
+    /* recurse into the smaller part */
+    if (l < r) {
+      sort_pdq(mrb, ctx, v, lo, p, bad, leftmost);
+      lo = p + 1;
+      leftmost = FALSE;
+    }
+    else {
+      sort_pdq(mrb, ctx, v, p + 1, hi, bad, FALSE);
+      hi = p;
+    }
+  }
+}
+
+/* sorts the elements of ary, which must not be visible to Ruby code */
+static void
+ary_sort(mrb_state *mrb, mrb_value ary, mrb_value blk, const mrb_value *keys)
+{
+  struct sort_ctx ctx;
+  mrb_int len = RARRAY_LEN(ary);
+  int bad = 1;
+
+  if (len < 2) return;
+  ctx.keys = keys;
+  if (!mrb_nil_p(blk)) {
+    ctx.type = SORT_BLOCK;
+    mrb_yield_prepare(mrb, &ctx.y, blk, 2);
+  }
+  else {
+    ctx.type = sort_type(mrb, keys ? keys : RARRAY_PTR(ary), len);
+  }
+  ctx.ai = mrb_gc_arena_save(mrb);
+  while (len >>= 1) bad++;
+  sort_pdq(mrb, &ctx, mrb_ary_ptr(ary)->ptr, 0, RARRAY_LEN(ary), bad, TRUE);
+}
+
+/* the block or <=> may Fiber.yield, which they can not when called
+   from C: inside fibers the Ruby versions (__sort etc.) sort instead */
+static mrb_bool
+sort_fallback(mrb_state *mrb, mrb_value ary, mrb_value blk, const char *rname, mrb_value *vp)
+{
+  if (mrb->c == mrb->root_c) return FALSE;
+  if (mrb_nil_p(blk) && sort_type(mrb, RARRAY_PTR(ary), RARRAY_LEN(ary)) != SORT_CMP) {
+    return FALSE;
+  }
+  return mrb_iter_fallback(mrb, ary, rname, vp);
+}
+
+/* 15.3.2.2.19 */
+/*
+ *  call-seq:
+ *     ary.sort                   -> new_ary
+ *     ary.sort { |a, b| block }  -> new_ary
+ *
+ *  Returns a new array created by sorting +self+.  Comparisons are done
+ *  with <code><=></code> or with the given block, which must return a
+ *  negative number, 0 or a positive number.
+ */
+static mrb_value
+mrb_ary_sort(mrb_state *mrb, mrb_value ary)
+{
+  mrb_value blk, sorted;
+
+  mrb_get_args(mrb, "&", &blk);
+  if (sort_fallback(mrb, ary, blk, "__sort", &sorted)) {
+    return sorted;
+  }
+  sorted = mrb_ary_new_from_values(mrb, RARRAY_LEN(ary), RARRAY_PTR(ary));
+  ary_sort(mrb, sorted, blk, NULL);
+  return sorted;
+}
+
+/*
+ *  call-seq:
+ *     ary.sort!                   -> ary
+ *     ary.sort! { |a, b| block }  -> ary
+ *
+ *  Sorts +self+ in place, see Array#sort.
+ */
+static mrb_value
+mrb_ary_sort_bang(mrb_state *mrb, mrb_value ary)
+{
+  mrb_value blk, sorted;
+
+  mrb_get_args(mrb, "&", &blk);
+  if (sort_fallback(mrb, ary, blk, "__sort!", &sorted)) {
+    return sorted;
+  }
+  sorted = mrb_ary_new_from_values(mrb, RARRAY_LEN(ary), RARRAY_PTR(ary));
+  ary_sort(mrb, sorted, blk, NULL);
+  mrb_ary_replace(mrb, ary, sorted);
+  return ary;
+}
+
+/* sorts self by the keys at the same positions in keys (sort_by of
+   mruby-enum-ext); the order of equal keys is kept */
+static mrb_value
+mrb_ary_sort_by_keys(mrb_state *mrb, mrb_value ary)
+{
+  mrb_value keys, idx, sorted;
+  mrb_int i, len = RARRAY_LEN(ary);
+
+  mrb_get_args(mrb, "A", &keys);
+  if (RARRAY_LEN(keys) != len) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "keys and array differ in length");
+  }
+  idx = mrb_ary_new_capa(mrb, len);
+  for (i = 0; i < len; i++) {
+    mrb_ary_push(mrb, idx, mrb_fixnum_value(i));
+  }
+  ary_sort(mrb, idx, mrb_nil_value(), RARRAY_PTR(keys));
+  sorted = mrb_ary_new_capa(mrb, len);
+  for (i = 0; i < len; i++) {
+    mrb_ary_push(mrb, sorted, RARRAY_PTR(ary)[mrb_fixnum(RARRAY_PTR(idx)[i])]);
+  }
+  mrb_ary_replace(mrb, ary, sorted);
+  return ary;
+}
+
 void
 mrb_init_array(mrb_state *mrb)
 {
@@ -1154,29 +1917,44 @@ mrb_init_array(mrb_state *mrb)
   mrb_define_method(mrb, a, "[]",              mrb_ary_aget,         MRB_ARGS_ANY());  /* 15.2.12.5.4  */
   mrb_define_method(mrb, a, "[]=",             mrb_ary_aset,         MRB_ARGS_ANY());  /* 15.2.12.5.5  */
   mrb_define_method(mrb, a, "clear",           mrb_ary_clear,        MRB_ARGS_NONE()); /* 15.2.12.5.6  */
+  mrb_define_iterator(mrb, a, "collect",       mrb_ary_collect,      MRB_ARGS_NONE()); /* 15.3.2.2.3   */
+  mrb_define_iterator(mrb, a, "collect!",      mrb_ary_collect_bang, MRB_ARGS_NONE()); /* 15.2.12.5.7  */
   mrb_define_method(mrb, a, "concat",          mrb_ary_concat_m,     MRB_ARGS_REQ(1)); /* 15.2.12.5.8  */
   mrb_define_method(mrb, a, "delete_at",       mrb_ary_delete_at,    MRB_ARGS_REQ(1)); /* 15.2.12.5.9  */
+  mrb_define_iterator(mrb, a, "detect",        mrb_ary_detect,       MRB_ARGS_OPT(1)); /* 15.3.2.2.4   */
+  mrb_define_iterator(mrb, a, "each",          mrb_ary_each,         MRB_ARGS_NONE()); /* 15.2.12.5.10 */
+  mrb_define_iterator(mrb, a, "each_index",    mrb_ary_each_index,   MRB_ARGS_NONE()); /* 15.2.12.5.11 */
+  mrb_define_iterator(mrb, a, "each_with_index", mrb_ary_each_with_index, MRB_ARGS_NONE()); /* 15.3.2.2.5 */
   mrb_define_method(mrb, a, "empty?",          mrb_ary_empty_p,      MRB_ARGS_NONE()); /* 15.2.12.5.12 */
+  mrb_define_iterator(mrb, a, "find",          mrb_ary_detect,       MRB_ARGS_OPT(1)); /* 15.3.2.2.7   */
+  mrb_define_iterator(mrb, a, "find_all",      mrb_ary_find_all,     MRB_ARGS_NONE()); /* 15.3.2.2.8   */
   mrb_define_method(mrb, a, "first",           mrb_ary_first,        MRB_ARGS_OPT(1)); /* 15.2.12.5.13 */
   mrb_define_method(mrb, a, "index",           mrb_ary_index_m,      MRB_ARGS_REQ(1)); /* 15.2.12.5.14 */
+  mrb_define_iterator(mrb, a, "inject",        mrb_ary_inject,       MRB_ARGS_ANY());  /* 15.3.2.2.11  */
   mrb_define_method(mrb, a, "initialize_copy", mrb_ary_replace_m,    MRB_ARGS_REQ(1)); /* 15.2.12.5.16 */
   mrb_define_method(mrb, a, "join",            mrb_ary_join_m,       MRB_ARGS_ANY());  /* 15.2.12.5.17 */
   mrb_define_method(mrb, a, "last",            mrb_ary_last,         MRB_ARGS_ANY());  /* 15.2.12.5.18 */
   mrb_define_method(mrb, a, "length",          mrb_ary_size,         MRB_ARGS_NONE()); /* 15.2.12.5.19 */
+  mrb_define_iterator(mrb, a, "map",           mrb_ary_collect,      MRB_ARGS_NONE()); /* 15.3.2.2.12  */
   mrb_define_method(mrb, a, "pop",             mrb_ary_pop,          MRB_ARGS_NONE()); /* 15.2.12.5.21 */
   mrb_define_method(mrb, a, "push",            mrb_ary_push_m,       MRB_ARGS_ANY());  /* 15.2.12.5.22 */
+  mrb_define_iterator(mrb, a, "reduce",        mrb_ary_inject,       MRB_ARGS_ANY());
   mrb_define_method(mrb, a, "append",          mrb_ary_push_m,       MRB_ARGS_ANY());
   mrb_define_method(mrb, a, "replace",         mrb_ary_replace_m,    MRB_ARGS_REQ(1)); /* 15.2.12.5.23 */
   mrb_define_method(mrb, a, "reverse",         mrb_ary_reverse,      MRB_ARGS_NONE()); /* 15.2.12.5.24 */
   mrb_define_method(mrb, a, "reverse!",        mrb_ary_reverse_bang, MRB_ARGS_NONE()); /* 15.2.12.5.25 */
   mrb_define_method(mrb, a, "rindex",          mrb_ary_rindex_m,     MRB_ARGS_REQ(1)); /* 15.2.12.5.26 */
+  mrb_define_iterator(mrb, a, "select",        mrb_ary_find_all,     MRB_ARGS_NONE()); /* 15.3.2.2.18  */
   mrb_define_method(mrb, a, "shift",           mrb_ary_shift,        MRB_ARGS_NONE()); /* 15.2.12.5.27 */
   mrb_define_method(mrb, a, "size",            mrb_ary_size,         MRB_ARGS_NONE()); /* 15.2.12.5.28 */
   mrb_define_method(mrb, a, "slice",           mrb_ary_aget,         MRB_ARGS_ANY());  /* 15.2.12.5.29 */
+  mrb_define_method(mrb, a, "sort",            mrb_ary_sort,         MRB_ARGS_NONE()); /* 15.3.2.2.19 */
+  mrb_define_method(mrb, a, "sort!",           mrb_ary_sort_bang,    MRB_ARGS_NONE());
   mrb_define_method(mrb, a, "unshift",         mrb_ary_unshift_m,    MRB_ARGS_ANY());  /* 15.2.12.5.30 */
   mrb_define_method(mrb, a, "prepend",         mrb_ary_unshift_m,    MRB_ARGS_ANY());
 
   mrb_define_method(mrb, a, "__ary_eq",        mrb_ary_eq,           MRB_ARGS_REQ(1));
   mrb_define_method(mrb, a, "__ary_cmp",       mrb_ary_cmp,          MRB_ARGS_REQ(1));
   mrb_define_method(mrb, a, "__ary_index",     mrb_ary_index_m,      MRB_ARGS_REQ(1)); /* kept for mruby-array-ext */
+  mrb_define_method(mrb, a, "__sort_by_keys!", mrb_ary_sort_by_keys, MRB_ARGS_REQ(1)); /* for mruby-enum-ext */
 }
@@ -5,6 +5,7 @@
 */
 
 #include <stdarg.h>
+#include <string.h>
 #include <mruby.h>
 #include <mruby/array.h>
 #include <mruby/class.h>
@@ -430,6 +431,7 @@ mrb_define_method_raw(mrb_state *mrb, struct RClass *c, mrb_sym mid, struct RPro
   if (!h) h = c->mt = kh_init(mt, mrb);
   k = kh_put(mt, mrb, h, mid);
   kh_value(h, k) = p;
+  mrb_method_cache_clear(mrb);
   if (p) {
     p->c = NULL;
     mrb_field_write_barrier(mrb, (struct RBasic *)c, (struct RBasic *)p);
@@ -454,6 +456,19 @@ mrb_define_method(mrb_state *mrb, struct RClass *c, const char *name, mrb_func_t
   mrb_define_method_id(mrb, c, mrb_intern_cstr(mrb, name), func, aspec);
 }
 
+MRB_API void
+mrb_define_iterator(mrb_state *mrb, struct RClass *c, const char *name, mrb_func_t func, mrb_aspec aspec)
+{
+  struct RProc *p;
+  int ai = mrb_gc_arena_save(mrb);
+
+  p = mrb_proc_new_cfunc(mrb, func);
+  p->flags |= MRB_PROC_ITERATOR;
+  p->target_class = c;
+  mrb_define_method_raw(mrb, c, mrb_intern_cstr(mrb, name), p);
+  mrb_gc_arena_restore(mrb, ai);
+}
+
 /* a function to raise NotImplementedError with current method name */
 MRB_API void
 mrb_notimplement(mrb_state *mrb)
@@ -1007,6 +1022,8 @@ include_module_at(mrb_state *mrb, struct RClass *c, struct RClass *ins_pos, stru
     ic = include_class_new(mrb, m, ins_pos->super);
     ins_pos->super = ic;
     mrb_field_write_barrier(mrb, (struct RBasic*)ins_pos, (struct RBasic*)ins_pos->super);
+    mrb_method_cache_clear(mrb);
+    mrb->const_serial++;
     ins_pos = ic;
   skip:
     m = m->super;
@@ -1038,6 +1055,7 @@ mrb_prepend_module(mrb_state *mrb, struct RClass *c, struct RClass *m)
     c->mt = kh_init(mt, mrb);
     mrb_field_write_barrier(mrb, (struct RBasic*)c, (struct RBasic*)origin);
     c->flags |= MRB_FLAG_IS_PREPENDED;
+    mrb_method_cache_clear(mrb);
   }
   changed = include_module_at(mrb, c, c, m, 0);
   if (changed < 0) {
@@ -1263,12 +1281,51 @@ mrb_define_module_function(mrb_state *mrb, struct RClass *c, const char *name, m
   mrb_define_method(mrb, c, name, func, aspec);
 }
 
+void
+mrb_method_cache_clear(mrb_state *mrb)
+{
+#ifndef MRB_NO_METHOD_CACHE
+  /* entries of older serials become stale; 64 bits never wrap around */
+  mrb->method_serial++;
+#endif
+}
+
+/* called when class c is freed: a class allocated later at the same
+   address must not hit entries filled for c */
+void
+mrb_method_cache_forget(mrb_state *mrb, struct RClass *c)
+{
+#ifndef MRB_NO_METHOD_CACHE
+  int i;
+
+  if (c->flags & MRB_FLAG_IN_METHOD_CACHE) {
+    for (i=0; i<MRB_METHOD_CACHE_SIZE; i++) {
+      if (mrb->cache[i].c == c) mrb->cache[i].c = NULL;
+    }
+  }
+  if (c->flags & MRB_FLAG_IN_CALL_CACHE) {
+    /* inline caches are spread over ireps */
+    mrb_method_cache_clear(mrb);
+  }
+#endif
+}
+
 MRB_API struct RProc*
 mrb_method_search_vm(mrb_state *mrb, struct RClass **cp, mrb_sym mid)
 {
   khiter_t k;
-  struct RProc *m;
+  struct RProc *m = NULL;
   struct RClass *c = *cp;
+#ifndef MRB_NO_METHOD_CACHE
+  struct RClass *oc = c;
+  int h0 = (((uintptr_t)oc >> 3) ^ mid) & (MRB_METHOD_CACHE_SIZE-1);
+  struct mrb_cache_entry *mc = &mrb->cache[h0];
+
+  if (mc->c == oc && mc->mid == mid && mc->serial == mrb->method_serial) {
+    if (mc->m) *cp = mc->c0;
+    return mc->m;
+  }
+#endif
 
   while (c) {
     khash_t(mt) *h = c->mt;
@@ -1279,12 +1336,21 @@ mrb_method_search_vm(mrb_state *mrb, struct RClass **cp, mrb_sym mid)
         m = kh_value(h, k);
         if (!m) break;
         *cp = c;
-        return m;
+        break;
       }
     }
     c = c->super;
   }
-  return NULL;                  /* no method */
+#ifndef MRB_NO_METHOD_CACHE
+  /* misses are cached too, method_missing and respond_to? ask repeatedly */
+  mc->c = oc;
+  mc->c0 = m ? c : NULL;
+  mc->mid = mid;
+  mc->m = m;
+  mc->serial = mrb->method_serial;
+  oc->flags |= MRB_FLAG_IN_METHOD_CACHE;
+#endif
+  return m;                     /* NULL if no method */
 }
 
 MRB_API struct RProc*
@@ -2080,6 +2146,7 @@ remove_method(mrb_state *mrb, mrb_value mod, mrb_sym mid)
     k = kh_get(mt, mrb, h, mid);
     if (k != kh_end(h)) {
       kh_del(mt, mrb, h, k);
+      mrb_method_cache_clear(mrb);
       mrb_funcall(mrb, mod, "method_removed", 1, mrb_symbol_value(mid));
       return;
     }
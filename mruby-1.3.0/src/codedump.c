@@ -27,6 +27,7 @@ print_r(mrb_state *mrb, mrb_irep *irep, size_t n, int pre)
 #define RA  1
 #define RB  2
 #define RAB 3
+#define RC  4
 
 static void
 print_lv(mrb_state *mrb, mrb_irep *irep, mrb_code c, int r)
@@ -35,7 +36,8 @@ print_lv(mrb_state *mrb, mrb_irep *irep, mrb_code c, int r)
 
   if (!irep->lv
       || ((!(r & RA) || GETARG_A(c) >= irep->nlocals)
-       && (!(r & RB) || GETARG_B(c) >= irep->nlocals))) {
+       && (!(r & RB) || GETARG_B(c) >= irep->nlocals)
+       && (!(r & RC) || GETARG_C(c) >= irep->nlocals))) {
     printf("\n");
     return;
   }
@@ -44,7 +46,10 @@ print_lv(mrb_state *mrb, mrb_irep *irep, mrb_code c, int r)
     pre = print_r(mrb, irep, GETARG_A(c), 0);
   }
   if (r & RB) {
-    print_r(mrb, irep, GETARG_B(c), pre);
+    pre |= print_r(mrb, irep, GETARG_B(c), pre);
+  }
+  if (r & RC) {
+    print_r(mrb, irep, GETARG_C(c), pre);
   }
   printf("\n");
 }
@@ -81,7 +86,7 @@ codedump(mrb_state *mrb, mrb_irep *irep)
     }
 
     printf("%03d ", i);
-    c = irep->iseq[i];
+    c = mrb_insn_generic(irep->iseq[i]);
     switch (GET_OPCODE(c)) {
     case OP_NOP:
       printf("OP_NOP\n");
@@ -90,6 +95,10 @@ codedump(mrb_state *mrb, mrb_irep *irep)
       printf("OP_MOVE\tR%d\tR%d\t", GETARG_A(c), GETARG_B(c));
       print_lv(mrb, irep, c, RAB);
       break;
+    case OP_MOVE2:
+      printf("OP_MOVE2\tR%d\tR%d\tR%d\t", GETARG_A(c), GETARG_B(c), GETARG_C(c));
+      print_lv(mrb, irep, c, RAB|RC);
+      break;
     case OP_LOADL:
       {
         mrb_value v = irep->pool[GETARG_Bx(c)];
@@ -335,6 +344,56 @@ codedump(mrb_state *mrb, mrb_irep *irep)
              mrb_sym2name(mrb, irep->syms[GETARG_B(c)]),
              GETARG_C(c));
       break;
+    case OP_EQI:
+      printf("OP_EQI\tR%d\t:%s\t%d\n", GETARG_A(c),
+             mrb_sym2name(mrb, irep->syms[GETARG_B(c)]),
+             GETARG_C(c));
+      break;
+    case OP_LTI:
+      printf("OP_LTI\tR%d\t:%s\t%d\n", GETARG_A(c),
+             mrb_sym2name(mrb, irep->syms[GETARG_B(c)]),
+             GETARG_C(c));
+      break;
+    case OP_LEI:
+      printf("OP_LEI\tR%d\t:%s\t%d\n", GETARG_A(c),
+             mrb_sym2name(mrb, irep->syms[GETARG_B(c)]),
+             GETARG_C(c));
+      break;
+    case OP_GTI:
+      printf("OP_GTI\tR%d\t:%s\t%d\n", GETARG_A(c),
+             mrb_sym2name(mrb, irep->syms[GETARG_B(c)]),
+             GETARG_C(c));
+      break;
+    case OP_GEI:
+      printf("OP_GEI\tR%d\t:%s\t%d\n", GETARG_A(c),
+             mrb_sym2name(mrb, irep->syms[GETARG_B(c)]),
+             GETARG_C(c));
+      break;
+    case OP_EQJ:
+      printf("OP_EQJ\tR%d\t:%s\t%d\n", GETARG_A(c),
+             mrb_sym2name(mrb, irep->syms[GETARG_B(c)]),
+             GETARG_C(c));
+      break;
+    case OP_LTJ:
+      printf("OP_LTJ\tR%d\t:%s\t%d\n", GETARG_A(c),
+             mrb_sym2name(mrb, irep->syms[GETARG_B(c)]),
+             GETARG_C(c));
+      break;
+    case OP_LEJ:
+      printf("OP_LEJ\tR%d\t:%s\t%d\n", GETARG_A(c),
+             mrb_sym2name(mrb, irep->syms[GETARG_B(c)]),
+             GETARG_C(c));
+      break;
+    case OP_GTJ:
+      printf("OP_GTJ\tR%d\t:%s\t%d\n", GETARG_A(c),
+             mrb_sym2name(mrb, irep->syms[GETARG_B(c)]),
+             GETARG_C(c));
+      break;
+    case OP_GEJ:
+      printf("OP_GEJ\tR%d\t:%s\t%d\n", GETARG_A(c),
+             mrb_sym2name(mrb, irep->syms[GETARG_B(c)]),
+             GETARG_C(c));
+      break;
 
     case OP_STOP:
       printf("OP_STOP\n");
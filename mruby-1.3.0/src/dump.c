@@ -87,20 +87,24 @@ write_iseq_block(mrb_state *mrb, mrb_irep *irep, uint8_t *buf, uint8_t flags)
   case DUMP_ENDIAN_BIG:
     if (bigendian_p()) goto native;
     for (iseq_no = 0; iseq_no < irep->ilen; iseq_no++) {
-      cur += uint32_to_bin(irep->iseq[iseq_no], cur); /* opcode */
+      cur += uint32_to_bin(mrb_insn_generic(irep->iseq[iseq_no]), cur); /* opcode */
     }
     break;
   case DUMP_ENDIAN_LIL:
     if (!bigendian_p()) goto native;
     for (iseq_no = 0; iseq_no < irep->ilen; iseq_no++) {
-      cur += uint32l_to_bin(irep->iseq[iseq_no], cur); /* opcode */
+      cur += uint32l_to_bin(mrb_insn_generic(irep->iseq[iseq_no]), cur); /* opcode */
     }
     break;
 
   native:
   case DUMP_ENDIAN_NAT:
-    memcpy(cur, irep->iseq, irep->ilen * sizeof(mrb_code));
-    cur += irep->ilen * sizeof(mrb_code);
+    for (iseq_no = 0; iseq_no < irep->ilen; iseq_no++) {
+      mrb_code c = mrb_insn_generic(irep->iseq[iseq_no]); /* opcode */
+
+      memcpy(cur, &c, sizeof(mrb_code));
+      cur += sizeof(mrb_code);
+    }
     break;
   }
 
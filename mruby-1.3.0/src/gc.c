@@ -747,10 +747,16 @@ obj_free(mrb_state *mrb, struct RBasic *obj, int end)
   case MRB_TT_SCLASS:
     mrb_gc_free_mt(mrb, (struct RClass*)obj);
     mrb_gc_free_iv(mrb, (struct RObject*)obj);
+    /* a new class may be allocated at the same address */
+    mrb_method_cache_forget(mrb, (struct RClass*)obj);
+    if (MRB_FLAG_TEST(obj, MRB_FLAG_IN_CONST_CACHE))
+      mrb->const_serial++;
     break;
   case MRB_TT_ICLASS:
     if (MRB_FLAG_TEST(obj, MRB_FLAG_IS_ORIGIN))
       mrb_gc_free_mt(mrb, (struct RClass*)obj);
+    /* searches of super start from iclasses */
+    mrb_method_cache_forget(mrb, (struct RClass*)obj);
     break;
   case MRB_TT_ENV:
     {
@@ -769,17 +775,19 @@ obj_free(mrb_state *mrb, struct RBasic *obj, int end)
     {
       struct mrb_context *c = ((struct RFiber*)obj)->cxt;
 
-      if (!end && c && c != mrb->root_c) {
-        mrb_callinfo *ci = c->ci;
-        mrb_callinfo *ce = c->cibase;
-
-        while (ce <= ci) {
-          struct REnv *e = ci->env;
-          if (e && !is_dead(&mrb->gc, e) &&
-              e->tt == MRB_TT_ENV && MRB_ENV_STACK_SHARED_P(e)) {
-            mrb_env_unshare(mrb, e);
+      if (c && c != mrb->root_c) {
+        if (!end) {
+          mrb_callinfo *ci = c->ci;
+          mrb_callinfo *ce = c->cibase;
+
+          while (ce <= ci) {
+            struct REnv *e = ci->env;
+            if (e && !is_dead(&mrb->gc, e) &&
+                e->tt == MRB_TT_ENV && MRB_ENV_STACK_SHARED_P(e)) {
+              mrb_env_unshare(mrb, e);
+            }
+            ci--;
           }
-          ci--;
         }
         mrb_free_context(mrb, c);
       }
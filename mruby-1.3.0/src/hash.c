@@ -9,6 +9,7 @@
 #include <mruby/class.h>
 #include <mruby/hash.h>
 #include <mruby/khash.h>
+#include <mruby/proc.h>
 #include <mruby/string.h>
 #include <mruby/variable.h>
 
@@ -881,6 +882,177 @@ mrb_hash_has_value(mrb_state *mrb, mrb_value hash)
   return mrb_false_value();
 }
 
+/*
+ * Iterators of Hash.  Like the Ruby versions they replace, they iterate
+ * over the entries the hash had when called, so the block may change the
+ * hash; keys and values are copied in one pass into a single array.  The
+ * Ruby versions are kept as __each etc. and run inside fibers.
+ */
+
+mrb_bool mrb_iter_fallback(mrb_state *mrb, mrb_value self, const char *rname, mrb_value *vp);
+
+enum hash_iter_type {
+  HASH_ITER_EACH,
+  HASH_ITER_EACH_KEY,
+  HASH_ITER_EACH_VALUE,
+  HASH_ITER_SELECT,
+  HASH_ITER_REJECT
+};
+
+/* [key0, value0, key1, value1, ...] in insertion order */
+static mrb_value
+hash_iter_entries(mrb_state *mrb, mrb_value hash)
+{
+  khash_t(ht) *h = RHASH_TBL(hash);
+  khiter_t k;
+  mrb_int len, n;
+  mrb_value ary;
+  mrb_value *p;
+
+  if (!h || kh_size(h) == 0) return mrb_ary_new(mrb);
+  len = kh_size(h);
+  ary = mrb_ary_new_capa(mrb, len*2);
+  mrb_ary_set(mrb, ary, len*2-1, mrb_nil_value());
+  p = mrb_ary_ptr(ary)->ptr;
+  for (k = kh_begin(h); k != kh_end(h); k++) {
+    if (kh_exist(h, k)) {
+      n = kh_value(h, k).n;
+      if (n < len) {
+        p[n*2] = kh_key(h, k);
+        p[n*2+1] = kh_value(h, k).v;
+      }
+    }
+  }
+  return ary;
+}
+
+static mrb_value
+hash_iterate(mrb_state *mrb, mrb_value hash, const char *name, const char *rname,
+             enum hash_iter_type type)
+{
+  mrb_value blk, ent, result, v, kv[2];
+  mrb_yieldinfo y;
+  mrb_int i;
+  int ai;
+
+  if (mrb_iter_fallback(mrb, hash, rname, &v)) {
+    return v;
+  }
+  mrb_get_args(mrb, "&", &blk);
+  if (mrb_nil_p(blk)) {
+    return mrb_funcall(mrb, hash, "to_enum", 1, mrb_symbol_value(mrb_intern_cstr(mrb, name)));
+  }
+  result = hash;
+  if (type == HASH_ITER_SELECT || type == HASH_ITER_REJECT) {
+    result = mrb_hash_new(mrb);
+  }
+  ent = hash_iter_entries(mrb, hash);
+  ai = mrb_gc_arena_save(mrb);
+  if (type == HASH_ITER_EACH_KEY || type == HASH_ITER_EACH_VALUE ||
+      !mrb_proc_spread_p(mrb_proc_ptr(blk))) {
+    mrb_yield_prepare(mrb, &y, blk, 1);
+  }
+  else {
+    /* |key, value| takes them without the [key, value] pair */
+    mrb_yield_prepare(mrb, &y, blk, 2);
+  }
+  for (i = 0; i < RARRAY_LEN(ent); i += 2) {
+    kv[0] = RARRAY_PTR(ent)[i];
+    kv[1] = RARRAY_PTR(ent)[i+1];
+    switch (type) {
+    case HASH_ITER_EACH_KEY:
+      v = mrb_yield_fast(mrb, &y, &kv[0]);
+      break;
+    case HASH_ITER_EACH_VALUE:
+      v = mrb_yield_fast(mrb, &y, &kv[1]);
+      break;
+    default:
+      if (y.argc == 2) {
+        v = mrb_yield_fast(mrb, &y, kv);
+      }
+      else {
+        v = mrb_assoc_new(mrb, kv[0], kv[1]);
+        v = mrb_yield_fast(mrb, &y, &v);
+      }
+      if (type == HASH_ITER_SELECT ? mrb_test(v) :
+          type == HASH_ITER_REJECT ? !mrb_test(v) : FALSE) {
+        mrb_hash_set(mrb, result, kv[0], kv[1]);
+      }
+      break;
+    }
+    mrb_gc_arena_restore(mrb, ai);
+  }
+  return result;
+}
+
+/* 15.2.13.4.9 */
+/*
+ *  call-seq:
+ *     hsh.each      {| key, value | block } -> hsh
+ *     hsh.each_pair {| key, value | block } -> hsh
+ *     hsh.each                              -> an_enumerator
+ *
+ *  Calls <i>block</i> once for each key in <i>hsh</i>, passing the key
+ *  and value as parameters.
+ */
+static mrb_value
+mrb_hash_each(mrb_state *mrb, mrb_value hash)
+{
+  return hash_iterate(mrb, hash, "each", "__each", HASH_ITER_EACH);
+}
+
+/* 15.2.13.4.10 */
+/*
+ *  call-seq:
+ *     hsh.each_key {| key | block } -> hsh
+ *
+ *  Calls <i>block</i> once for each key in <i>hsh</i>.
+ */
+static mrb_value
+mrb_hash_each_key(mrb_state *mrb, mrb_value hash)
+{
+  return hash_iterate(mrb, hash, "each_key", "__each_key", HASH_ITER_EACH_KEY);
+}
+
+/* 15.2.13.4.11 */
+/*
+ *  call-seq:
+ *     hsh.each_value {| value | block } -> hsh
+ *
+ *  Calls <i>block</i> once for each value in <i>hsh</i>.
+ */
+static mrb_value
+mrb_hash_each_value(mrb_state *mrb, mrb_value hash)
+{
+  return hash_iterate(mrb, hash, "each_value", "__each_value", HASH_ITER_EACH_VALUE);
+}
+
+/*
+ *  call-seq:
+ *     hsh.select {|key, value| block}   -> a_hash
+ *
+ *  Returns a new hash consisting of entries for which the block returns
+ *  true.
+ */
+static mrb_value
+mrb_hash_select(mrb_state *mrb, mrb_value hash)
+{
+  return hash_iterate(mrb, hash, "select", "__select", HASH_ITER_SELECT);
+}
+
+/*
+ *  call-seq:
+ *     hsh.reject {|key, value| block}   -> a_hash
+ *
+ *  Returns a new hash consisting of entries for which the block returns
+ *  false.
+ */
+static mrb_value
+mrb_hash_reject(mrb_state *mrb, mrb_value hash)
+{
+  return hash_iterate(mrb, hash, "reject", "__reject", HASH_ITER_REJECT);
+}
+
 void
 mrb_init_hash(mrb_state *mrb)
 {
@@ -897,6 +1069,9 @@ mrb_init_hash(mrb_state *mrb)
   mrb_define_method(mrb, h, "default_proc",    mrb_hash_default_proc,MRB_ARGS_NONE()); /* 15.2.13.4.7  */
   mrb_define_method(mrb, h, "default_proc=",   mrb_hash_set_default_proc,MRB_ARGS_REQ(1)); /* 15.2.13.4.7  */
   mrb_define_method(mrb, h, "__delete",        mrb_hash_delete,      MRB_ARGS_REQ(1)); /* core of 15.2.13.4.8  */
+  mrb_define_iterator(mrb, h, "each",          mrb_hash_each,        MRB_ARGS_NONE()); /* 15.2.13.4.9  */
+  mrb_define_iterator(mrb, h, "each_key",      mrb_hash_each_key,    MRB_ARGS_NONE()); /* 15.2.13.4.10 */
+  mrb_define_iterator(mrb, h, "each_value",    mrb_hash_each_value,  MRB_ARGS_NONE()); /* 15.2.13.4.11 */
   mrb_define_method(mrb, h, "empty?",          mrb_hash_empty_p,     MRB_ARGS_NONE()); /* 15.2.13.4.12 */
   mrb_define_method(mrb, h, "has_key?",        mrb_hash_has_key,     MRB_ARGS_REQ(1)); /* 15.2.13.4.13 */
   mrb_define_method(mrb, h, "has_value?",      mrb_hash_has_value,   MRB_ARGS_REQ(1)); /* 15.2.13.4.14 */
@@ -906,6 +1081,8 @@ mrb_init_hash(mrb_state *mrb)
   mrb_define_method(mrb, h, "keys",            mrb_hash_keys,        MRB_ARGS_NONE()); /* 15.2.13.4.19 */
   mrb_define_method(mrb, h, "length",          mrb_hash_size_m,      MRB_ARGS_NONE()); /* 15.2.13.4.20 */
   mrb_define_method(mrb, h, "member?",         mrb_hash_has_key,     MRB_ARGS_REQ(1)); /* 15.2.13.4.21 */
+  mrb_define_iterator(mrb, h, "reject",        mrb_hash_reject,      MRB_ARGS_NONE());
+  mrb_define_iterator(mrb, h, "select",        mrb_hash_select,      MRB_ARGS_NONE());
   mrb_define_method(mrb, h, "shift",           mrb_hash_shift,       MRB_ARGS_NONE()); /* 15.2.13.4.24 */
   mrb_define_method(mrb, h, "dup",             mrb_hash_dup,         MRB_ARGS_NONE());
   mrb_define_method(mrb, h, "size",            mrb_hash_size_m,      MRB_ARGS_NONE()); /* 15.2.13.4.25 */
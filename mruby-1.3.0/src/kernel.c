@@ -251,6 +251,7 @@ copy_class(mrb_state *mrb, mrb_value dst, mrb_value src)
   }
   dc->super = sc->super;
   MRB_SET_INSTANCE_TT(dc, MRB_INSTANCE_TT(sc));
+  mrb_method_cache_clear(mrb);
 }
 
 static void
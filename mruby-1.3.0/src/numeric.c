@@ -1289,11 +1289,236 @@ flo_plus(mrb_state *mrb, mrb_value x)
   return mrb_float_value(mrb, mrb_float(x) + mrb_to_flo(mrb, y));
 }
 
+/*
+ * Iterators of Integral.  Loops over Fixnums run in C; other receivers
+ * and limits (Floats, objects with comparison methods) follow the
+ * generic path, with the same semantics as the Ruby versions they
+ * replace.  The Ruby versions are kept as __times etc. and run instead
+ * inside fibers, where a block called from C could not Fiber.yield.
+ */
+
+mrb_bool mrb_iter_fallback(mrb_state *mrb, mrb_value self, const char *rname, mrb_value *vp);
+
+static mrb_value
+iter_add(mrb_state *mrb, mrb_value x, mrb_value y)
+{
+  if (mrb_fixnum_p(x) && (mrb_fixnum_p(y) || mrb_float_p(y))) {
+    return mrb_fixnum_plus(mrb, x, y);
+  }
+  if (mrb_float_p(x) && (mrb_fixnum_p(y) || mrb_float_p(y))) {
+    return mrb_float_value(mrb, mrb_float(x) + mrb_to_flo(mrb, y));
+  }
+  return mrb_funcall(mrb, x, "+", 1, y);
+}
+
+/* x op y for op "<", "<=" or ">=" */
+static mrb_bool
+iter_cmp(mrb_state *mrb, mrb_value x, const char *op, mrb_value y)
+{
+  if ((mrb_fixnum_p(x) || mrb_float_p(x)) && (mrb_fixnum_p(y) || mrb_float_p(y))) {
+    if (mrb_fixnum_p(x) && mrb_fixnum_p(y)) {
+      mrb_int a = mrb_fixnum(x), b = mrb_fixnum(y);
+
+      switch (op[0]) {
+      case '<': return op[1] ? a <= b : a < b;
+      default:  return a >= b;
+      }
+    }
+    else {
+      mrb_float a = mrb_to_flo(mrb, x), b = mrb_to_flo(mrb, y);
+
+      switch (op[0]) {
+      case '<': return op[1] ? a <= b : a < b;
+      default:  return a >= b;
+      }
+    }
+  }
+  return mrb_test(mrb_funcall(mrb, x, op, 1, y));
+}
+
+/* 15.2.8.3.22 */
+/*
+ *  call-seq:
+ *     int.times {|i| block }  ->  int
+ *
+ *  Calls the given block +int+ times, passing values from zero
+ *  to <code>int - 1</code>.
+ */
+static mrb_value
+int_times(mrb_state *mrb, mrb_value self)
+{
+  mrb_value blk, v;
+  mrb_yieldinfo y;
+  int ai;
+
+  if (mrb_iter_fallback(mrb, self, "__times", &v)) {
+    return v;
+  }
+  mrb_get_args(mrb, "&", &blk);
+  if (mrb_nil_p(blk)) {
+    return mrb_funcall(mrb, self, "to_enum", 1, mrb_symbol_value(mrb_intern_lit(mrb, "times")));
+  }
+  ai = mrb_gc_arena_save(mrb);
+  mrb_yield_prepare(mrb, &y, blk, 1);
+  if (mrb_fixnum_p(self)) {
+    mrb_int i, n = mrb_fixnum(self);
+
+    for (i = 0; i < n; i++) {
+      v = mrb_fixnum_value(i);
+      mrb_yield_fast(mrb, &y, &v);
+      mrb_gc_arena_restore(mrb, ai);
+    }
+  }
+  else {
+    mrb_value i = mrb_fixnum_value(0);
+
+    while (iter_cmp(mrb, i, "<", self)) {
+      mrb_yield_fast(mrb, &y, &i);
+      mrb_gc_arena_restore(mrb, ai);
+      i = iter_add(mrb, i, mrb_fixnum_value(1));
+    }
+  }
+  return self;
+}
+
+static mrb_value
+int_upto_downto(mrb_state *mrb, mrb_value self, mrb_bool up)
+{
+  mrb_value num, blk, i, v;
+  mrb_yieldinfo y;
+  int ai;
+
+  mrb_get_args(mrb, "o&", &num, &blk);
+  if (mrb_nil_p(blk)) {
+    return mrb_funcall(mrb, self, "to_enum", 2, mrb_symbol_value(mrb_intern_cstr(mrb, up ? "upto" : "downto")), num);
+  }
+  i = mrb_fixnum_p(self) ? self : mrb_funcall(mrb, self, "to_i", 0);
+  ai = mrb_gc_arena_save(mrb);
+  mrb_yield_prepare(mrb, &y, blk, 1);
+  if (mrb_fixnum_p(i) && mrb_fixnum_p(num)) {
+    mrb_int n = mrb_fixnum(i), lim = mrb_fixnum(num);
+
+    if (up ? n > lim : n < lim) return self;
+    for (;;) {
+      v = mrb_fixnum_value(n);
+      mrb_yield_fast(mrb, &y, &v);
+      mrb_gc_arena_restore(mrb, ai);
+      if (n == lim) break;
+      n += up ? 1 : -1;
+    }
+  }
+  else {
+    mrb_value d = mrb_fixnum_value(up ? 1 : -1);
+
+    while (iter_cmp(mrb, i, up ? "<=" : ">=", num)) {
+      mrb_yield_fast(mrb, &y, &i);
+      mrb_gc_arena_restore(mrb, ai);
+      i = iter_add(mrb, i, d);
+    }
+  }
+  return self;
+}
+
+/* 15.2.8.3.27 */
+/*
+ *  call-seq:
+ *     int.upto(limit) {|i| block }  ->  int
+ *
+ *  Iterates the given block, passing in integer values from +int+
+ *  up to and including +limit+.
+ */
+static mrb_value
+int_upto(mrb_state *mrb, mrb_value self)
+{
+  mrb_value v;
+
+  if (mrb_iter_fallback(mrb, self, "__upto", &v)) {
+    return v;
+  }
+  return int_upto_downto(mrb, self, TRUE);
+}
+
+/* 15.2.8.3.15 */
+/*
+ *  call-seq:
+ *     int.downto(limit) {|i| block }  ->  int
+ *
+ *  Iterates the given block, passing decreasing values from +int+
+ *  down to and including +limit+.
+ */
+static mrb_value
+int_downto(mrb_state *mrb, mrb_value self)
+{
+  mrb_value v;
+
+  if (mrb_iter_fallback(mrb, self, "__downto", &v)) {
+    return v;
+  }
+  return int_upto_downto(mrb, self, FALSE);
+}
+
+/*
+ *  call-seq:
+ *     num.step(limit=nil, step=1) {|i| block }  ->  num
+ *
+ *  Calls the given block from +num+ to +limit+ incremented by
+ *  +step+.  Without +limit+ the loop does not end.
+ */
+static mrb_value
+int_step(mrb_state *mrb, mrb_value self)
+{
+  mrb_value num = mrb_nil_value(), step = mrb_fixnum_value(1), blk, i, v;
+  mrb_yieldinfo y;
+  int ai;
+
+  if (mrb_iter_fallback(mrb, self, "__step", &v)) {
+    return v;
+  }
+  mrb_get_args(mrb, "|oo&", &num, &step, &blk);
+  if (mrb_fixnum_p(step) ? mrb_fixnum(step) == 0 : mrb_equal(mrb, step, mrb_fixnum_value(0))) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "step can't be 0");
+  }
+  if (mrb_nil_p(blk)) {
+    return mrb_funcall(mrb, self, "to_enum", 3, mrb_symbol_value(mrb_intern_lit(mrb, "step")), num, step);
+  }
+
+  i = mrb_float_p(num) ? mrb_float_value(mrb, mrb_to_flo(mrb, self)) : self;
+  ai = mrb_gc_arena_save(mrb);
+  mrb_yield_prepare(mrb, &y, blk, 1);
+  if (mrb_fixnum_p(i) && mrb_fixnum_p(num) && mrb_fixnum_p(step)) {
+    mrb_int n = mrb_fixnum(i), lim = mrb_fixnum(num), d = mrb_fixnum(step);
+
+    while (d > 0 ? n <= lim : n >= lim) {
+      v = mrb_fixnum_value(n);
+      mrb_yield_fast(mrb, &y, &v);
+      mrb_gc_arena_restore(mrb, ai);
+      if (mrb_int_add_overflow(n, d, &n)) break;
+    }
+  }
+  else if (mrb_nil_p(num)) {
+    for (;;) {
+      mrb_yield_fast(mrb, &y, &i);
+      mrb_gc_arena_restore(mrb, ai);
+      i = iter_add(mrb, i, step);
+    }
+  }
+  else {
+    const char *op = iter_cmp(mrb, step, ">=", mrb_fixnum_value(0)) ? "<=" : ">=";
+
+    while (iter_cmp(mrb, i, op, num)) {
+      mrb_yield_fast(mrb, &y, &i);
+      mrb_gc_arena_restore(mrb, ai);
+      i = iter_add(mrb, i, step);
+    }
+  }
+  return self;
+}
+
 /* ------------------------------------------------------------------------*/
 void
 mrb_init_numeric(mrb_state *mrb)
 {
-  struct RClass *numeric, *integer, *fixnum, *fl;
+  struct RClass *numeric, *integral, *integer, *fixnum, *fl;
 
   /* Numeric Class */
   numeric = mrb_define_class(mrb, "Numeric",  mrb->object_class);                /* 15.2.7 */
@@ -1303,6 +1528,13 @@ mrb_init_numeric(mrb_state *mrb)
   mrb_define_method(mrb, numeric, "quo",      num_div,         MRB_ARGS_REQ(1)); /* 15.2.7.4.5 (x) */
   mrb_define_method(mrb, numeric, "<=>",      num_cmp,         MRB_ARGS_REQ(1)); /* 15.2.9.3.6  */
 
+  /* Integral Module */
+  integral = mrb_define_module(mrb, "Integral");
+  mrb_define_iterator(mrb, integral, "downto",  int_downto,      MRB_ARGS_REQ(1)); /* 15.2.8.3.15 */
+  mrb_define_iterator(mrb, integral, "times",   int_times,       MRB_ARGS_NONE()); /* 15.2.8.3.22 */
+  mrb_define_iterator(mrb, integral, "upto",    int_upto,        MRB_ARGS_REQ(1)); /* 15.2.8.3.27 */
+  mrb_define_iterator(mrb, integral, "step",    int_step,        MRB_ARGS_OPT(2));
+
   /* Integer Class */
   integer = mrb_define_class(mrb, "Integer",  numeric);                          /* 15.2.8 */
   MRB_SET_INSTANCE_TT(integer, MRB_TT_FIXNUM);
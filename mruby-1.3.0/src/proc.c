@@ -48,18 +48,33 @@ env_new(mrb_state *mrb, int nlocals)
   return e;
 }
 
+void
+mrb_env_escape(mrb_state *mrb, struct REnv *e)
+{
+  while (e) {
+    e->flags &= ~MRB_ENV_NOESCAPE;
+    e = (struct REnv*)e->c;
+  }
+}
+
 static void
-closure_setup(mrb_state *mrb, struct RProc *p, int nlocals)
+closure_setup(mrb_state *mrb, struct RProc *p, int nlocals, mrb_bool noescape)
 {
   struct REnv *e;
 
   if (!mrb->c->ci->env) {
     e = env_new(mrb, nlocals);
+    if (noescape) {
+      e->flags |= MRB_ENV_NOESCAPE;
+    }
     mrb->c->ci->env = e;
   }
   else {
     e = mrb->c->ci->env;
   }
+  if (!noescape) {
+    mrb_env_escape(mrb, e);
+  }
   p->env = e;
   mrb_field_write_barrier(mrb, (struct RBasic *)p, (struct RBasic *)p->env);
 }
@@ -69,7 +84,18 @@ mrb_closure_new(mrb_state *mrb, mrb_irep *irep)
 {
   struct RProc *p = mrb_proc_new(mrb, irep);
 
-  closure_setup(mrb, p, mrb->c->ci->proc->body.irep->nlocals);
+  closure_setup(mrb, p, mrb->c->ci->proc->body.irep->nlocals, FALSE);
+  return p;
+}
+
+/* block passed straight to a call; the env stays MRB_ENV_NOESCAPE while
+   the callee is an iterator */
+struct RProc *
+mrb_closure_new_noescape(mrb_state *mrb, mrb_irep *irep)
+{
+  struct RProc *p = mrb_proc_new(mrb, irep);
+
+  closure_setup(mrb, p, mrb->c->ci->proc->body.irep->nlocals, TRUE);
   return p;
 }
 
@@ -94,6 +120,7 @@ mrb_proc_new_cfunc_with_env(mrb_state *mrb, mrb_func_t func, mrb_int argc, const
   int i;
 
   p->env = e = env_new(mrb, argc);
+  mrb_env_escape(mrb, (struct REnv*)e->c);
   mrb_field_write_barrier(mrb, (struct RBasic *)p, (struct RBasic *)p->env);
   MRB_ENV_UNSHARE_STACK(e);
   e->stack = (mrb_value*)mrb_malloc(mrb, sizeof(mrb_value) * argc);
@@ -192,6 +219,26 @@ mrb_proc_call_cfunc(mrb_state *mrb, struct RProc *p, mrb_value self)
   return (p->body.func)(mrb, self);
 }
 
+/* TRUE if the block spreads a single Array argument over its parameters
+   (|k, v|), i.e. yielding [a, b] to it is the same as yielding a, b */
+mrb_bool
+mrb_proc_spread_p(struct RProc *p)
+{
+  mrb_code *iseq;
+  mrb_aspec aspec;
+
+  if (MRB_PROC_CFUNC_P(p) || MRB_PROC_STRICT_P(p) || !p->body.irep) {
+    return FALSE;
+  }
+  iseq = p->body.irep->iseq;
+  if (p->body.irep->ilen == 0 || GET_OPCODE(*iseq) != OP_ENTER) {
+    return FALSE;
+  }
+  aspec = GETARG_Ax(*iseq);
+  return MRB_ASPEC_REQ(aspec) + MRB_ASPEC_OPT(aspec) +
+    MRB_ASPEC_REST(aspec) + MRB_ASPEC_POST(aspec) > 1;
+}
+
 /* 15.2.17.4.2 */
 static mrb_value
 mrb_proc_arity(mrb_state *mrb, mrb_value self)
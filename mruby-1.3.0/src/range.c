@@ -9,6 +9,7 @@
 #include <mruby/range.h>
 #include <mruby/string.h>
 #include <mruby/array.h>
+#include <mruby/proc.h>
 
 #define RANGE_CLASS (mrb_class_get(mrb, "Range"))
 
@@ -388,6 +389,106 @@ range_initialize_copy(mrb_state *mrb, mrb_value copy)
   return copy;
 }
 
+mrb_bool mrb_iter_fallback(mrb_state *mrb, mrb_value self, const char *rname, mrb_value *vp);
+
+static mrb_int
+range_each_cmp(mrb_state *mrb, mrb_value a, mrb_value b)
+{
+  mrb_value c = mrb_funcall(mrb, a, "<=>", 1, b);
+
+  if (!mrb_fixnum_p(c)) {
+    mrb_raise(mrb, E_TYPE_ERROR, "can't iterate");
+  }
+  return mrb_fixnum(c);
+}
+
+/* 15.2.14.4.4 */
+/*
+ *  call-seq:
+ *     rng.each {| i | block } -> rng
+ *
+ *  Iterates over the elements of +rng+, passing each in turn to the
+ *  block.  Fixnum ranges loop in C; inside fibers the Ruby version
+ *  (__each) runs, so the block may Fiber.yield.
+ */
+static mrb_value
+range_each(mrb_state *mrb, mrb_value range)
+{
+  mrb_value blk, val, last, v;
+  struct RRange *r;
+  mrb_bool str_each = FALSE;
+  mrb_yieldinfo y;
+  int ai;
+
+  if (mrb_iter_fallback(mrb, range, "__each", &v)) {
+    return v;
+  }
+  mrb_get_args(mrb, "&", &blk);
+  if (mrb_nil_p(blk)) {
+    return mrb_funcall(mrb, range, "to_enum", 1, mrb_symbol_value(mrb_intern_lit(mrb, "each")));
+  }
+
+  r = mrb_range_ptr(mrb, range);
+  val = r->edges->beg;
+  last = r->edges->end;
+  ai = mrb_gc_arena_save(mrb);
+  mrb_yield_prepare(mrb, &y, blk, 1);
+
+  if (mrb_fixnum_p(val) && mrb_fixnum_p(last)) { /* fixnums are special */
+    mrb_int i = mrb_fixnum(val), lim = mrb_fixnum(last);
+
+    if (r->excl) {
+      if (i >= lim) return range;
+      lim--;
+    }
+    else if (i > lim) return range;
+    for (;;) {
+      v = mrb_fixnum_value(i);
+      mrb_yield_fast(mrb, &y, &v);
+      mrb_gc_arena_restore(mrb, ai);
+      if (i == lim) break;
+      i++;
+    }
+    return range;
+  }
+
+  if (mrb_string_p(val) && mrb_string_p(last)) {
+    if (mrb_respond_to(mrb, val, mrb_intern_lit(mrb, "upto"))) {
+      mrb_value argv[2];
+
+      argv[0] = last;
+      argv[1] = mrb_bool_value(r->excl);
+      /* String#upto may keep the block */
+      if (mrb_proc_ptr(blk)->env) {
+        mrb_env_escape(mrb, mrb_proc_ptr(blk)->env);
+      }
+      return mrb_funcall_with_block(mrb, val, mrb_intern_lit(mrb, "upto"), 2, argv, blk);
+    }
+    str_each = TRUE;
+  }
+
+  if (!mrb_respond_to(mrb, val, mrb_intern_lit(mrb, "succ"))) {
+    mrb_raise(mrb, E_TYPE_ERROR, "can't iterate");
+  }
+  if (range_each_cmp(mrb, val, last) > 0) return range;
+
+  while (range_each_cmp(mrb, val, last) < 0) {
+    mrb_yield_fast(mrb, &y, &val);
+    val = mrb_funcall(mrb, val, "succ", 0);
+    mrb_gc_protect(mrb, val);
+    if (str_each &&
+        mrb_fixnum(mrb_funcall(mrb, val, "size", 0)) > mrb_fixnum(mrb_funcall(mrb, last, "size", 0))) {
+      return range;
+    }
+    mrb_gc_arena_restore(mrb, ai);
+    mrb_gc_protect(mrb, val);
+  }
+  if (!r->excl && range_each_cmp(mrb, val, last) == 0) {
+    mrb_yield_fast(mrb, &y, &val);
+  }
+  return range;
+}
+
 mrb_value
 mrb_get_values_at(mrb_state *mrb, mrb_value obj, mrb_int olen, mrb_int argc, const mrb_value *argv, mrb_value (*func)(mrb_state*, mrb_value, mrb_int))
 {
@@ -426,6 +527,7 @@ mrb_init_range(mrb_state *mrb)
   MRB_SET_INSTANCE_TT(r, MRB_TT_RANGE);
 
   mrb_define_method(mrb, r, "begin",           mrb_range_beg,         MRB_ARGS_NONE()); /* 15.2.14.4.3  */
+  mrb_define_iterator(mrb, r, "each",          range_each,            MRB_ARGS_NONE()); /* 15.2.14.4.4  */
   mrb_define_method(mrb, r, "end",             mrb_range_end,         MRB_ARGS_NONE()); /* 15.2.14.4.5  */
   mrb_define_method(mrb, r, "==",              mrb_range_eq,          MRB_ARGS_REQ(1)); /* 15.2.14.4.1  */
   mrb_define_method(mrb, r, "===",             mrb_range_include,     MRB_ARGS_REQ(1)); /* 15.2.14.4.2  */
@@ -38,6 +38,7 @@ mrb_open_core(mrb_allocf f, void *ud)
   mrb->allocf_ud = ud;
   mrb->allocf = f;
   mrb->atexit_stack_len = 0;
+  mrb->const_serial = 1;        /* empty constant caches have serial 0 */
 
   mrb_gc_init(mrb, &mrb->gc);
   mrb->c = (struct mrb_context*)mrb_malloc(mrb, sizeof(struct mrb_context));
@@ -164,6 +165,17 @@ mrb_irep_free(mrb_state *mrb, mrb_irep *irep)
   }
   mrb_free(mrb, irep->lines);
   mrb_debug_info_free(mrb, irep->debug_info);
+#ifndef MRB_NO_METHOD_CACHE
+  for (i=0; i<irep->cclen; i++) {
+    struct mrb_call_cache *cc = &irep->ccache[i];
+
+    mrb->call_cache_stats.sites[cc->megamorphic ? MRB_CALL_CACHE_WAYS+1 : cc->n]--;
+  }
+  mrb_free(mrb, irep->ccache);
+#endif
+  mrb_free(mrb, irep->ivcache);
+  mrb_free(mrb, irep->kcache);
+  mrb_free(mrb, irep->cidx);
   mrb_free(mrb, irep);
 }
 
@@ -250,6 +262,7 @@ mrb_close(mrb_state *mrb)
   mrb_free_symtbl(mrb);
   mrb_alloca_free(mrb);
   mrb_gc_destroy(mrb, &mrb->gc);
+  mrb_gc_free_shapes(mrb);
   mrb_free(mrb, mrb);
 }
 
@@ -4,6 +4,7 @@
 ** See Copyright Notice in mruby.h
 */
 
+#include <string.h>
 #include <mruby.h>
 #include <mruby/array.h>
 #include <mruby/class.h>
@@ -404,34 +405,254 @@ mark_tbl(mrb_state *mrb, iv_tbl *t)
   }
 }
 
+#ifndef MRB_SHAPE_MAX_IVS
+#define MRB_SHAPE_MAX_IVS 64
+#endif
+
+#ifndef MRB_SHAPE_MAX
+#define MRB_SHAPE_MAX 8192
+#endif
+
+/* plain object keeping its variables in shape slots */
+#define shaped_p(obj) ((obj)->tt == MRB_TT_OBJECT && !(obj)->iv)
+
+/* number of slots allocated for n variables */
+static size_t
+ivs_capa(size_t n)
+{
+  size_t capa = 2;
+
+  if (n == 0) return 0;
+  while (capa < n) capa *= 2;
+  return capa;
+}
+
+/* shape adding variable sym to shape; NULL if over the limits */
+static struct mrb_shape*
+shape_child(mrb_state *mrb, struct mrb_shape *shape, mrb_sym sym)
+{
+  struct mrb_shape *parent = shape;
+  struct mrb_shape *child;
+
+  if (!parent) {
+    if (!mrb->root_shape) {
+      mrb->root_shape = (struct mrb_shape*)mrb_calloc(mrb, 1, sizeof(struct mrb_shape));
+    }
+    parent = mrb->root_shape;
+  }
+  for (child = parent->child; child; child = child->sibling) {
+    if (child->name == sym) return child;
+  }
+  if (parent->n >= MRB_SHAPE_MAX_IVS || mrb->shape_count >= MRB_SHAPE_MAX) {
+    return NULL;
+  }
+  child = (struct mrb_shape*)mrb_malloc(mrb, sizeof(struct mrb_shape));
+  child->parent = shape;
+  child->child = NULL;
+  child->sibling = parent->child;
+  child->name = sym;
+  child->n = parent->n + 1;
+  parent->child = child;
+  mrb->shape_count++;
+  return child;
+}
+
+static int
+shape_slot(struct mrb_shape *shape, mrb_sym sym)
+{
+  while (shape) {
+    if (shape->name == sym) return shape->n - 1;
+    shape = shape->parent;
+  }
+  return -1;
+}
+
+/* calls func for variables in order of definition */
+static void
+shape_foreach(mrb_state *mrb, struct mrb_shape *shape, mrb_value *ivs, iv_foreach_func *func, void *p)
+{
+  if (!shape) return;
+  shape_foreach(mrb, shape->parent, ivs, func, p);
+  (*func)(mrb, shape->name, ivs[shape->n - 1], p);
+}
+
+static void
+shape_free(mrb_state *mrb, struct mrb_shape *shape)
+{
+  while (shape) {
+    struct mrb_shape *next = shape->sibling;
+
+    shape_free(mrb, shape->child);
+    mrb_free(mrb, shape);
+    shape = next;
+  }
+}
+
+void
+mrb_gc_free_shapes(mrb_state *mrb)
+{
+  shape_free(mrb, mrb->root_shape);
+  mrb->root_shape = NULL;
+  mrb->shape_count = 0;
+}
+
+/* slot of variable sym in shaped object; -1 if none */
+int
+mrb_obj_iv_slot(mrb_state *mrb, struct RObject *obj, mrb_sym sym)
+{
+  if (!shaped_p(obj)) return -1;
+  return shape_slot(obj->shape, sym);
+}
+
+/* moves shaped object to a descendant of its shape, new slots are nil */
+void
+mrb_obj_shape_set(mrb_state *mrb, struct RObject *obj, struct mrb_shape *shape)
+{
+  size_t n = obj->shape ? obj->shape->n : 0;
+  size_t capa = ivs_capa(shape->n);
+
+  if (capa != ivs_capa(n)) {
+    obj->ivs = (mrb_value*)mrb_realloc(mrb, obj->ivs, sizeof(mrb_value)*capa);
+  }
+  obj->shape = shape;
+  for (; n < shape->n; n++) {
+    obj->ivs[n] = mrb_nil_value();
+  }
+}
+
+static int
+unshape_i(mrb_state *mrb, mrb_sym sym, mrb_value v, void *p)
+{
+  iv_put(mrb, (iv_tbl*)p, sym, v);
+  return 0;
+}
+
+/* moves variables of shaped object to an iv table */
+static iv_tbl*
+obj_unshape(mrb_state *mrb, struct RObject *obj)
+{
+  iv_tbl *t = iv_new(mrb);
+
+  shape_foreach(mrb, obj->shape, obj->ivs, unshape_i, t);
+  mrb_free(mrb, obj->ivs);
+  obj->ivs = NULL;
+  obj->shape = NULL;
+  obj->iv = t;
+  return t;
+}
+
+static void
+obj_iv_foreach(mrb_state *mrb, struct RObject *obj, iv_foreach_func *func, void *p)
+{
+  if (shaped_p(obj)) {
+    shape_foreach(mrb, obj->shape, obj->ivs, func, p);
+  }
+  else if (obj->iv) {
+    iv_foreach(mrb, obj->iv, func, p);
+  }
+}
+
+/* global variables; a symbol gets a slot when the variable is first
+   set and keeps it, removed variables hold undef */
+typedef struct gv_tbl {
+  mrb_value *val;               /* values by slot */
+  mrb_sym *name;                /* names by slot */
+  size_t len, capa;
+  uint32_t *slot;               /* slot+1 by symbol, 0 if none */
+  size_t nsym;
+} gv_tbl;
+
+static int
+gv_slot(mrb_state *mrb, mrb_sym sym)
+{
+  gv_tbl *g = mrb->globals;
+
+  if (!g || sym >= g->nsym) return -1;
+  return (int)g->slot[sym] - 1;
+}
+
+static int
+gv_slot_new(mrb_state *mrb, mrb_sym sym)
+{
+  gv_tbl *g = mrb->globals;
+
+  if (!g) {
+    g = mrb->globals = (gv_tbl*)mrb_calloc(mrb, 1, sizeof(gv_tbl));
+  }
+  if (sym >= g->nsym) {
+    /* room for all symbols so far */
+    size_t nsym = mrb->symidx + 1;
+
+    if (nsym <= sym) nsym = sym + 1;
+    g->slot = (uint32_t*)mrb_realloc(mrb, g->slot, sizeof(uint32_t)*nsym);
+    memset(g->slot + g->nsym, 0, sizeof(uint32_t)*(nsym - g->nsym));
+    g->nsym = nsym;
+  }
+  if (g->len == g->capa) {
+    g->capa = g->capa ? g->capa * 2 : 16;
+    g->val = (mrb_value*)mrb_realloc(mrb, g->val, sizeof(mrb_value)*g->capa);
+    g->name = (mrb_sym*)mrb_realloc(mrb, g->name, sizeof(mrb_sym)*g->capa);
+  }
+  g->val[g->len] = mrb_undef_value();
+  g->name[g->len] = sym;
+  g->slot[sym] = (uint32_t)++g->len;
+  return (int)g->len - 1;
+}
+
 void
 mrb_gc_mark_gv(mrb_state *mrb)
 {
-  mark_tbl(mrb, mrb->globals);
+  gv_tbl *g = mrb->globals;
+  size_t i;
+
+  if (!g) return;
+  for (i=0; i<g->len; i++) {
+    mrb_gc_mark_value(mrb, g->val[i]);
+  }
 }
 
 void
 mrb_gc_free_gv(mrb_state *mrb)
 {
-  if (mrb->globals)
-    iv_free(mrb, mrb->globals);
+  gv_tbl *g = mrb->globals;
+
+  if (!g) return;
+  mrb_free(mrb, g->val);
+  mrb_free(mrb, g->name);
+  mrb_free(mrb, g->slot);
+  mrb_free(mrb, g);
+  mrb->globals = NULL;
 }
 
 void
 mrb_gc_mark_iv(mrb_state *mrb, struct RObject *obj)
 {
+  if (shaped_p(obj)) {
+    size_t i, n = obj->shape ? obj->shape->n : 0;
+
+    for (i=0; i<n; i++) {
+      mrb_gc_mark_value(mrb, obj->ivs[i]);
+    }
+    return;
+  }
   mark_tbl(mrb, obj->iv);
 }
 
 size_t
 mrb_gc_mark_iv_size(mrb_state *mrb, struct RObject *obj)
 {
+  if (shaped_p(obj)) {
+    return obj->shape ? obj->shape->n : 0;
+  }
   return iv_size(mrb, obj->iv);
 }
 
 void
 mrb_gc_free_iv(mrb_state *mrb, struct RObject *obj)
 {
+  if (obj->tt == MRB_TT_OBJECT) {
+    mrb_free(mrb, obj->ivs);
+  }
   if (obj->iv) {
     iv_free(mrb, obj->iv);
   }
@@ -470,6 +691,12 @@ mrb_obj_iv_get(mrb_state *mrb, struct RObject *obj, mrb_sym sym)
 {
   mrb_value v;
 
+  if (shaped_p(obj)) {
+    int idx = shape_slot(obj->shape, sym);
+
+    if (idx >= 0) return obj->ivs[idx];
+    return mrb_nil_value();
+  }
   if (obj->iv && iv_get(mrb, obj->iv, sym, &v))
     return v;
   return mrb_nil_value();
@@ -484,6 +711,26 @@ mrb_iv_get(mrb_state *mrb, mrb_value obj, mrb_sym sym)
   return mrb_nil_value();
 }
 
+/* constants live in iv tables of classes and modules; a change of one
+   makes constant inline caches stale */
+static void
+const_changed(mrb_state *mrb, struct RObject *obj, mrb_sym sym)
+{
+  switch (obj->tt) {
+  case MRB_TT_CLASS:
+  case MRB_TT_MODULE:
+  case MRB_TT_SCLASS:
+    {
+      const char *s = mrb_sym2name_len(mrb, sym, NULL);
+
+      if (s && ISUPPER(s[0])) mrb->const_serial++;
+    }
+    break;
+  default:
+    break;
+  }
+}
+
 MRB_API void
 mrb_obj_iv_set(mrb_state *mrb, struct RObject *obj, mrb_sym sym, mrb_value v)
 {
@@ -492,11 +739,30 @@ mrb_obj_iv_set(mrb_state *mrb, struct RObject *obj, mrb_sym sym, mrb_value v)
   if (MRB_FROZEN_P(obj)) {
     mrb_raisef(mrb, E_RUNTIME_ERROR, "can't modify frozen %S", mrb_obj_value(obj));
   }
+  if (shaped_p(obj)) {
+    int idx = shape_slot(obj->shape, sym);
+
+    if (idx < 0) {
+      struct mrb_shape *shape = shape_child(mrb, obj->shape, sym);
+
+      if (!shape) {
+        t = obj_unshape(mrb, obj);
+        goto put;
+      }
+      mrb_obj_shape_set(mrb, obj, shape);
+      idx = shape->n - 1;
+    }
+    mrb_write_barrier(mrb, (struct RBasic*)obj);
+    obj->ivs[idx] = v;
+    return;
+  }
   if (!t) {
     t = obj->iv = iv_new(mrb);
   }
+ put:
   mrb_write_barrier(mrb, (struct RBasic*)obj);
   iv_put(mrb, t, sym, v);
+  const_changed(mrb, obj, sym);
 }
 
 MRB_API void
@@ -504,6 +770,12 @@ mrb_obj_iv_ifnone(mrb_state *mrb, struct RObject *obj, mrb_sym sym, mrb_value v)
 {
   iv_tbl *t = obj->iv;
 
+  if (shaped_p(obj)) {
+    if (shape_slot(obj->shape, sym) < 0) {
+      mrb_obj_iv_set(mrb, obj, sym, v);
+    }
+    return;
+  }
   if (!t) {
     t = obj->iv = iv_new(mrb);
   }
@@ -512,6 +784,7 @@ mrb_obj_iv_ifnone(mrb_state *mrb, struct RObject *obj, mrb_sym sym, mrb_value v)
   }
   mrb_write_barrier(mrb, (struct RBasic*)obj);
   iv_put(mrb, t, sym, v);
+  const_changed(mrb, obj, sym);
 }
 
 MRB_API void
@@ -530,6 +803,9 @@ mrb_obj_iv_defined(mrb_state *mrb, struct RObject *obj, mrb_sym sym)
 {
   iv_tbl *t;
 
+  if (shaped_p(obj)) {
+    return shape_slot(obj->shape, sym) >= 0;
+  }
   t = obj->iv;
   if (t) {
     return iv_get(mrb, t, sym, NULL);
@@ -576,14 +852,37 @@ mrb_iv_copy(mrb_state *mrb, mrb_value dest, mrb_value src)
   struct RObject *d = mrb_obj_ptr(dest);
   struct RObject *s = mrb_obj_ptr(src);
 
+  if (d->tt == MRB_TT_OBJECT) {
+    mrb_free(mrb, d->ivs);
+    d->ivs = NULL;
+    d->shape = NULL;
+  }
   if (d->iv) {
     iv_free(mrb, d->iv);
     d->iv = 0;
   }
-  if (s->iv) {
+  if (shaped_p(s) && s->shape && d->tt == MRB_TT_OBJECT) {
+    size_t n = s->shape->n;
+    mrb_value *ivs = (mrb_value*)mrb_malloc(mrb, sizeof(mrb_value)*ivs_capa(n));
+
+    memcpy(ivs, s->ivs, sizeof(mrb_value)*n);
+    mrb_write_barrier(mrb, (struct RBasic*)d);
+    d->ivs = ivs;
+    d->shape = s->shape;
+  }
+  else if (shaped_p(s) && s->shape) {
+    mrb_write_barrier(mrb, (struct RBasic*)d);
+    d->iv = iv_new(mrb);
+    shape_foreach(mrb, s->shape, s->ivs, unshape_i, d->iv);
+  }
+  else if (s->iv) {
     mrb_write_barrier(mrb, (struct RBasic*)d);
     d->iv = iv_copy(mrb, s->iv);
   }
+  if (d->tt == MRB_TT_CLASS || d->tt == MRB_TT_MODULE || d->tt == MRB_TT_SCLASS) {
+    /* constants of the class are replaced */
+    mrb->const_serial++;
+  }
 }
 
 static int
@@ -619,8 +918,7 @@ inspect_i(mrb_state *mrb, mrb_sym sym, mrb_value v, void *p)
 mrb_value
 mrb_obj_iv_inspect(mrb_state *mrb, struct RObject *obj)
 {
-  iv_tbl *t = obj->iv;
-  size_t len = iv_size(mrb, t);
+  size_t len = mrb_gc_mark_iv_size(mrb, obj);
 
   if (len > 0) {
     const char *cn = mrb_obj_classname(mrb, mrb_obj_value(obj));
@@ -631,7 +929,7 @@ mrb_obj_iv_inspect(mrb_state *mrb, struct RObject *obj)
     mrb_str_cat_lit(mrb, str, ":");
     mrb_str_concat(mrb, str, mrb_ptr_to_str(mrb, obj));
 
-    iv_foreach(mrb, t, inspect_i, &str);
+    obj_iv_foreach(mrb, obj, inspect_i, &str);
     mrb_str_cat_lit(mrb, str, ">");
     return str;
   }
@@ -642,10 +940,18 @@ MRB_API mrb_value
 mrb_iv_remove(mrb_state *mrb, mrb_value obj, mrb_sym sym)
 {
   if (obj_iv_p(obj)) {
-    iv_tbl *t = mrb_obj_ptr(obj)->iv;
+    struct RObject *o = mrb_obj_ptr(obj);
+    iv_tbl *t;
     mrb_value val;
 
+    if (shaped_p(o)) {
+      /* shapes only grow, keep the rest of variables in iv table */
+      if (shape_slot(o->shape, sym) < 0) return mrb_undef_value();
+      obj_unshape(mrb, o);
+    }
+    t = o->iv;
     if (t && iv_del(mrb, t, sym, &val)) {
+      const_changed(mrb, o, sym);
       return val;
     }
   }
@@ -704,8 +1010,8 @@ mrb_obj_instance_variables(mrb_state *mrb, mrb_value self)
   mrb_value ary;
 
   ary = mrb_ary_new(mrb);
-  if (obj_iv_p(self) && mrb_obj_ptr(self)->iv) {
-    iv_foreach(mrb, mrb_obj_ptr(self)->iv, iv_i, &ary);
+  if (obj_iv_p(self)) {
+    obj_iv_foreach(mrb, mrb_obj_ptr(self), iv_i, &ary);
   }
   return ary;
 }
@@ -906,21 +1212,21 @@ mod_const_check(mrb_state *mrb, mrb_value mod)
   }
 }
 
-static mrb_value
-const_get(mrb_state *mrb, struct RClass *base, mrb_sym sym)
+/* looks up constant in base and its ancestors without calling
+   const_missing */
+mrb_bool
+mrb_const_find(mrb_state *mrb, struct RClass *base, mrb_sym sym, mrb_value *vp)
 {
   struct RClass *c = base;
-  mrb_value v;
   iv_tbl *t;
   mrb_bool retry = FALSE;
-  mrb_value name;
 
 L_RETRY:
   while (c) {
     if (c->iv) {
       t = c->iv;
-      if (iv_get(mrb, t, sym, &v))
-        return v;
+      if (iv_get(mrb, t, sym, vp))
+        return TRUE;
     }
     c = c->super;
   }
@@ -929,6 +1235,17 @@ L_RETRY:
     retry = TRUE;
     goto L_RETRY;
   }
+  return FALSE;
+}
+
+static mrb_value
+const_get(mrb_state *mrb, struct RClass *base, mrb_sym sym)
+{
+  mrb_value v;
+  mrb_value name;
+
+  if (mrb_const_find(mrb, base, sym, &v))
+    return v;
   name = mrb_symbol_value(sym);
   return mrb_funcall_argv(mrb, mrb_obj_value(base), mrb_intern_lit(mrb, "const_missing"), 1, &name);
 }
@@ -940,36 +1257,58 @@ mrb_const_get(mrb_state *mrb, mrb_value mod, mrb_sym sym)
   return const_get(mrb, mrb_class_ptr(mod), sym);
 }
 
-mrb_value
-mrb_vm_const_get(mrb_state *mrb, mrb_sym sym)
+/* constants of singleton class bodies are looked up from the class of
+   the attached object */
+static struct RClass*
+const_lexical_class(mrb_state *mrb, struct RClass *c)
 {
-  struct RClass *c = mrb->c->ci->proc->target_class;
+  struct RClass *c2 = c;
 
-  if (!c) c = mrb->c->ci->target_class;
+  while (c2 && c2->tt == MRB_TT_SCLASS) {
+    mrb_value klass;
+    klass = mrb_obj_iv_get(mrb, (struct RObject *)c2,
+                           mrb_intern_lit(mrb, "__attached__"));
+    c2 = mrb_class_ptr(klass);
+  }
+  if (c2->tt == MRB_TT_CLASS || c2->tt == MRB_TT_MODULE) return c2;
+  return c;
+}
+
+/* looks up constant from lexical class c like OP_GETCONST, without
+   calling const_missing */
+mrb_bool
+mrb_vm_const_find(mrb_state *mrb, struct RClass *c, mrb_sym sym, mrb_value *vp)
+{
   if (c) {
     struct RClass *c2;
-    mrb_value v;
 
-    if (c->iv && iv_get(mrb, c->iv, sym, &v)) {
-      return v;
-    }
-    c2 = c;
-    while (c2 && c2->tt == MRB_TT_SCLASS) {
-      mrb_value klass;
-      klass = mrb_obj_iv_get(mrb, (struct RObject *)c2,
-                             mrb_intern_lit(mrb, "__attached__"));
-      c2 = mrb_class_ptr(klass);
+    if (c->iv && iv_get(mrb, c->iv, sym, vp)) {
+      return TRUE;
     }
-    if (c2->tt == MRB_TT_CLASS || c2->tt == MRB_TT_MODULE) c = c2;
+    c = const_lexical_class(mrb, c);
     c2 = c;
     for (;;) {
       c2 = mrb_class_outer_module(mrb, c2);
       if (!c2) break;
-      if (c2->iv && iv_get(mrb, c2->iv, sym, &v)) {
-        return v;
+      if (c2->iv && iv_get(mrb, c2->iv, sym, vp)) {
+        return TRUE;
       }
     }
   }
+  return mrb_const_find(mrb, c, sym, vp);
+}
+
+mrb_value
+mrb_vm_const_get(mrb_state *mrb, mrb_sym sym)
+{
+  struct RClass *c = mrb->c->ci->proc->target_class;
+  mrb_value v;
+
+  if (!c) c = mrb->c->ci->target_class;
+  if (mrb_vm_const_find(mrb, c, sym, &v)) {
+    return v;
+  }
+  if (c) c = const_lexical_class(mrb, c);
   return const_get(mrb, c, sym);
 }
 
@@ -1053,47 +1392,34 @@ mrb_mod_constants(mrb_state *mrb, mrb_value mod)
 MRB_API mrb_value
 mrb_gv_get(mrb_state *mrb, mrb_sym sym)
 {
-  mrb_value v;
+  int i = gv_slot(mrb, sym);
 
-  if (!mrb->globals) {
+  if (i < 0 || mrb_undef_p(mrb->globals->val[i])) {
     return mrb_nil_value();
   }
-  if (iv_get(mrb, mrb->globals, sym, &v))
-    return v;
-  return mrb_nil_value();
+  return mrb->globals->val[i];
 }
 
 MRB_API void
 mrb_gv_set(mrb_state *mrb, mrb_sym sym, mrb_value v)
 {
-  iv_tbl *t;
+  int i = gv_slot(mrb, sym);
 
-  if (!mrb->globals) {
-    t = mrb->globals = iv_new(mrb);
-  }
-  else {
-    t = mrb->globals;
+  if (i < 0) {
+    i = gv_slot_new(mrb, sym);
   }
-  iv_put(mrb, t, sym, v);
+  mrb->globals->val[i] = v;
 }
 
 MRB_API void
 mrb_gv_remove(mrb_state *mrb, mrb_sym sym)
 {
-  if (!mrb->globals) {
+  int i = gv_slot(mrb, sym);
+
+  if (i < 0) {
     return;
   }
-  iv_del(mrb, mrb->globals, sym, NULL);
-}
-
-static int
-gv_i(mrb_state *mrb, mrb_sym sym, mrb_value v, void *p)
-{
-  mrb_value ary;
-
-  ary = *(mrb_value*)p;
-  mrb_ary_push(mrb, ary, mrb_symbol_value(sym));
-  return 0;
+  mrb->globals->val[i] = mrb_undef_value();
 }
 
 /* 15.3.1.2.4  */
@@ -1109,13 +1435,17 @@ gv_i(mrb_state *mrb, mrb_sym sym, mrb_value v, void *p)
 mrb_value
 mrb_f_global_variables(mrb_state *mrb, mrb_value self)
 {
-  iv_tbl *t = mrb->globals;
+  gv_tbl *g = mrb->globals;
   mrb_value ary = mrb_ary_new(mrb);
   size_t i;
   char buf[3];
 
-  if (t) {
-    iv_foreach(mrb, t, gv_i, &ary);
+  if (g) {
+    for (i=0; i<g->len; i++) {
+      if (!mrb_undef_p(g->val[i])) {
+        mrb_ary_push(mrb, ary, mrb_symbol_value(g->name[i]));
+      }
+    }
   }
   buf[0] = '$';
   buf[2] = 0;
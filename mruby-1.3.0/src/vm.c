@@ -271,6 +271,12 @@ mrb_env_unshare(mrb_state *mrb, struct REnv *e)
     e->cioff = -e->cxt.c->cibase[cioff].argc-1;
   }
   e->cxt.mid = e->cxt.c->cibase[cioff].mid;
+  if (MRB_ENV_NOESCAPE_P(e)) {
+    /* no proc referring to the env outlives the frame */
+    e->stack = NULL;
+    MRB_SET_ENV_STACK_LEN(e, 0);
+    return;
+  }
   p = (mrb_value *)mrb_malloc(mrb, sizeof(mrb_value)*len);
   if (len > 0) {
     stack_copy(p, e->stack, len);
@@ -500,6 +506,30 @@ mrb_exec_irep(mrb_state *mrb, mrb_value self, struct RProc *p)
   return self;
 }
 
+/* Runs Ruby method `rname` in place of the calling C iterator, as
+   send does, when a block called from C would not be able to
+   Fiber.yield: inside a fiber, iterator called from the VM. */
+mrb_bool
+mrb_iter_fallback(mrb_state *mrb, mrb_value self, const char *rname, mrb_value *vp)
+{
+  mrb_callinfo *ci = mrb->c->ci;
+  struct RClass *c;
+  struct RProc *p;
+  mrb_value blk;
+
+  if (mrb->c == mrb->root_c || ci->acc < 0) return FALSE;
+  c = mrb_class(mrb, self);
+  p = mrb_method_search_vm(mrb, &c, mrb_intern_cstr(mrb, rname));
+  if (!p) return FALSE;
+  blk = mrb->c->stack[ci->argc < 0 ? 2 : ci->argc+1];
+  if (mrb_type(blk) == MRB_TT_PROC && mrb_proc_ptr(blk)->env) {
+    mrb_env_escape(mrb, mrb_proc_ptr(blk)->env);
+  }
+  ci->target_class = c;
+  *vp = mrb_exec_irep(mrb, self, p);
+  return TRUE;
+}
+
 /* 15.3.1.3.4  */
 /* 15.3.1.3.44 */
 /*
@@ -737,6 +767,83 @@ mrb_yield(mrb_state *mrb, mrb_value b, mrb_value arg)
   return mrb_yield_with_class(mrb, b, 1, &arg, p->env->stack[0], p->target_class);
 }
 
+MRB_API void
+mrb_yield_prepare(mrb_state *mrb, mrb_yieldinfo *y, mrb_value b, mrb_int argc)
+{
+  struct RProc *p;
+
+  if (mrb_nil_p(b)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "no block given");
+  }
+  if (mrb->c->ci - mrb->c->cibase > MRB_FUNCALL_DEPTH_MAX) {
+    mrb_exc_raise(mrb, mrb_obj_value(mrb->stack_err));
+  }
+  p = mrb_proc_ptr(b);
+  y->proc = p;
+  y->self = p->env->stack[0];
+  y->target_class = p->target_class;
+  y->mid = mrb->c->ci->mid;
+  y->argc = argc;
+  if (MRB_PROC_CFUNC_P(p)) {
+    y->nregs = 0;               /* mrb_yield_fast() takes the slow path */
+    return;
+  }
+  y->nregs = p->body.irep->nregs;
+  if (y->nregs < argc + 2) {
+    y->nregs = argc + 2;
+  }
+  stack_extend(mrb, mrb->c->ci->nregs + y->nregs);
+}
+
+MRB_API mrb_value
+mrb_yield_fast(mrb_state *mrb, mrb_yieldinfo *y, const mrb_value *argv)
+{
+  struct mrb_context *c = mrb->c;
+  mrb_callinfo *ci = c->ci;
+  mrb_value *stack;
+  mrb_value val;
+  ptrdiff_t cioff;
+  mrb_int argc = y->argc;
+
+  /* the stack_extend() of mrb_yield_prepare() holds as long as the
+     yields come from the frame that prepared them */
+  if (y->nregs == 0 || ci + 1 == c->ciend) {
+    return mrb_yield_with_class(mrb, mrb_obj_value(y->proc), argc, argv, y->self, y->target_class);
+  }
+  stack = c->stack + ci->nregs;
+  ci = ++c->ci;
+  ci->mid = y->mid;
+  ci->proc = y->proc;
+  ci->stackent = c->stack;
+  ci->nregs = y->nregs;
+  ci->ridx = ci[-1].ridx;
+  ci->epos = c->eidx;
+  ci->env = 0;
+  ci->pc = 0;
+  ci->err = 0;
+  ci->argc = argc;
+  ci->acc = CI_ACC_SKIP;
+  ci->target_class = y->target_class;
+  c->stack = stack;
+
+  stack[0] = y->self;
+  stack_copy(stack+1, argv, argc);
+  stack[argc+1] = mrb_nil_value();
+  stack_clear(stack+argc+2, y->nregs-argc-2);
+
+  cioff = ci - c->cibase;
+  val = mrb_vm_exec(mrb, y->proc, y->proc->body.irep->iseq);
+  if (mrb->c != c) {
+    if (mrb->c->fib) {
+      mrb_write_barrier(mrb, (struct RBasic*)mrb->c->fib);
+    }
+    mrb->c = c;
+  }
+  c->ci = c->cibase + cioff;
+  cipop(mrb);
+  return val;
+}
+
 mrb_value
 mrb_yield_cont(mrb_state *mrb, mrb_value b, mrb_value self, mrb_int argc, const mrb_value *argv)
 {
@@ -760,6 +867,38 @@ mrb_yield_cont(mrb_state *mrb, mrb_value b, mrb_value self, mrb_int argc, const
   return mrb_exec_irep(mrb, self, p);
 }
 
+/* RBreak carrying `return` from a block called by C */
+#define MRB_BREAK_RETURN 1
+
+/* Does unwinding the frames above `base` cross a C function? */
+static mrb_bool
+ci_cross_c_p(mrb_callinfo *ci, mrb_callinfo *base)
+{
+  for (; ci >= base; ci--) {
+    if (ci->acc < 0) return TRUE;
+  }
+  return FALSE;
+}
+
+/* Pops frames above `base` left by the VM that threw break (or return)
+   to this one, and this VM's own.  Returns FALSE when `base` is below
+   this VM too; the VM that called it through C is the next to unwind. */
+static mrb_bool
+ci_unwind(mrb_state *mrb, mrb_callinfo *base)
+{
+  mrb_bool thrower = FALSE;
+
+  while (mrb->c->ci > base) {
+    if (mrb->c->ci->acc == CI_ACC_SKIP) {
+      if (thrower) return FALSE;
+      thrower = TRUE;
+    }
+    mrb->c->stack = mrb->c->ci->stackent;
+    cipop(mrb);
+  }
+  return TRUE;
+}
+
 static struct RBreak*
 break_new(mrb_state *mrb, struct RProc *p, mrb_value val)
 {
@@ -889,6 +1028,223 @@ mrb_vm_run(mrb_state *mrb, struct RProc *proc, mrb_value self, unsigned int stac
   return result;
 }
 
+static uint16_t
+cache_index(size_t *n)
+{
+  return (uint16_t)(*n < MRB_INLINE_CACHE_MAX ? (*n)++ : MRB_INLINE_CACHE_MAX);
+}
+
+/* gives inline cache entries to instructions that send or access variables
+   and constants;
+   the entry after the last one serves instructions over MRB_INLINE_CACHE_MAX
+   without caching, entries must not be shared */
+static void
+irep_cache_init(mrb_state *mrb, mrb_irep *irep)
+{
+  size_t i, ncall = 0, niv = 0, nconst = 0;
+
+  irep->cidx = (uint16_t *)mrb_malloc(mrb, sizeof(uint16_t)*irep->ilen);
+  for (i=0; i<irep->ilen; i++) {
+    switch (GET_OPCODE(mrb_insn_generic(BYTECODE_DECODER(irep->iseq[i])))) {
+#ifndef MRB_NO_METHOD_CACHE
+    case OP_SEND: case OP_SENDB:
+    case OP_ADD: case OP_ADDI: case OP_SUB: case OP_SUBI: case OP_MUL: case OP_DIV:
+    case OP_EQ: case OP_LT: case OP_LE: case OP_GT: case OP_GE:
+    case OP_EQI: case OP_LTI: case OP_LEI: case OP_GTI: case OP_GEI:
+    case OP_EQJ: case OP_LTJ: case OP_LEJ: case OP_GTJ: case OP_GEJ:
+      irep->cidx[i] = cache_index(&ncall);
+      break;
+#endif
+    case OP_GETIV: case OP_SETIV:
+      irep->cidx[i] = cache_index(&niv);
+      break;
+    case OP_GETCONST: case OP_GETMCNST:
+      irep->cidx[i] = cache_index(&nconst);
+      break;
+    default:
+      irep->cidx[i] = 0;
+      break;
+    }
+  }
+#ifndef MRB_NO_METHOD_CACHE
+  irep->ccache = (struct mrb_call_cache *)mrb_calloc(mrb, ncall+1, sizeof(struct mrb_call_cache));
+  irep->ccache[ncall].megamorphic = TRUE;
+  irep->cclen = (uint16_t)ncall;
+  mrb->call_cache_stats.sites[0] += ncall;
+#endif
+  irep->ivcache = (struct mrb_iv_cache *)mrb_calloc(mrb, niv+1, sizeof(struct mrb_iv_cache));
+  irep->kcache = (struct mrb_const_cache *)mrb_calloc(mrb, nconst+1, sizeof(struct mrb_const_cache));
+}
+
+#define CACHE_INDEX(irep, pc) ((irep)->cidx[(pc) - (irep)->iseq])
+
+static mrb_value
+iv_cache_get(mrb_state *mrb, struct mrb_iv_cache *ic, mrb_value self, mrb_sym sym)
+{
+  if (mrb_type(self) == MRB_TT_OBJECT) {
+    struct RObject *obj = mrb_obj_ptr(self);
+    int idx = mrb_obj_iv_slot(mrb, obj, sym);
+
+    if (idx >= 0) {
+      if (ic) {
+        ic->shape = obj->shape;
+        ic->idx = (uint16_t)idx;
+      }
+      return obj->ivs[idx];
+    }
+  }
+  return mrb_iv_get(mrb, self, sym);
+}
+
+static void
+iv_cache_set(mrb_state *mrb, struct mrb_iv_cache *ic, mrb_value self, mrb_sym sym, mrb_value v)
+{
+  struct RObject *obj;
+  struct mrb_shape *from;
+  int idx;
+
+  if (mrb_type(self) != MRB_TT_OBJECT) {
+    mrb_iv_set(mrb, self, sym, v);
+    return;
+  }
+  obj = mrb_obj_ptr(self);
+  from = obj->shape;
+  mrb_obj_iv_set(mrb, obj, sym, v);
+  idx = mrb_obj_iv_slot(mrb, obj, sym);
+  if (ic && idx >= 0) {
+    ic->shape = obj->shape;
+    ic->from = (obj->shape == from) ? NULL : from;
+    ic->idx = (uint16_t)idx;
+  }
+}
+
+/* remembers constant found by lookup; constants missing are not cached
+   because const_missing may answer differently each time */
+static void
+const_cache_fill(mrb_state *mrb, struct mrb_const_cache *kc, struct RClass *c, mrb_value v)
+{
+  if (kc && c) {
+    kc->c = c;
+    kc->v = v;
+    kc->serial = mrb->const_serial;
+    c->flags |= MRB_FLAG_IN_CONST_CACHE;
+  }
+}
+
+#ifndef MRB_NO_METHOD_CACHE
+/* looks up method missed by inline cache and adds it to the cache */
+static struct RProc*
+call_cache_fill(mrb_state *mrb, struct mrb_call_cache *cc, struct RClass **cp, mrb_sym mid)
+{
+  struct mrb_call_cache_stats *stats = &mrb->call_cache_stats;
+  struct RClass *c = *cp;
+  struct RProc *m = mrb_method_search_vm(mrb, cp, mid);
+
+  if (cc->megamorphic) {
+    stats->megamorphic++;
+    return m;
+  }
+  stats->miss++;
+  if (!m) return NULL;          /* method_missing is not cached */
+
+  stats->sites[cc->n]--;
+  if (cc->serial != mrb->method_serial) {
+    cc->serial = mrb->method_serial;
+    cc->n = 0;
+  }
+  if (cc->n == MRB_CALL_CACHE_WAYS) {
+    cc->megamorphic = TRUE;
+    cc->n = 0;
+    stats->sites[MRB_CALL_CACHE_WAYS+1]++;
+    return m;
+  }
+  cc->e[cc->n].c = c;
+  cc->e[cc->n].c0 = *cp;
+  cc->e[cc->n].m = m;
+  cc->n++;
+  c->flags |= MRB_FLAG_IN_CALL_CACHE;
+  stats->sites[cc->n]++;
+  return m;
+}
+#endif
+
+mrb_code
+mrb_insn_generic(mrb_code i)
+{
+  int op;
+
+  switch (GET_OPCODE(i)) {
+  case OP_ADD_II: case OP_ADD_FF: op = OP_ADD; break;
+  case OP_ADDI_I: case OP_ADDI_F: op = OP_ADDI; break;
+  case OP_SUB_II: case OP_SUB_FF: op = OP_SUB; break;
+  case OP_SUBI_I: case OP_SUBI_F: op = OP_SUBI; break;
+  case OP_MUL_II: case OP_MUL_FF: op = OP_MUL; break;
+  case OP_DIV_FF: op = OP_DIV; break;
+  case OP_EQ_II: case OP_EQ_FF: op = OP_EQ; break;
+  case OP_LT_II: case OP_LT_FF: op = OP_LT; break;
+  case OP_LE_II: case OP_LE_FF: op = OP_LE; break;
+  case OP_GT_II: case OP_GT_FF: op = OP_GT; break;
+  case OP_GE_II: case OP_GE_FF: op = OP_GE; break;
+  case OP_AREF_ARY_I: case OP_ASET_ARY_I: op = OP_SEND; break;
+  default: return i;
+  }
+  return (i & ~MKOPCODE(0x7f)) | MKOPCODE(op);
+}
+
+#ifndef MRB_NO_QUICKENING
+/* reverted quickenings after which an instruction stays generic */
+#define QUICKEN_DEOPT_MAX 4
+
+/* rewrites the instruction at pc into op; static iseq may be read-only
+   and shared, so it is never rewritten */
+static void
+quicken(mrb_state *mrb, mrb_irep *irep, mrb_code *pc, int op)
+{
+  if (irep->flags & MRB_ISEQ_NO_FREE) return;
+  if (!irep->cidx) irep_cache_init(mrb, irep);
+  if (irep->ccache[CACHE_INDEX(irep, pc)].deopt >= QUICKEN_DEOPT_MAX) return;
+  *pc = (*pc & ~MKOPCODE(0x7f)) | MKOPCODE(op);
+}
+
+/* send of Array#[] or Array#[]= to an Array with a Fixnum index, the
+   methods found are still the built-in ones */
+static void
+quicken_send(mrb_state *mrb, mrb_irep *irep, mrb_code *pc, mrb_sym mid, int n,
+             const mrb_value *argv, struct RClass *c, struct RProc *m)
+{
+  if (c != mrb->array_class || !MRB_PROC_CFUNC_P(m) ||
+      !mrb_array_p(argv[0]) || mrb_obj_ptr(argv[0])->c != mrb->array_class ||
+      !mrb_fixnum_p(argv[1])) {
+    return;
+  }
+  if (n == 1 && mid == mrb_intern_lit(mrb, "[]")) {
+    quicken(mrb, irep, pc, OP_AREF_ARY_I);
+  }
+  else if (n == 2 && mid == mrb_intern_lit(mrb, "[]=")) {
+    quicken(mrb, irep, pc, OP_ASET_ARY_I);
+  }
+}
+
+#define QUICKEN(op) do {\
+  if (!(irep->flags & MRB_ISEQ_NO_FREE)) quicken(mrb, irep, pc, op);\
+} while (0)
+/* method cache of the send instruction is still valid */
+#define QUICK_SEND_P(irep, pc) ((irep)->ccache[CACHE_INDEX(irep, pc)].serial == mrb->method_serial)
+#else
+#define QUICKEN(op)
+#define QUICK_SEND_P(irep, pc) FALSE
+#endif
+
+/* operands of a quickened instruction changed: back to the generic one */
+static void
+dequicken(mrb_irep *irep, mrb_code *pc)
+{
+#ifndef MRB_NO_QUICKENING
+  irep->ccache[CACHE_INDEX(irep, pc)].deopt++;
+#endif
+  *pc = mrb_insn_generic(*pc);
+}
+
 MRB_API mrb_value
 mrb_vm_exec(mrb_state *mrb, struct RProc *proc, mrb_code *pc)
 {
@@ -923,6 +1279,14 @@ mrb_vm_exec(mrb_state *mrb, struct RProc *proc, mrb_code *pc)
     &&L_OP_CLASS, &&L_OP_MODULE, &&L_OP_EXEC,
     &&L_OP_METHOD, &&L_OP_SCLASS, &&L_OP_TCLASS,
     &&L_OP_DEBUG, &&L_OP_STOP, &&L_OP_ERR,
+    &&L_OP_MOVE2, &&L_OP_EQI, &&L_OP_LTI, &&L_OP_LEI, &&L_OP_GTI, &&L_OP_GEI,
+    &&L_OP_EQJ, &&L_OP_LTJ, &&L_OP_LEJ, &&L_OP_GTJ, &&L_OP_GEJ,
+    &&L_OP_ADD_II, &&L_OP_ADD_FF, &&L_OP_ADDI_I, &&L_OP_ADDI_F,
+    &&L_OP_SUB_II, &&L_OP_SUB_FF, &&L_OP_SUBI_I, &&L_OP_SUBI_F,
+    &&L_OP_MUL_II, &&L_OP_MUL_FF, &&L_OP_DIV_FF, &&L_OP_EQ_II, &&L_OP_EQ_FF,
+    &&L_OP_LT_II, &&L_OP_LT_FF, &&L_OP_LE_II, &&L_OP_LE_FF,
+    &&L_OP_GT_II, &&L_OP_GT_FF, &&L_OP_GE_II, &&L_OP_GE_FF,
+    &&L_OP_AREF_ARY_I, &&L_OP_ASET_ARY_I,
   };
 #endif
 
@@ -956,6 +1320,14 @@ RETRY_TRY_BLOCK:
       NEXT;
     }
 
+    CASE(OP_MOVE2) {
+      /* A B C  R(A) := R(B); R(A+1) := R(C) */
+      int a = GETARG_A(i);
+      regs[a] = regs[GETARG_B(i)];
+      regs[a+1] = regs[GETARG_C(i)];
+      NEXT;
+    }
+
     CASE(OP_LOADL) {
       /* A Bx   R(A) := Pool(Bx) */
       int a = GETARG_A(i);
@@ -1045,8 +1417,19 @@ RETRY_TRY_BLOCK:
       /* A Bx   R(A) := ivget(Bx) */
       int a = GETARG_A(i);
       int bx = GETARG_Bx(i);
-      mrb_value val = mrb_vm_iv_get(mrb, syms[bx]);
-      regs[a] = val;
+      mrb_value self = regs[0];
+      struct mrb_iv_cache *ic;
+
+      if (!irep->cidx) irep_cache_init(mrb, irep);
+      ic = &irep->ivcache[CACHE_INDEX(irep, pc)];
+      if (mrb_type(self) == MRB_TT_OBJECT && ic->shape &&
+          mrb_obj_ptr(self)->shape == ic->shape) {
+        regs[a] = mrb_obj_ptr(self)->ivs[ic->idx];
+      }
+      else {
+        regs[a] = iv_cache_get(mrb, CACHE_INDEX(irep, pc) < MRB_INLINE_CACHE_MAX ? ic : NULL,
+                               self, syms[bx]);
+      }
       NEXT;
     }
 
@@ -1054,7 +1437,29 @@ RETRY_TRY_BLOCK:
       /* A Bx   ivset(Syms(Bx),R(A)) */
       int a = GETARG_A(i);
       int bx = GETARG_Bx(i);
-      mrb_vm_iv_set(mrb, syms[bx], regs[a]);
+      mrb_value self = regs[0];
+      struct mrb_iv_cache *ic;
+
+      if (!irep->cidx) irep_cache_init(mrb, irep);
+      ic = &irep->ivcache[CACHE_INDEX(irep, pc)];
+      if (mrb_type(self) == MRB_TT_OBJECT && ic->shape && !MRB_FROZEN_P(mrb_obj_ptr(self))) {
+        struct RObject *obj = mrb_obj_ptr(self);
+
+        if (obj->shape == ic->shape) {
+          mrb_write_barrier(mrb, (struct RBasic*)obj);
+          obj->ivs[ic->idx] = regs[a];
+          NEXT;
+        }
+        /* adding the variable; NULL from is an object without variables */
+        if (obj->shape == ic->from && !obj->iv && (ic->from || ic->shape->n == 1)) {
+          mrb_obj_shape_set(mrb, obj, ic->shape);
+          mrb_write_barrier(mrb, (struct RBasic*)obj);
+          obj->ivs[ic->idx] = regs[a];
+          NEXT;
+        }
+      }
+      iv_cache_set(mrb, CACHE_INDEX(irep, pc) < MRB_INLINE_CACHE_MAX ? ic : NULL,
+                   self, syms[bx], regs[a]);
       NEXT;
     }
 
@@ -1084,9 +1489,23 @@ RETRY_TRY_BLOCK:
       int a = GETARG_A(i);
       int bx = GETARG_Bx(i);
       mrb_sym sym = syms[bx];
+      struct RClass *c = mrb->c->ci->proc->target_class;
+      struct mrb_const_cache *kc;
 
+      if (!c) c = mrb->c->ci->target_class;
+      if (!irep->cidx) irep_cache_init(mrb, irep);
+      kc = &irep->kcache[CACHE_INDEX(irep, pc)];
+      if (kc->c == c && kc->serial == mrb->const_serial) {
+        regs[a] = kc->v;
+        NEXT;
+      }
       ERR_PC_SET(mrb, pc);
-      val = mrb_vm_const_get(mrb, sym);
+      if (mrb_vm_const_find(mrb, c, sym, &val)) {
+        const_cache_fill(mrb, CACHE_INDEX(irep, pc) < MRB_INLINE_CACHE_MAX ? kc : NULL, c, val);
+      }
+      else {
+        val = mrb_vm_const_get(mrb, sym);
+      }
       ERR_PC_CLR(mrb);
       regs[a] = val;
       NEXT;
@@ -1105,9 +1524,24 @@ RETRY_TRY_BLOCK:
       mrb_value val;
       int a = GETARG_A(i);
       int bx = GETARG_Bx(i);
+      struct mrb_const_cache *kc;
 
+      if (!irep->cidx) irep_cache_init(mrb, irep);
+      kc = &irep->kcache[CACHE_INDEX(irep, pc)];
+      if ((mrb_type(regs[a]) == MRB_TT_MODULE || mrb_type(regs[a]) == MRB_TT_CLASS) &&
+          kc->c == mrb_class_ptr(regs[a]) && kc->serial == mrb->const_serial) {
+        regs[a] = kc->v;
+        NEXT;
+      }
       ERR_PC_SET(mrb, pc);
-      val = mrb_const_get(mrb, regs[a], syms[bx]);
+      if ((mrb_type(regs[a]) == MRB_TT_MODULE || mrb_type(regs[a]) == MRB_TT_CLASS) &&
+          mrb_const_find(mrb, mrb_class_ptr(regs[a]), syms[bx], &val)) {
+        const_cache_fill(mrb, CACHE_INDEX(irep, pc) < MRB_INLINE_CACHE_MAX ? kc : NULL,
+                         mrb_class_ptr(regs[a]), val);
+      }
+      else {
+        val = mrb_const_get(mrb, regs[a], syms[bx]);
+      }
       ERR_PC_CLR(mrb);
       regs[a] = val;
       NEXT;
@@ -1341,7 +1775,36 @@ RETRY_TRY_BLOCK:
         }
       }
       c = mrb_class(mrb, recv);
+#ifndef MRB_NO_METHOD_CACHE
+      {
+        struct mrb_call_cache *cc;
+        int k;
+
+        if (!irep->cidx) irep_cache_init(mrb, irep);
+        cc = &irep->ccache[CACHE_INDEX(irep, pc)];
+        m = NULL;
+        if (cc->serial == mrb->method_serial) {
+          for (k=0; k<cc->n; k++) {
+            if (cc->e[k].c == c) {
+              mrb->call_cache_stats.hit++;
+              m = cc->e[k].m;
+              c = cc->e[k].c0;
+              break;
+            }
+          }
+        }
+        if (!m) {
+          m = call_cache_fill(mrb, cc, &c, mid);
+#ifndef MRB_NO_QUICKENING
+          if (m && GET_OPCODE(*pc) == OP_SEND) {
+            quicken_send(mrb, irep, pc, mid, n, regs+a, c, m);
+          }
+#endif
+        }
+      }
+#else
       m = mrb_method_search_vm(mrb, &c, mid);
+#endif
       if (!m) {
         mrb_value sym = mrb_symbol_value(mid);
         mrb_sym missing = mrb_intern_lit(mrb, "method_missing");
@@ -1370,6 +1833,14 @@ RETRY_TRY_BLOCK:
         }
         mrb_ary_unshift(mrb, regs[a+1], sym);
       }
+      if (mrb_type(blk) == MRB_TT_PROC) {
+        struct REnv *e = mrb_proc_ptr(blk)->env;
+
+        if (e && MRB_ENV_NOESCAPE_P(e) &&
+            !(MRB_PROC_CFUNC_P(m) && MRB_PROC_ITERATOR_P(m))) {
+          mrb_env_escape(mrb, e);
+        }
+      }
 
       /* push callinfo */
       ci = cipush(mrb);
@@ -1915,36 +2386,51 @@ RETRY_TRY_BLOCK:
       else {
         int acc;
         mrb_value v;
+        mrb_bool brk_return;
 
         v = regs[GETARG_A(i)];
         mrb_gc_protect(mrb, v);
         switch (GETARG_B(i)) {
         case OP_R_RETURN:
           /* Fall through to OP_R_NORMAL otherwise */
-          if (ci->acc >=0 && proc->env && !MRB_PROC_STRICT_P(proc)) {
+          if (proc->env && !MRB_PROC_STRICT_P(proc)) {
             struct REnv *e = top_env(mrb, proc);
             mrb_callinfo *ce;
+            mrb_bool caught = FALSE;
 
+            if (FALSE) {
+            L_BREAK_RETURN:
+              e = top_env(mrb, proc);
+              caught = TRUE;
+            }
             if (!MRB_ENV_STACK_SHARED_P(e) || e->cxt.c != mrb->c) {
               localjump_error(mrb, LOCALJUMP_ERROR_RETURN);
               goto L_RAISE;
             }
             
             ce = mrb->c->cibase + e->cioff;
+            if (ce == mrb->c->cibase) {
+              localjump_error(mrb, LOCALJUMP_ERROR_RETURN);
+              goto L_RAISE;
+            }
+            if (caught) {
+              if (!ci_unwind(mrb, ce + 1)) {
+                mrb->jmp = prev_jmp;
+                MRB_THROW(prev_jmp);
+              }
+              mrb->exc = NULL;
+            }
+            else if (ci_cross_c_p(mrb->c->ci, ce + 1)) {
+              brk_return = TRUE;
+              goto L_BREAK_THROW;
+            }
+            ci = mrb->c->ci;
             while (ci >= ce) {
               if (ci->env) {
                 mrb_env_unshare(mrb, ci->env);
               }
-              if (ci->acc < 0) {
-                localjump_error(mrb, LOCALJUMP_ERROR_RETURN);
-                goto L_RAISE;
-              }
               ci--;
             }
-            if (ce == mrb->c->cibase) {
-              localjump_error(mrb, LOCALJUMP_ERROR_RETURN);
-              goto L_RAISE;
-            }
             mrb->c->stack = mrb->c->ci->stackent;
             mrb->c->ci = ce;
             break;
@@ -1996,13 +2482,19 @@ RETRY_TRY_BLOCK:
             c->prev = NULL;
             ci = mrb->c->ci;
           }
-          if (ci->acc < 0) {
+          if (ci->acc < 0 ||
+              ci_cross_c_p(ci, mrb->c->cibase + proc->env->cioff + 2)) {
+            brk_return = FALSE;
+          L_BREAK_THROW:
             while (mrb->c->eidx > mrb->c->ci->epos) {
               ecall(mrb, --mrb->c->eidx);
             }
             ARENA_RESTORE(mrb, ai);
             mrb->c->vmexec = FALSE;
             mrb->exc = (struct RObject*)break_new(mrb, proc, v);
+            if (brk_return) {
+              mrb->exc->flags |= MRB_BREAK_RETURN;
+            }
             mrb->jmp = prev_jmp;
             MRB_THROW(prev_jmp);
           }
@@ -2010,6 +2502,13 @@ RETRY_TRY_BLOCK:
           L_BREAK:
             v = ((struct RBreak*)mrb->exc)->val;
             proc = ((struct RBreak*)mrb->exc)->proc;
+            if (mrb->exc->flags & MRB_BREAK_RETURN) {
+              goto L_BREAK_RETURN;
+            }
+            if (!ci_unwind(mrb, mrb->c->cibase + proc->env->cioff + 1)) {
+              mrb->jmp = prev_jmp;
+              MRB_THROW(prev_jmp);
+            }
             mrb->exc = NULL;
             ci = mrb->c->ci;
           }
@@ -2176,6 +2675,7 @@ RETRY_TRY_BLOCK:
       /* need to check if op is overridden */
       switch (TYPES2(mrb_type(regs[a]),mrb_type(regs[a+1]))) {
       case TYPES2(MRB_TT_FIXNUM,MRB_TT_FIXNUM):
+        QUICKEN(OP_ADD_II);
         {
           mrb_int x, y, z;
           mrb_value *regs_a = regs + a;
@@ -2190,6 +2690,7 @@ RETRY_TRY_BLOCK:
         }
         break;
       case TYPES2(MRB_TT_FIXNUM,MRB_TT_FLOAT):
+        QUICKEN(OP_ADD_FF);
         {
           mrb_int x = mrb_fixnum(regs[a]);
           mrb_float y = mrb_float(regs[a+1]);
@@ -2197,6 +2698,7 @@ RETRY_TRY_BLOCK:
         }
         break;
       case TYPES2(MRB_TT_FLOAT,MRB_TT_FIXNUM):
+        QUICKEN(OP_ADD_FF);
 #ifdef MRB_WORD_BOXING
         {
           mrb_float x = mrb_float(regs[a]);
@@ -2208,6 +2710,7 @@ RETRY_TRY_BLOCK:
 #endif
         break;
       case TYPES2(MRB_TT_FLOAT,MRB_TT_FLOAT):
+        QUICKEN(OP_ADD_FF);
 #ifdef MRB_WORD_BOXING
         {
           mrb_float x = mrb_float(regs[a]);
@@ -2235,6 +2738,7 @@ RETRY_TRY_BLOCK:
       /* need to check if op is overridden */
       switch (TYPES2(mrb_type(regs[a]),mrb_type(regs[a+1]))) {
       case TYPES2(MRB_TT_FIXNUM,MRB_TT_FIXNUM):
+        QUICKEN(OP_SUB_II);
         {
           mrb_int x, y, z;
 
@@ -2248,6 +2752,7 @@ RETRY_TRY_BLOCK:
         }
         break;
       case TYPES2(MRB_TT_FIXNUM,MRB_TT_FLOAT):
+        QUICKEN(OP_SUB_FF);
         {
           mrb_int x = mrb_fixnum(regs[a]);
           mrb_float y = mrb_float(regs[a+1]);
@@ -2255,6 +2760,7 @@ RETRY_TRY_BLOCK:
         }
         break;
       case TYPES2(MRB_TT_FLOAT,MRB_TT_FIXNUM):
+        QUICKEN(OP_SUB_FF);
 #ifdef MRB_WORD_BOXING
         {
           mrb_float x = mrb_float(regs[a]);
@@ -2266,6 +2772,7 @@ RETRY_TRY_BLOCK:
 #endif
         break;
       case TYPES2(MRB_TT_FLOAT,MRB_TT_FLOAT):
+        QUICKEN(OP_SUB_FF);
 #ifdef MRB_WORD_BOXING
         {
           mrb_float x = mrb_float(regs[a]);
@@ -2289,6 +2796,7 @@ RETRY_TRY_BLOCK:
       /* need to check if op is overridden */
       switch (TYPES2(mrb_type(regs[a]),mrb_type(regs[a+1]))) {
       case TYPES2(MRB_TT_FIXNUM,MRB_TT_FIXNUM):
+        QUICKEN(OP_MUL_II);
         {
           mrb_int x, y, z;
 
@@ -2302,6 +2810,7 @@ RETRY_TRY_BLOCK:
         }
         break;
       case TYPES2(MRB_TT_FIXNUM,MRB_TT_FLOAT):
+        QUICKEN(OP_MUL_FF);
         {
           mrb_int x = mrb_fixnum(regs[a]);
           mrb_float y = mrb_float(regs[a+1]);
@@ -2309,6 +2818,7 @@ RETRY_TRY_BLOCK:
         }
         break;
       case TYPES2(MRB_TT_FLOAT,MRB_TT_FIXNUM):
+        QUICKEN(OP_MUL_FF);
 #ifdef MRB_WORD_BOXING
         {
           mrb_float x = mrb_float(regs[a]);
@@ -2320,6 +2830,7 @@ RETRY_TRY_BLOCK:
 #endif
         break;
       case TYPES2(MRB_TT_FLOAT,MRB_TT_FLOAT):
+        QUICKEN(OP_MUL_FF);
 #ifdef MRB_WORD_BOXING
         {
           mrb_float x = mrb_float(regs[a]);
@@ -2343,6 +2854,7 @@ RETRY_TRY_BLOCK:
       /* need to check if op is overridden */
       switch (TYPES2(mrb_type(regs[a]),mrb_type(regs[a+1]))) {
       case TYPES2(MRB_TT_FIXNUM,MRB_TT_FIXNUM):
+        QUICKEN(OP_DIV_FF);
         {
           mrb_int x = mrb_fixnum(regs[a]);
           mrb_int y = mrb_fixnum(regs[a+1]);
@@ -2350,6 +2862,7 @@ RETRY_TRY_BLOCK:
         }
         break;
       case TYPES2(MRB_TT_FIXNUM,MRB_TT_FLOAT):
+        QUICKEN(OP_DIV_FF);
         {
           mrb_int x = mrb_fixnum(regs[a]);
           mrb_float y = mrb_float(regs[a+1]);
@@ -2357,6 +2870,7 @@ RETRY_TRY_BLOCK:
         }
         break;
       case TYPES2(MRB_TT_FLOAT,MRB_TT_FIXNUM):
+        QUICKEN(OP_DIV_FF);
 #ifdef MRB_WORD_BOXING
         {
           mrb_float x = mrb_float(regs[a]);
@@ -2368,6 +2882,7 @@ RETRY_TRY_BLOCK:
 #endif
         break;
       case TYPES2(MRB_TT_FLOAT,MRB_TT_FLOAT):
+        QUICKEN(OP_DIV_FF);
 #ifdef MRB_WORD_BOXING
         {
           mrb_float x = mrb_float(regs[a]);
@@ -2397,6 +2912,7 @@ RETRY_TRY_BLOCK:
       /* need to check if + is overridden */
       switch (mrb_type(regs[a])) {
       case MRB_TT_FIXNUM:
+        QUICKEN(OP_ADDI_I);
         {
           mrb_int x = mrb_fixnum(regs[a]);
           mrb_int y = GETARG_C(i);
@@ -2410,6 +2926,7 @@ RETRY_TRY_BLOCK:
         }
         break;
       case MRB_TT_FLOAT:
+        QUICKEN(OP_ADDI_F);
 #ifdef MRB_WORD_BOXING
         {
           mrb_float x = mrb_float(regs[a]);
@@ -2435,6 +2952,7 @@ RETRY_TRY_BLOCK:
       /* need to check if + is overridden */
       switch (mrb_type(regs_a[0])) {
       case MRB_TT_FIXNUM:
+        QUICKEN(OP_SUBI_I);
         {
           mrb_int x = mrb_fixnum(regs_a[0]);
           mrb_int y = GETARG_C(i);
@@ -2449,6 +2967,7 @@ RETRY_TRY_BLOCK:
         }
         break;
       case MRB_TT_FLOAT:
+        QUICKEN(OP_SUBI_F);
 #ifdef MRB_WORD_BOXING
         {
           mrb_float x = mrb_float(regs[a]);
@@ -2468,20 +2987,24 @@ RETRY_TRY_BLOCK:
 
 #define OP_CMP_BODY(op,v1,v2) (v1(regs[a]) op v2(regs[a+1]))
 
-#define OP_CMP(op) do {\
+#define OP_CMP(op,qi,qf) do {\
   int result;\
   /* need to check if - is overridden */\
   switch (TYPES2(mrb_type(regs[a]),mrb_type(regs[a+1]))) {\
   case TYPES2(MRB_TT_FIXNUM,MRB_TT_FIXNUM):\
+    QUICKEN(qi);\
     result = OP_CMP_BODY(op,mrb_fixnum,mrb_fixnum);\
     break;\
   case TYPES2(MRB_TT_FIXNUM,MRB_TT_FLOAT):\
+    QUICKEN(qf);\
     result = OP_CMP_BODY(op,mrb_fixnum,mrb_float);\
     break;\
   case TYPES2(MRB_TT_FLOAT,MRB_TT_FIXNUM):\
+    QUICKEN(qf);\
     result = OP_CMP_BODY(op,mrb_float,mrb_fixnum);\
     break;\
   case TYPES2(MRB_TT_FLOAT,MRB_TT_FLOAT):\
+    QUICKEN(qf);\
     result = OP_CMP_BODY(op,mrb_float,mrb_float);\
     break;\
   default:\
@@ -2502,7 +3025,7 @@ RETRY_TRY_BLOCK:
         SET_TRUE_VALUE(regs[a]);
       }
       else {
-        OP_CMP(==);
+        OP_CMP(==,OP_EQ_II,OP_EQ_FF);
       }
       NEXT;
     }
@@ -2510,28 +3033,402 @@ RETRY_TRY_BLOCK:
     CASE(OP_LT) {
       /* A B C  R(A) := R(A)<R(A+1) (Syms[B]=:<,C=1)*/
       int a = GETARG_A(i);
-      OP_CMP(<);
+      OP_CMP(<,OP_LT_II,OP_LT_FF);
       NEXT;
     }
 
     CASE(OP_LE) {
       /* A B C  R(A) := R(A)<=R(A+1) (Syms[B]=:<=,C=1)*/
       int a = GETARG_A(i);
-      OP_CMP(<=);
+      OP_CMP(<=,OP_LE_II,OP_LE_FF);
       NEXT;
     }
 
     CASE(OP_GT) {
       /* A B C  R(A) := R(A)>R(A+1) (Syms[B]=:>,C=1)*/
       int a = GETARG_A(i);
-      OP_CMP(>);
+      OP_CMP(>,OP_GT_II,OP_GT_FF);
       NEXT;
     }
 
     CASE(OP_GE) {
       /* A B C  R(A) := R(A)>=R(A+1) (Syms[B]=:>=,C=1)*/
       int a = GETARG_A(i);
-      OP_CMP(>=);
+      OP_CMP(>=,OP_GE_II,OP_GE_FF);
+      NEXT;
+    }
+
+#define OP_CMPI(op) do {\
+  mrb_bool result;\
+  switch (mrb_type(regs[a])) {\
+  case MRB_TT_FIXNUM:\
+    result = mrb_fixnum(regs[a]) op GETARG_C(i);\
+    break;\
+  case MRB_TT_FLOAT:\
+    result = mrb_float(regs[a]) op GETARG_C(i);\
+    break;\
+  default:\
+    SET_INT_VALUE(regs[a+1], GETARG_C(i));\
+    i = MKOP_ABC(OP_SEND, a, GETARG_B(i), 1);\
+    goto L_SEND;\
+  }\
+  SET_BOOL_VALUE(regs[a], result);\
+} while(0)
+
+    CASE(OP_EQI) {
+      /* A B C  R(A) := R(A)==C (Syms[B]=:==)*/
+      int a = GETARG_A(i);
+      OP_CMPI(==);
+      NEXT;
+    }
+
+    CASE(OP_LTI) {
+      /* A B C  R(A) := R(A)<C (Syms[B]=:<)*/
+      int a = GETARG_A(i);
+      OP_CMPI(<);
+      NEXT;
+    }
+
+    CASE(OP_LEI) {
+      /* A B C  R(A) := R(A)<=C (Syms[B]=:<=)*/
+      int a = GETARG_A(i);
+      OP_CMPI(<=);
+      NEXT;
+    }
+
+    CASE(OP_GTI) {
+      /* A B C  R(A) := R(A)>C (Syms[B]=:>)*/
+      int a = GETARG_A(i);
+      OP_CMPI(>);
+      NEXT;
+    }
+
+    CASE(OP_GEI) {
+      /* A B C  R(A) := R(A)>=C (Syms[B]=:>=)*/
+      int a = GETARG_A(i);
+      OP_CMPI(>=);
+      NEXT;
+    }
+
+    /* compare fused with the conditional jump that follows it; the jump
+       instruction is left in place, so it still runs on its own after
+       a compare that had to send, or when jumped to */
+#define OP_CMPJ_RESULT(op) \
+  switch (TYPES2(mrb_type(regs[a]),mrb_type(regs[a+1]))) {\
+  case TYPES2(MRB_TT_FIXNUM,MRB_TT_FIXNUM):\
+    result = OP_CMP_BODY(op,mrb_fixnum,mrb_fixnum);\
+    break;\
+  case TYPES2(MRB_TT_FIXNUM,MRB_TT_FLOAT):\
+    result = OP_CMP_BODY(op,mrb_fixnum,mrb_float);\
+    break;\
+  case TYPES2(MRB_TT_FLOAT,MRB_TT_FIXNUM):\
+    result = OP_CMP_BODY(op,mrb_float,mrb_fixnum);\
+    break;\
+  case TYPES2(MRB_TT_FLOAT,MRB_TT_FLOAT):\
+    result = OP_CMP_BODY(op,mrb_float,mrb_float);\
+    break;\
+  default:\
+    goto L_SEND;\
+  }
+#define OP_CMPJ_JUMP() {\
+  mrb_code j = BYTECODE_DECODER(pc[1]);\
+  SET_BOOL_VALUE(regs[a], result);\
+  if (result == (GET_OPCODE(j) == OP_JMPIF)) {\
+    pc += 1 + GETARG_sBx(j);\
+  }\
+  else {\
+    pc += 2;\
+  }\
+  JUMP;\
+}
+
+    CASE(OP_EQJ) {
+      /* A B C  R(A) := R(A)==R(A+1) (Syms[B]=:==,C=1); jump at pc+1 */
+      int a = GETARG_A(i);
+      mrb_bool result;
+      if (mrb_obj_eq(mrb, regs[a], regs[a+1])) {
+        result = TRUE;
+      }
+      else {
+        OP_CMPJ_RESULT(==);
+      }
+      OP_CMPJ_JUMP();
+    }
+
+    CASE(OP_LTJ) {
+      /* A B C  R(A) := R(A)<R(A+1) (Syms[B]=:<,C=1); jump at pc+1 */
+      int a = GETARG_A(i);
+      mrb_bool result;
+      OP_CMPJ_RESULT(<);
+      OP_CMPJ_JUMP();
+    }
+
+    CASE(OP_LEJ) {
+      /* A B C  R(A) := R(A)<=R(A+1) (Syms[B]=:<=,C=1); jump at pc+1 */
+      int a = GETARG_A(i);
+      mrb_bool result;
+      OP_CMPJ_RESULT(<=);
+      OP_CMPJ_JUMP();
+    }
+
+    CASE(OP_GTJ) {
+      /* A B C  R(A) := R(A)>R(A+1) (Syms[B]=:>,C=1); jump at pc+1 */
+      int a = GETARG_A(i);
+      mrb_bool result;
+      OP_CMPJ_RESULT(>);
+      OP_CMPJ_JUMP();
+    }
+
+    CASE(OP_GEJ) {
+      /* A B C  R(A) := R(A)>=R(A+1) (Syms[B]=:>=,C=1); jump at pc+1 */
+      int a = GETARG_A(i);
+      mrb_bool result;
+      OP_CMPJ_RESULT(>=);
+      OP_CMPJ_JUMP();
+    }
+
+    /* quickened instructions: guard on the operand types they were
+       specialized for, otherwise rewrite back and run the generic one */
+#define DEQUICKEN() {\
+  dequicken(irep, pc);\
+  JUMP;\
+}
+#define QUICK_II_P() (mrb_fixnum_p(regs[a]) && mrb_fixnum_p(regs[a+1]))
+#define QUICK_FF_P() (mrb_float_p(regs[a]) ?\
+  (mrb_float_p(regs[a+1]) || mrb_fixnum_p(regs[a+1])) :\
+  (mrb_fixnum_p(regs[a]) && mrb_float_p(regs[a+1])))
+#define QUICK_FLO(v) (mrb_fixnum_p(v) ? (mrb_float)mrb_fixnum(v) : mrb_float(v))
+
+#define OP_MATH_II(op,overflow) do {\
+  mrb_int x, y, z;\
+  x = mrb_fixnum(regs[a]);\
+  y = mrb_fixnum(regs[a+1]);\
+  if (overflow(x, y, &z)) {\
+    SET_FLOAT_VALUE(mrb, regs[a], (mrb_float)x op (mrb_float)y);\
+  }\
+  else {\
+    SET_INT_VALUE(regs[a], z);\
+  }\
+} while(0)
+
+#define OP_MATH_FF(op) do {\
+  mrb_float z;\
+  z = QUICK_FLO(regs[a]) op QUICK_FLO(regs[a+1]);\
+  SET_FLOAT_VALUE(mrb, regs[a], z);\
+} while(0)
+
+#define OP_CMP_II(op) do {\
+  mrb_bool result;\
+  result = mrb_fixnum(regs[a]) op mrb_fixnum(regs[a+1]);\
+  SET_BOOL_VALUE(regs[a], result);\
+} while(0)
+
+#define OP_CMP_FF(op) do {\
+  mrb_bool result;\
+  result = QUICK_FLO(regs[a]) op QUICK_FLO(regs[a+1]);\
+  SET_BOOL_VALUE(regs[a], result);\
+} while(0)
+
+    CASE(OP_ADD_II) {
+      int a = GETARG_A(i);
+      if (!QUICK_II_P()) DEQUICKEN();
+      OP_MATH_II(+,mrb_int_add_overflow);
+      ARENA_RESTORE(mrb, ai);
+      NEXT;
+    }
+
+    CASE(OP_ADD_FF) {
+      int a = GETARG_A(i);
+      if (!QUICK_FF_P()) DEQUICKEN();
+      OP_MATH_FF(+);
+      ARENA_RESTORE(mrb, ai);
+      NEXT;
+    }
+
+    CASE(OP_ADDI_I) {
+      int a = GETARG_A(i);
+      mrb_int x, z;
+
+      if (!mrb_fixnum_p(regs[a])) DEQUICKEN();
+      x = mrb_fixnum(regs[a]);
+      if (mrb_int_add_overflow(x, GETARG_C(i), &z)) {
+        SET_FLOAT_VALUE(mrb, regs[a], (mrb_float)x + (mrb_float)GETARG_C(i));
+      }
+      else {
+        SET_INT_VALUE(regs[a], z);
+      }
+      NEXT;
+    }
+
+    CASE(OP_ADDI_F) {
+      int a = GETARG_A(i);
+      mrb_float z;
+
+      if (!mrb_float_p(regs[a])) DEQUICKEN();
+      z = mrb_float(regs[a]) + GETARG_C(i);
+      SET_FLOAT_VALUE(mrb, regs[a], z);
+      NEXT;
+    }
+
+    CASE(OP_SUB_II) {
+      int a = GETARG_A(i);
+      if (!QUICK_II_P()) DEQUICKEN();
+      OP_MATH_II(-,mrb_int_sub_overflow);
+      ARENA_RESTORE(mrb, ai);
+      NEXT;
+    }
+
+    CASE(OP_SUB_FF) {
+      int a = GETARG_A(i);
+      if (!QUICK_FF_P()) DEQUICKEN();
+      OP_MATH_FF(-);
+      ARENA_RESTORE(mrb, ai);
+      NEXT;
+    }
+
+    CASE(OP_SUBI_I) {
+      int a = GETARG_A(i);
+      mrb_int x, z;
+
+      if (!mrb_fixnum_p(regs[a])) DEQUICKEN();
+      x = mrb_fixnum(regs[a]);
+      if (mrb_int_sub_overflow(x, GETARG_C(i), &z)) {
+        SET_FLOAT_VALUE(mrb, regs[a], (mrb_float)x - (mrb_float)GETARG_C(i));
+      }
+      else {
+        SET_INT_VALUE(regs[a], z);
+      }
+      NEXT;
+    }
+
+    CASE(OP_SUBI_F) {
+      int a = GETARG_A(i);
+      mrb_float z;
+
+      if (!mrb_float_p(regs[a])) DEQUICKEN();
+      z = mrb_float(regs[a]) - GETARG_C(i);
+      SET_FLOAT_VALUE(mrb, regs[a], z);
+      NEXT;
+    }
+
+    CASE(OP_MUL_II) {
+      int a = GETARG_A(i);
+      if (!QUICK_II_P()) DEQUICKEN();
+      OP_MATH_II(*,mrb_int_mul_overflow);
+      ARENA_RESTORE(mrb, ai);
+      NEXT;
+    }
+
+    CASE(OP_MUL_FF) {
+      int a = GETARG_A(i);
+      if (!QUICK_FF_P()) DEQUICKEN();
+      OP_MATH_FF(*);
+      ARENA_RESTORE(mrb, ai);
+      NEXT;
+    }
+
+    CASE(OP_DIV_FF) {
+      /* Fixnums are divided as Floats too */
+      int a = GETARG_A(i);
+      mrb_float z;
+
+      if (!QUICK_II_P() && !QUICK_FF_P()) DEQUICKEN();
+      z = QUICK_FLO(regs[a]) / QUICK_FLO(regs[a+1]);
+      SET_FLOAT_VALUE(mrb, regs[a], z);
+      ARENA_RESTORE(mrb, ai);
+      NEXT;
+    }
+
+    CASE(OP_EQ_II) {
+      int a = GETARG_A(i);
+      if (!QUICK_II_P()) DEQUICKEN();
+      OP_CMP_II(==);
+      NEXT;
+    }
+
+    CASE(OP_EQ_FF) {
+      int a = GETARG_A(i);
+      if (!QUICK_FF_P()) DEQUICKEN();
+      OP_CMP_FF(==);
+      NEXT;
+    }
+
+    CASE(OP_LT_II) {
+      int a = GETARG_A(i);
+      if (!QUICK_II_P()) DEQUICKEN();
+      OP_CMP_II(<);
+      NEXT;
+    }
+
+    CASE(OP_LT_FF) {
+      int a = GETARG_A(i);
+      if (!QUICK_FF_P()) DEQUICKEN();
+      OP_CMP_FF(<);
+      NEXT;
+    }
+
+    CASE(OP_LE_II) {
+      int a = GETARG_A(i);
+      if (!QUICK_II_P()) DEQUICKEN();
+      OP_CMP_II(<=);
+      NEXT;
+    }
+
+    CASE(OP_LE_FF) {
+      int a = GETARG_A(i);
+      if (!QUICK_FF_P()) DEQUICKEN();
+      OP_CMP_FF(<=);
+      NEXT;
+    }
+
+    CASE(OP_GT_II) {
+      int a = GETARG_A(i);
+      if (!QUICK_II_P()) DEQUICKEN();
+      OP_CMP_II(>);
+      NEXT;
+    }
+
+    CASE(OP_GT_FF) {
+      int a = GETARG_A(i);
+      if (!QUICK_FF_P()) DEQUICKEN();
+      OP_CMP_FF(>);
+      NEXT;
+    }
+
+    CASE(OP_GE_II) {
+      int a = GETARG_A(i);
+      if (!QUICK_II_P()) DEQUICKEN();
+      OP_CMP_II(>=);
+      NEXT;
+    }
+
+    CASE(OP_GE_FF) {
+      int a = GETARG_A(i);
+      if (!QUICK_FF_P()) DEQUICKEN();
+      OP_CMP_FF(>=);
+      NEXT;
+    }
+
+#define QUICK_ARY_P() (mrb_array_p(regs[a]) &&\
+  mrb_obj_ptr(regs[a])->c == mrb->array_class &&\
+  mrb_fixnum_p(regs[a+1]) && QUICK_SEND_P(irep, pc))
+
+    CASE(OP_AREF_ARY_I) {
+      /* A B C  R(A) := R(A)[R(A+1)] (Syms[B]=:[],C=1) */
+      int a = GETARG_A(i);
+
+      if (!QUICK_ARY_P()) DEQUICKEN();
+      regs[a] = mrb_ary_ref(mrb, regs[a], mrb_fixnum(regs[a+1]));
+      NEXT;
+    }
+
+    CASE(OP_ASET_ARY_I) {
+      /* A B C  R(A) := R(A)[R(A+1)] = R(A+2) (Syms[B]=:[]=,C=2) */
+      int a = GETARG_A(i);
+
+      if (!QUICK_ARY_P()) DEQUICKEN();
+      mrb_ary_set(mrb, regs[a], mrb_fixnum(regs[a+1]), regs[a+2]);
+      regs[a] = regs[a+2];
       NEXT;
     }
 
@@ -2667,7 +3564,16 @@ RETRY_TRY_BLOCK:
       int c = GETARG_c(i);
 
       if (c & OP_L_CAPTURE) {
-        p = mrb_closure_new(mrb, irep->reps[GETARG_b(i)]);
+        mrb_code s = pc[1];
+        int b = GETARG_C(s) == CALL_MAXARGS ? GETARG_A(s)+2 : GETARG_A(s)+GETARG_C(s)+1;
+
+        /* block literal passed to the next call */
+        if (GET_OPCODE(s) == OP_SENDB && b == GETARG_A(i)) {
+          p = mrb_closure_new_noescape(mrb, irep->reps[GETARG_b(i)]);
+        }
+        else {
+          p = mrb_closure_new(mrb, irep->reps[GETARG_b(i)]);
+        }
       }
       else {
         p = mrb_proc_new(mrb, irep->reps[GETARG_b(i)]);
@@ -140,6 +140,19 @@ assert('Array#each', '15.2.12.5.10') do
   assert_equal(6, b)
 end
 
+assert('Array#each with the array changed by the block') do
+  a = [1, 2, 3]
+  r = []
+  a.each {|i| r << i; a << i * 10 if i < 3 }
+  assert_equal [1, 2, 3, 10, 20], r
+  a = [1, 2, 3, 4]
+  r = []
+  a.each {|i| r << i; a.pop }
+  assert_equal [1, 2], r
+  a = [1, 2, 3]
+  assert_equal [2, 4, 6, nil], a.collect! {|i| a << nil if i == 3; i && i * 2 }
+end
+
 assert('Array#each_index', '15.2.12.5.11') do
   a = [1]
   b = nil
@@ -284,6 +297,18 @@ assert('Array#shift', '15.2.12.5.27') do
   assert_nil([].shift)
   assert_equal([2,3], a)
   assert_equal(1, b)
+
+  # shifting a copy that shares its elements leaves the original alone
+  a = (1..20).to_a
+  c = a.dup
+  assert_equal(1, c.shift)
+  assert_equal(2, c.shift)
+  c.push 21
+  c[0] = 0
+  assert_equal([0] + (4..21).to_a, c)
+  assert_equal((1..20).to_a, a)
+  assert_equal(1, a.shift)
+  assert_raise(RuntimeError) { [1].freeze.shift }
 end
 
 assert('Array#size', '15.2.12.5.28') do
@@ -388,3 +413,75 @@ assert('Array#freeze') do
     a[0] = 1
   end
 end
+
+assert('Array#sort') do
+  assert_equal [1, 2, 3, 4, 6, 7], [7, 3, 1, 2, 6, 4].sort
+  assert_equal [-1.5, 0, 2, 2.5], [2.5, 0, -1.5, 2].sort
+  assert_equal ["a", "ab", "b"], ["b", "ab", "a"].sort
+  assert_equal [7, 6, 4, 3, 2, 1], [7, 3, 1, 2, 6, 4].sort {|a, b| b <=> a }
+  assert_equal [[1, 2], [1, 3], [2, 0]], [[2, 0], [1, 3], [1, 2]].sort
+  a = [3, 1, 2]
+  assert_equal [1, 2, 3], a.sort
+  assert_equal [3, 1, 2], a
+  assert_raise(ArgumentError) { [2, 1].sort {|x, y| nil } }
+end
+
+assert('Array#sort of large arrays') do
+  n = 7
+  a = []
+  1000.times {|i| n = (n * 1103 + 12345) % 4096; a << n }
+  s = a.sort
+  assert_equal a.size, s.size
+  (1...s.size).each {|i| assert_true s[i - 1] <= s[i] }
+  assert_equal (0..999).to_a, (0..999).to_a.reverse.sort
+  assert_equal [1] * 200 + [2] * 200, ([2, 1] * 200).sort
+  f = a.map {|x| x / 7.0 }.sort {|x, y| y <=> x }
+  (1...f.size).each {|i| assert_true f[i - 1] >= f[i] }
+end
+
+assert('Array#sort!') do
+  a = [3, 1, 2]
+  assert_equal a, a.sort!
+  assert_equal [1, 2, 3], a
+  a.sort! {|x, y| y <=> x }
+  assert_equal [3, 2, 1], a
+  assert_raise(RuntimeError) { [2, 1].freeze.sort! }
+end
+
+assert('Array Enumerable methods') do
+  a = [1, 2, 3, 4]
+  assert_equal [2, 4, 6, 8], a.map { |x| x * 2 }
+  assert_equal [2, 4], a.select { |x| x % 2 == 0 }
+  assert_equal 10, a.inject { |s, x| s + x }
+  assert_equal 20, a.inject(10) { |s, x| s + x }
+  assert_equal 10, a.inject(:+)
+  assert_equal 34, a.reduce(24, :+)
+  assert_nil [].inject(:+)
+  assert_equal 3, a.find { |x| x > 2 }
+  assert_equal :none, a.detect(:none) { |x| x > 4 }
+  r = []
+  assert_equal a, a.each_with_index { |x, i| r << x * i }
+  assert_equal [0, 2, 6, 12], r
+  assert_equal [[1, 2], [3, 4]], [[1, 2], [3, 4]].map { |x, y| [x, y] }
+  assert_equal "abc", %w(a b c).inject(:+)
+
+  # elements added by the block are visited, as with each
+  b = [1]
+  assert_equal [1, 2, 3], b.map { |x| b << x + 1 if x < 3; x }
+
+  # subclasses that redefine each get the Enumerable versions
+  c = Class.new(Array) do
+    def each
+      super { |x| yield x * 10 }
+    end
+  end
+  s = c.new
+  s.push 1, 2
+  assert_equal [10, 20], s.map { |x| x }
+  assert_equal [20], s.select { |x| x > 10 }
+  assert_equal 30, s.inject(:+)
+  assert_equal 20, s.find { |x| x > 10 }
+  r = []
+  s.each_with_index { |x, i| r << [x, i] }
+  assert_equal [[10, 0], [20, 1]], r
+end
@@ -73,3 +73,48 @@ assert('negate literal register alignment') do
 
   assert_equal [2], a
 end
+
+assert('compare with a literal operand') do
+  a = [1, 3, 3.5, 127, 128, "x", nil].map do |x|
+    [x == 3, (x < 3 rescue :err), (x <= 3 rescue :err), (x > 127 rescue :err), (x >= 3 rescue :err)]
+  end
+  assert_equal [false, true, true, false, false], a[0]
+  assert_equal [true, false, true, false, true], a[1]
+  assert_equal [false, false, false, false, true], a[2]
+  assert_equal [false, false, false, false, true], a[3]
+  assert_equal [false, false, false, true, true], a[4]
+  assert_equal [false, :err, :err, :err, :err], a[5]
+  assert_equal [false, :err, :err, :err, :err], a[6]
+end
+
+assert('compare fused with a conditional jump') do
+  c = Class.new do
+    def <(o); o == 1 ? :yes : nil; end
+    def ==(o); o == 2; end
+    def >(o); false; end
+    def >=(o); true; end
+  end.new
+  r = []
+  [0, 1, 2.5, c].each do |x|
+    y = x == c ? 1 : 0
+    r << (x < y ? :t : :f) << (x == 2 ? :t : :f)
+    r << (x < y && x) << (x < y || x == 2)
+    r << (:t if x > 0.5) << (:t unless x >= y)
+  end
+  assert_equal [:f, :f, false, false, nil, nil,
+                :f, :f, false, false, :t, nil,
+                :f, :f, false, false, :t, nil,
+                :t, :t, c, :yes, nil, nil], r
+  i = 0
+  i += 1 while i < 10
+  i -= 2 until i <= 3
+  assert_equal 2, i
+end
+
+assert('moves into consecutive registers') do
+  a, b, c = 1, 2, 3
+  d = a; e = b
+  assert_equal [1, 2, 3, 1, 2], [a, b, c, d, e]
+  assert_equal [2, 1], [b, a]
+  assert_equal [3, 3, 1], [c, c, a]
+end
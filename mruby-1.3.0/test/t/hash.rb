@@ -115,6 +115,31 @@ assert('Hash#each', '15.2.13.4.9') do
   assert_equal 'abc_value', value
 end
 
+assert('Hash#each block parameters') do
+  h = { 1 => [2, 3], :a => nil }
+  r = []
+  h.each {|pair| r << pair }
+  h.each {|*a| r << a }
+  h.each {|k, v, z| r << [k, v, z] }
+  assert_equal [[1, [2, 3]], [:a, nil], [[1, [2, 3]]], [[:a, nil]],
+                [1, [2, 3], nil], [:a, nil, nil]], r
+  r = []
+  h.each(&lambda {|pair| r << pair })
+  assert_equal [[1, [2, 3]], [:a, nil]], r
+end
+
+assert('Hash#each over the entries it was called with') do
+  h = { 1 => :a, 2 => :b, 3 => :c }
+  r = []
+  h.each do |k, v|
+    r << [k, v]
+    h[k + 10] = v
+    h.delete(3)
+  end
+  assert_equal [[1, :a], [2, :b], [3, :c]], r
+  assert_equal({ 1 => :a, 2 => :b, 11 => :a, 12 => :b, 13 => :c }, h)
+end
+
 assert('Hash#each_key', '15.2.13.4.10') do
   a = { 'abc_key' => 'abc_value' }
   key = nil
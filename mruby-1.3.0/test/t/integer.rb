@@ -266,3 +266,81 @@ assert('Integer#step') do
   assert_equal [1, 2, 3], a
   assert_equal [1, 3, 5], b
 end
+
+assert('Integer#step with Float or negative step') do
+  a = []
+  1.step(2, 0.5) {|i| a << i }
+  assert_equal [1, 1.5, 2.0], a
+  a = []
+  1.step(2.0) {|i| a << i }
+  assert_equal [1.0, 2.0], a
+  a = []
+  10.step(1, -4) {|i| a << i }
+  assert_equal [10, 6, 2], a
+  assert_raise(ArgumentError) { 1.step(3, 0) {} }
+end
+
+assert('Integer iterators with Float limit') do
+  a = []
+  1.upto(3.5) {|i| a << i }
+  assert_equal [1, 2, 3], a
+  a = []
+  3.downto(1.5) {|i| a << i }
+  assert_equal [3, 2], a
+  a = []
+  2.5.times {|i| a << i }
+  assert_equal [0, 1, 2], a
+end
+
+assert('Integer#times block locals and closures per iteration') do
+  procs = []
+  3.times {|i| x ||= i * 10; procs << lambda { x } }
+  assert_equal [0, 10, 20], procs.map {|pr| pr.call }
+end
+
+assert('Integer iterators keep variables captured by escaping procs') do
+  def int_iter_escape1
+    x = 1
+    3.times { x += 1 }
+    lambda { x }
+  end
+  def int_iter_escape2
+    x = 1
+    2.times {|i| 1.upto(2) {|j| $int_iter_escape = lambda { x + i + j } } }
+    x = 5
+  end
+  def int_iter_keep(&b)
+    b
+  end
+  def int_iter_escape3
+    x = 3
+    b = nil
+    2.times { b = int_iter_keep { x } }
+    x = 7
+    b
+  end
+  pr = int_iter_escape1
+  int_iter_escape2
+  b = int_iter_escape3
+  GC.start
+  assert_equal 4, pr.call
+  assert_equal 8, $int_iter_escape.call
+  assert_equal 7, b.call
+end
+
+assert('Integer iterators with break and return') do
+  assert_equal 30, 10.times {|i| break i * 10 if i == 3 }
+  def int_iter_return
+    3.times {|i| 1.upto(3) {|j| return [i, j] if i == 1 && j == 2 } }
+    :none
+  end
+  assert_equal [1, 2], int_iter_return
+  r = []
+  def int_iter_ensure(r)
+    2.times {|i| begin; return i; ensure; r << i; end }
+  ensure
+    r << :method
+  end
+  assert_equal 0, int_iter_ensure(r)
+  assert_equal [0, :method], r
+end
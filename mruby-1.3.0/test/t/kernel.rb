@@ -604,6 +604,22 @@ assert('Kernel#global_variables') do
   end
 end
 
+assert('global variables keep values') do
+  $kernel_gv_a = "a" * 3
+  $kernel_gv_b = [1, 2]
+  $kernel_gv_c = nil
+  GC.start
+  assert_equal "aaa", $kernel_gv_a
+  assert_equal [1, 2], $kernel_gv_b
+  assert_nil $kernel_gv_undefined
+  variables = global_variables
+  assert_true variables.include?(:$kernel_gv_a)
+  assert_true variables.include?(:$kernel_gv_c)
+  assert_false variables.include?(:$kernel_gv_undefined)
+  $kernel_gv_a = :changed
+  assert_equal :changed, $kernel_gv_a
+end
+
 assert('Kernel#define_singleton_method') do
   o = Object.new
   ret = o.define_singleton_method(:test_method) do
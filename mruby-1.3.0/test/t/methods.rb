@@ -107,3 +107,62 @@ assert('The undef statement (method undefined)', '13.3.7 a) 5)') do
     undef :non_existing_method
   end
 end
+
+assert('Method lookup after redefinition') do
+  c = Class.new { def m; 1; end }
+  o = c.new
+  assert_equal 1, o.m
+  c.class_eval { def m; 2; end }
+  assert_equal 2, o.m
+  c.class_eval { remove_method :m }
+  assert_raise(NoMethodError) { o.m }
+  assert_false o.respond_to?(:m)
+  c.class_eval { def m; 3; end }
+  assert_true o.respond_to?(:m)
+  assert_equal 3, o.m
+end
+
+assert('Method lookup after include, prepend and undef') do
+  b = Class.new { def m; :base; end }
+  c = Class.new(b)
+  o = c.new
+  assert_equal :base, o.m
+  c.include Module.new { def m; :included; end }
+  assert_equal :included, o.m
+  c.prepend Module.new { def m; :prepended; end }
+  assert_equal :prepended, o.m
+  def o.m; :singleton; end
+  assert_equal :singleton, o.m
+  b.class_eval { undef m }
+  assert_equal :singleton, o.m
+  assert_raise(NoMethodError) { b.new.m }
+  assert_equal :prepended, c.new.m
+  c.class_eval { undef m }
+  assert_equal :prepended, c.new.m
+end
+
+assert('Method lookup at one call site') do
+  c = Class.new { def m; 1; end }
+  d = Class.new(c) { def m; 2; end }
+  site = lambda { |o| o.m }
+  o = c.new
+  assert_equal [1, 2, 1], [site.call(o), site.call(d.new), site.call(o)]
+  c.class_eval { def m; 3; end }
+  assert_equal 3, site.call(o)
+  def o.m; 4; end
+  assert_equal 4, site.call(o)
+  assert_equal 5, site.call(Class.new { def m; 5; end }.new)
+  assert_raise(NoMethodError) { site.call(nil) }
+end
+
+assert('Method lookup in classes allocated after GC') do
+  b = [Class.new { def m; 0; end }, Class.new { def m; 1; end }]
+  site = lambda { |o| o.m }
+  20.times do |i|
+    o = Class.new(b[i % 2]).new
+    assert_equal i % 2, site.call(o)
+    assert_equal i % 2, o.__send__(:m)
+    o = nil
+    GC.start
+  end
+end
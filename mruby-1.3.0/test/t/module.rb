@@ -860,3 +860,83 @@ assert('get constant of parent module in singleton class; issue #3568') do
 
   assert_equal("value", actual)
 end
+
+assert('constant lookup sees later changes') do
+  module ConstCacheTest
+    X = 1
+    def self.get; X; end
+    def self.get_m(m); m::Y; end
+    module A; Y = :a; end
+    module B; Y = :b; end
+  end
+
+  m = ConstCacheTest
+  assert_equal [1, 1], [m.get, m.get]
+  m.const_set(:X, 2)
+  assert_equal 2, m.get
+  m.send(:remove_const, :X)
+  assert_raise(NameError) { m.get }
+  m.const_set(:X, 3)
+  assert_equal 3, m.get
+
+  assert_equal [:a, :b, :a], [m.get_m(m::A), m.get_m(m::B), m.get_m(m::A)]
+  m::B.const_set(:Y, :c)
+  assert_equal :c, m.get_m(m::B)
+end
+
+assert('constant lookup with same code in different classes') do
+  module ConstCacheTest2
+    class A; X = :a; end
+    class B; X = :b; end
+    [A, B].each do |k|
+      class k::C
+        def get; X; end
+      end
+    end
+  end
+
+  m = ConstCacheTest2
+  assert_equal [:a, :b, :a], [m::A::C.new.get, m::B::C.new.get, m::A::C.new.get]
+end
+
+assert('constant lookup after include') do
+  module ConstCacheTest3
+    X = :outer
+    class C
+      def get; X; end
+    end
+    module M; end
+  end
+
+  m = ConstCacheTest3
+  c = m::C.new
+  assert_equal :outer, c.get
+  m::M.const_set(:X, :included)
+  m::C.include m::M
+  # lexical scope is searched before ancestors
+  assert_equal :outer, c.get
+  m.send(:remove_const, :X)
+  assert_equal :included, c.get
+end
+
+assert('constant lookup in classes allocated after GC') do
+  b = [Class.new { const_set(:X, 0) }, Class.new { const_set(:X, 1) }]
+  20.times do |i|
+    k = Class.new(b[i % 2])
+    assert_equal i % 2, k::X
+    k = nil
+    GC.start
+  end
+end
+
+assert('const_missing is called each time') do
+  class ConstCacheTest4
+    @@missing = 0
+    def self.const_missing(name)
+      @@missing += 1
+    end
+    def self.get; Nothing; end
+  end
+
+  assert_equal [1, 2], [ConstCacheTest4.get, ConstCacheTest4.get]
+end
@@ -9,3 +9,71 @@ assert('Object superclass', '15.2.1.2') do
   assert_equal BasicObject, Object.superclass
 end
 
+
+assert('Object instance variables in different order') do
+  c = Class.new do
+    def initialize(ab)
+      if ab
+        @a = 1; @b = 2
+      else
+        @b = 20; @a = 10
+      end
+    end
+    def a; @a; end
+    def b; @b; end
+    def a=(v); @a = v; end
+  end
+  objs = [c.new(true), c.new(false), c.new(true), c.new(false)]
+  assert_equal [1, 10, 1, 10], objs.map { |o| o.a }
+  assert_equal [2, 20, 2, 20], objs.map { |o| o.b }
+  objs.each { |o| o.a = o.b + 1 }
+  assert_equal [3, 21, 3, 21], objs.map { |o| o.a }
+  assert_equal [:@a, :@b], objs[0].instance_variables
+  assert_equal [:@b, :@a], objs[1].instance_variables
+end
+
+assert('Object instance variables after remove_instance_variable') do
+  c = Class.new do
+    def initialize; @a = 1; @b = 2; @c = 3; end
+    def get; [@a, @b, @c]; end
+    def set_b(v); @b = v; end
+  end
+  o = c.new
+  p = c.new
+  assert_equal 2, o.remove_instance_variable(:@b)
+  assert_equal [1, nil, 3], o.get
+  assert_equal [1, 2, 3], p.get
+  o.set_b 4
+  p.set_b 5
+  assert_equal [1, 4, 3], o.get
+  assert_equal [1, 5, 3], p.get
+  assert_equal [:@a, :@b, :@c], o.instance_variables.sort
+end
+
+assert('Object instance variables of copies') do
+  c = Class.new do
+    def initialize; @a = 1; @b = 2; end
+    def get; [@a, @b]; end
+    def set_a(v); @a = v; end
+  end
+  o = c.new
+  d = o.dup
+  d.set_a 3
+  assert_equal [1, 2], o.get
+  assert_equal [3, 2], d.get
+  assert_equal [1, 2], o.clone.get
+  o.freeze
+  assert_raise(RuntimeError) { o.set_a 4 }
+  assert_equal [1, 2], o.get
+end
+
+assert('Object with many instance variables') do
+  o = Object.new
+  names = (0...100).map { |i| :"@v#{i}" }
+  names.each_with_index { |n, i| o.instance_variable_set(n, i) }
+  assert_equal names.sort, o.instance_variables.sort
+  assert_equal 99, o.instance_variable_get(:@v99)
+  assert_equal 50, o.remove_instance_variable(:@v50)
+  assert_false o.instance_variable_defined?(:@v50)
+  assert_equal 51, o.instance_variable_get(:@v51)
+end
@@ -29,6 +29,20 @@ assert('Range#each', '15.2.14.4.4') do
   assert_equal 6, b
 end
 
+assert('Range#each with exclusive or Float end') do
+  a = []
+  (1...4).each {|i| a << i }
+  assert_equal [1, 2, 3], a
+  assert_equal 6, (1..Float::INFINITY).each {|i| break i if i > 5 }
+end
+
+assert('Range#each with non-local return') do
+  def range_each_return
+    [1, 2].each {|x| (0..3).each {|i| return [x, i] if i == 2 } }
+  end
+  assert_equal [1, 2], range_each_return
+end
+
 assert('Range#end', '15.2.14.4.5') do
   assert_equal 10, (1..10).end
 end
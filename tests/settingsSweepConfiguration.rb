@@ -0,0 +1,52 @@
+# Minimal configuration for SettingsTest, sets all variables read by
+# Settings::readConfiguration(). Nx, Ny and Ln come from the prologue.
+
+$lattice              = 'D3Q19'
+$data_type            = 'double'
+$fluid_model          = 'incompressible'
+$collision_model      = 'BGK'
+$computational_engine = 'CPU'
+
+$z_expand_depth = 0
+
+$vtk_save_velocity_LB         = true
+$vtk_save_velocity_physical   = true
+$vtk_save_rho_LB              = true
+$vtk_save_pressure_physical   = true
+$vtk_save_nodes               = true
+$vtk_save_mass_flow_fractions = false
+$vtkDefaultRhoForBB2Nodes     = 'mean'
+
+$save_vtk_steps                      = 100
+$number_vtk_saves                    = 10
+$numberOfStepsBetweenCheckpointSaves = 1000
+$maxNumberOfCheckpoints              = 2
+$error_print_steps                   = 10
+
+$err    = 1e-6
+$tau    = 0.8
+$ux0_LB = 0.0
+$uy0_LB = 0.0
+$uz0_LB = 0.0
+
+$Nx        = Nx
+$Ny        = Ny
+$l_ch_LB   = Ln
+$l_ch_phys = 0.01
+$u_ch_phys = 0.1
+$rho0_phys = 1000.0
+$rho0_LB   = 1.0
+
+# Derived in Ruby, sweeps over $Re must recompute it.
+$Re    ||= 1000.0
+$nu_phys = $u_ch_phys * $l_ch_phys / $Re
+
+$defaultWallNode                    = 'bounce_back_2'
+$defaultExternalCornerNode          = 'bounce_back_2'
+$defaultInternalCornerNode          = 'bounce_back_2'
+$defaultExternalEdgeNode            = 'bounce_back_2'
+$defaultInternalEdgeNode            = 'bounce_back_2'
+$defaultNotIdentifiedNode           = 'bounce_back_2'
+$defaultExternalEdgePressureNode    = 'bounce_back_2'
+$defaultExternalCornerPressureNode  = 'bounce_back_2'
+$defaultEdgeToPerpendicularWallNode = 'bounce_back_2'